@@ -8,13 +8,52 @@
 
 #include "output_settings.h"
 #include "arguments_parsing.h"
+#include "deadline.h"
 #include "tty_utils.h"
 #include "pause_methods.h"
+#include "idle_sources.h"
+#include "idle_tiers.h"
+#include "schedule.h"
+#include "thread_affinity.h"
 
 const long TIMEOUT_MAX_SUPPORTED_VALUE = 100000000; //~3 years
 const long TIMEOUT_MIN_SUPPORTED_VALUE = 1;
 const long START_MONITOR_AFTER_MAX_SUPPORTED_VALUE = TIMEOUT_MAX_SUPPORTED_VALUE * 1000;
 const long START_MONITOR_AFTER_MIN_SUPPORTED_VALUE = 0;
+const long IO_WEIGHT_MIN_SUPPORTED_VALUE = 1;
+const long IO_WEIGHT_MAX_SUPPORTED_VALUE = 10000;
+const long DUTY_CYCLE_MIN_SUPPORTED_VALUE = 1;
+const long DUTY_CYCLE_MAX_SUPPORTED_VALUE = 99;
+const long DUTY_CYCLE_PERIOD_MIN_SUPPORTED_VALUE = 100;
+const long DUTY_CYCLE_PERIOD_MAX_SUPPORTED_VALUE = 3600000;
+const long OOM_SCORE_ADJ_MIN_SUPPORTED_VALUE = 1;
+const long OOM_SCORE_ADJ_MAX_SUPPORTED_VALUE = 1000;
+const long PREFETCH_BUDGET_MIN_SUPPORTED_VALUE = 1;
+const long PREFETCH_BUDGET_MAX_SUPPORTED_VALUE = 1048576;
+const long MAX_PAUSES_PER_HOUR_MIN_SUPPORTED_VALUE = 1;
+const long MAX_PAUSES_PER_HOUR_MAX_SUPPORTED_VALUE = 3600;
+
+// Values for options that don't have a short version, outside the range of characters
+enum long_only_option {
+    OPTION_THROTTLE_CPU_MAX = 256,
+    OPTION_THROTTLE_IO_MAX,
+    OPTION_THROTTLE_IO_WEIGHT,
+    OPTION_DUTY_CYCLE,
+    OPTION_DUTY_CYCLE_PERIOD,
+    OPTION_IDLE_TIER,
+    OPTION_RECLAIM_MEMORY_AFTER,
+    OPTION_OOM_SCORE_ADJ,
+    OPTION_PREFETCH_ON_RESUME,
+    OPTION_DEADLINE,
+    OPTION_EXPECTED_CPU_TIME,
+    OPTION_MIN_RUN_TIME,
+    OPTION_MIN_ACTIVITY_TIME,
+    OPTION_MAX_PAUSES_PER_HOUR,
+    OPTION_SCHEDULE,
+    OPTION_SCHEDULE_FILE,
+    OPTION_IDLE_HISTORY,
+    OPTION_IDLE_SOURCE,
+};
 
 
 void print_usage(char *binary_name) {
@@ -30,7 +69,91 @@ void print_usage(char *binary_name) {
     printf("  --pause-method, -m <method>     Specify method for pausing the process when the user is\n"
            "                                  not idle. Available Options (default: SIGSTOP): \n"
            "                                      SIGTSTP (can be ignored by the program),\n"
-           "                                      SIGSTOP (cannot be ignored).\n\n");
+           "                                      SIGSTOP (cannot be ignored),\n"
+           "                                      CGROUP_FREEZE (freezes the whole process tree at once\n"
+           "                                      using cgroup v2 freezer, requires a delegated cgroup,\n"
+           "                                      falls back to SIGSTOP if not available),\n"
+           "                                      CPU_AFFINITY (keeps the process tree running, but only\n"
+           "                                      on the CPUs specified by --reserved-cpus),\n"
+           "                                      SCHED_IDLE (keeps the process tree running with the\n"
+           "                                      lowest CPU and I/O priority),\n"
+           "                                      NICE (keeps the process tree running with nice 19),\n"
+           "                                      IOPRIO_IDLE (keeps the process tree running with the\n"
+           "                                      idle I/O scheduling class),\n"
+           "                                      CGROUP_THROTTLE (keeps the process tree running in its\n"
+           "                                      own cgroup v2 with limits set by --throttle-* options,\n"
+           "                                      requires a delegated cgroup, falls back to SCHED_IDLE).\n\n");
+    printf("  --reserved-cpus, -c <cpu-list>  CPUs the process is allowed to use while the user is\n"
+           "                                  active when CPU_AFFINITY pause method is used, e.g. 0-1,4.\n"
+           "                                  (default: first CPU runwhenidle can run on).\n\n");
+    printf("  --throttle-cpu-max <quota>      Value written to cpu.max when CGROUP_THROTTLE pause method\n"
+           "                                  is used: \"<quota> <period>\" in microseconds.\n"
+           "                                  (default: \"25000 100000\", 25%% of one CPU).\n\n");
+    printf("  --throttle-io-max <limits>      Value written to io.max when CGROUP_THROTTLE pause method\n"
+           "                                  is used, e.g. \"8:0 rbps=1048576 wbps=1048576\".\n"
+           "                                  (default: I/O bandwidth is not limited).\n\n");
+    printf("  --throttle-io-weight <weight>   Value between 1 and 10000 written to io.weight when\n"
+           "                                  CGROUP_THROTTLE pause method is used. (default: 10).\n\n");
+    printf("  --min-run-time <seconds>        Once the command is resumed, don't pause it again until it\n"
+           "                                  has been running for this long. (default: disabled).\n\n");
+    printf("  --min-activity-time <seconds>   Only pause the command when the user is still active this\n"
+           "                                  long after becoming active, i.e. has used input in the last\n"
+           "                                  half of this time. (default: disabled).\n\n");
+    printf("  --max-pauses-per-hour <count>   Don't pause the command more often than this, keep it\n"
+           "                                  running instead. (default: unlimited).\n\n");
+    printf("  --idle-tier <seconds>:<method>  Switch to a different pause method once the user has been\n"
+           "                                  idle for the specified time, but not for --timeout yet.\n"
+           "                                  Method can be any of --pause-method except CGROUP_*, or\n"
+           "                                  RUN to run the process normally. Can be used multiple\n"
+           "                                  times, e.g. --idle-tier 30:SCHED_IDLE --idle-tier 120:RUN\n\n");
+    printf("  --duty-cycle <percent>          Instead of keeping the process paused while the user is\n"
+           "                                  active, let it run for this percentage of every\n"
+           "                                  --duty-cycle-period. Only supported with SIGSTOP, SIGTSTP\n"
+           "                                  and CGROUP_FREEZE pause methods. (default: disabled).\n\n");
+    printf("  --duty-cycle-period <ms>        Length of one pause and run cycle in milliseconds when\n"
+           "                                  --duty-cycle is used. (default: 500 ms).\n\n");
+    printf("  --reclaim-memory-after <seconds> Once the command has been paused for the specified time,\n"
+           "                                  ask the kernel to move its memory to swap or drop its file\n"
+           "                                  cache to make room for other processes. Only supported with\n"
+           "                                  SIGSTOP, SIGTSTP and CGROUP_FREEZE pause methods and without\n"
+           "                                  --duty-cycle. (default: disabled).\n\n");
+    printf("  --prefetch-on-resume <MiB>      When pausing the command, remember which of its memory is\n"
+           "                                  resident, up to the specified amount, and ask the kernel to\n"
+           "                                  read it back in from swap or disk when the command is\n"
+           "                                  resumed. Requires CAP_SYS_NICE. (default: disabled).\n\n");
+    printf("  --oom-score-adj <1-1000>        Set oom_score_adj of the command, so that it's killed before\n"
+           "                                  other processes when the system runs out of memory.\n"
+           "                                  (default: not changed).\n\n");
+    printf("  --deadline <HH:MM>              Stop pausing the command when pausing it any longer would\n"
+           "                                  not let it finish by this time of day, assuming it needs\n"
+           "                                  --expected-cpu-time. Without it, pausing stops at the\n"
+           "                                  deadline. (default: disabled).\n\n");
+    printf("  --expected-cpu-time <seconds>   Total CPU time the command is expected to need, summed over\n"
+           "                                  all its processes, used by --deadline to estimate how much\n"
+           "                                  work remains. (default: unknown).\n\n");
+    printf("  --idle-history <path>           Learn how long idle periods usually last at every hour of\n"
+           "                                  every weekday and keep it in this file. Used to resume the\n"
+           "                                  command before --timeout when the user is likely to stay\n"
+           "                                  idle, and to wait a minute longer when the user usually\n"
+           "                                  comes back soon after. (default: disabled).\n\n");
+    printf("  --schedule <HH:MM-HH:MM=MODE>   Override user activity detection in a time window of every\n"
+           "                                  day. MODE is RUN to keep the command running, PAUSE to keep\n"
+           "                                  it paused or IDLE to depend on user activity. Windows can\n"
+           "                                  cross midnight, the last matching one wins. Can be used\n"
+           "                                  multiple times. (default: IDLE all day).\n\n");
+    printf("  --schedule-file <path>          Read --schedule rules from a file, one per line. Empty lines\n"
+           "                                  and lines starting with # are ignored.\n\n");
+    printf("  --idle-source <source>          Where to get user activity from instead of trying Wayland,\n"
+           "                                  X11, input devices, then terminal sessions: wayland, x11,\n"
+           "                                  evdev, tty, fifo:<path> or socket:<path>. With fifo or\n"
+           "                                  socket, lines \"active\", \"idle\" (for --timeout) or\n"
+           "                                  \"idle <ms>\" written to it set the user idle time.\n"
+           "                                  The FIFO is created if it doesn't exist.\n\n");
+    printf("  --process-group, -g             Run the command in its own process group and pause or\n"
+           "                                  resume the whole group with a single signal. Only\n"
+           "                                  processes that left the group are signalled one by one.\n"
+           "                                  The command will be stopped if it tries to read from\n"
+           "                                  the terminal. Can't be used with --pid.\n\n");
     printf("  --quiet, -q                     Suppress all output from %s except errors and only\n"
            "                                  display output from the command that is running.\n"
            "                                  No output if --pid options is used.\n\n", binary_name);
@@ -98,6 +221,26 @@ void parse_command_line_arguments(int argc, char *argv[]) {
             {"pid",                 required_argument, NULL, 'p'},
             {"start-monitor-after", required_argument, NULL, 'a'},
             {"pause-method",        required_argument, NULL, 'm'},
+            {"process-group",       no_argument,       NULL, 'g'},
+            {"reserved-cpus",       required_argument, NULL, 'c'},
+            {"throttle-cpu-max",    required_argument, NULL, OPTION_THROTTLE_CPU_MAX},
+            {"throttle-io-max",     required_argument, NULL, OPTION_THROTTLE_IO_MAX},
+            {"throttle-io-weight",  required_argument, NULL, OPTION_THROTTLE_IO_WEIGHT},
+            {"duty-cycle",          required_argument, NULL, OPTION_DUTY_CYCLE},
+            {"idle-tier",           required_argument, NULL, OPTION_IDLE_TIER},
+            {"reclaim-memory-after", required_argument, NULL, OPTION_RECLAIM_MEMORY_AFTER},
+            {"oom-score-adj",       required_argument, NULL, OPTION_OOM_SCORE_ADJ},
+            {"prefetch-on-resume",  required_argument, NULL, OPTION_PREFETCH_ON_RESUME},
+            {"deadline",            required_argument, NULL, OPTION_DEADLINE},
+            {"expected-cpu-time",   required_argument, NULL, OPTION_EXPECTED_CPU_TIME},
+            {"min-run-time",        required_argument, NULL, OPTION_MIN_RUN_TIME},
+            {"min-activity-time",   required_argument, NULL, OPTION_MIN_ACTIVITY_TIME},
+            {"max-pauses-per-hour", required_argument, NULL, OPTION_MAX_PAUSES_PER_HOUR},
+            {"schedule",            required_argument, NULL, OPTION_SCHEDULE},
+            {"schedule-file",       required_argument, NULL, OPTION_SCHEDULE_FILE},
+            {"idle-history",        required_argument, NULL, OPTION_IDLE_HISTORY},
+            {"idle-source",         required_argument, NULL, OPTION_IDLE_SOURCE},
+            {"duty-cycle-period",   required_argument, NULL, OPTION_DUTY_CYCLE_PERIOD},
             {"verbose",             no_argument,       NULL, 'v'},
             {"debug",               no_argument,       NULL, 'd'},
             {"quiet",               no_argument,       NULL, 'q'},
@@ -115,7 +258,7 @@ void parse_command_line_arguments(int argc, char *argv[]) {
 
     // Parse command line options
     int option;
-    while ((option = getopt_long(argc, argv, "+hvqp:t:a:m:V", long_options, NULL)) != -1) {
+    while ((option = getopt_long(argc, argv, "+hvqgp:t:a:m:c:V", long_options, NULL)) != -1) {
         switch (option) {
             case 't': {
                 char *strtol_endptr;
@@ -160,7 +303,7 @@ void parse_command_line_arguments(int argc, char *argv[]) {
                 }
             case 'm': {
                 char *method = strdup(optarg);
-                for (int i = 0; i < sizeof(method); i++) {
+                for (size_t i = 0; method[i] != '\0'; i++) {
                     method[i] = toupper(method[i]);
                 }
                 pause_method = PAUSE_METHOD_UNKNOWN;
@@ -187,6 +330,239 @@ void parse_command_line_arguments(int argc, char *argv[]) {
                 }
                 break;
             }
+            case 'g':
+                run_in_separate_process_group = 1;
+                break;
+            case 'c':
+                if (set_reserved_cpus_from_list(optarg) == -1) {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --reserved-cpus|c argument: \"%s\". Expected a list of CPUs like 0-1,4\n",
+                                  argv[0],
+                                  optarg);
+                    exit(1);
+                }
+                break;
+            case OPTION_THROTTLE_CPU_MAX: {
+                char quota[32];
+                long period;
+                char trailing_character;
+                int fields_parsed = sscanf(optarg, "%31s %ld %c", quota, &period, &trailing_character);
+                char *strtol_endptr;
+                long quota_value = strtol(quota, &strtol_endptr, 10);
+                if (fields_parsed < 1 || fields_parsed > 2 ||
+                    (strcmp(quota, "max") != 0 && (quota_value <= 0 || *strtol_endptr != '\0')) ||
+                    (fields_parsed == 2 && period <= 0)) {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --throttle-cpu-max argument: \"%s\". Expected \"<quota> <period>\" in microseconds\n",
+                                  argv[0],
+                                  optarg);
+                    exit(1);
+                }
+                throttle_cpu_max = optarg;
+                break;
+            }
+            case OPTION_THROTTLE_IO_MAX: {
+                unsigned int device_major, device_minor;
+                int device_length = 0;
+                if (sscanf(optarg, "%u:%u%n", &device_major, &device_minor, &device_length) != 2 ||
+                    optarg[device_length] != ' ') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --throttle-io-max argument: \"%s\". Expected \"<major>:<minor> <key>=<value>...\"\n",
+                                  argv[0],
+                                  optarg);
+                    exit(1);
+                }
+                throttle_io_max = optarg;
+                break;
+            }
+            case OPTION_THROTTLE_IO_WEIGHT: {
+                char *strtol_endptr;
+                long io_weight = strtol(optarg, &strtol_endptr, 10);
+                if (io_weight < IO_WEIGHT_MIN_SUPPORTED_VALUE || io_weight > IO_WEIGHT_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --throttle-io-weight argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  optarg,
+                                  IO_WEIGHT_MIN_SUPPORTED_VALUE, IO_WEIGHT_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                throttle_io_weight = (int) io_weight;
+                break;
+            }
+            case OPTION_DUTY_CYCLE: {
+                char *strtol_endptr;
+                long percent = strtol(optarg, &strtol_endptr, 10);
+                if (percent < DUTY_CYCLE_MIN_SUPPORTED_VALUE || percent > DUTY_CYCLE_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --duty-cycle argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  optarg,
+                                  DUTY_CYCLE_MIN_SUPPORTED_VALUE, DUTY_CYCLE_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                duty_cycle_percent = (int) percent;
+                break;
+            }
+            case OPTION_DUTY_CYCLE_PERIOD: {
+                char *strtol_endptr;
+                long period_ms = strtol(optarg, &strtol_endptr, 10);
+                if (period_ms < DUTY_CYCLE_PERIOD_MIN_SUPPORTED_VALUE || period_ms > DUTY_CYCLE_PERIOD_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --duty-cycle-period argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  optarg,
+                                  DUTY_CYCLE_PERIOD_MIN_SUPPORTED_VALUE, DUTY_CYCLE_PERIOD_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                duty_cycle_period_ms = period_ms;
+                break;
+            }
+            case OPTION_RECLAIM_MEMORY_AFTER: {
+                char *strtol_endptr;
+                long reclaim_memory_after = strtol(optarg, &strtol_endptr, 10);
+                if (reclaim_memory_after < TIMEOUT_MIN_SUPPORTED_VALUE || reclaim_memory_after > TIMEOUT_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --reclaim-memory-after argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  optarg,
+                                  TIMEOUT_MIN_SUPPORTED_VALUE, TIMEOUT_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                reclaim_memory_after_ms = reclaim_memory_after * 1000;
+                break;
+            }
+            case OPTION_OOM_SCORE_ADJ: {
+                char *strtol_endptr;
+                long oom_score_adj = strtol(optarg, &strtol_endptr, 10);
+                if (oom_score_adj < OOM_SCORE_ADJ_MIN_SUPPORTED_VALUE || oom_score_adj > OOM_SCORE_ADJ_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --oom-score-adj argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  optarg,
+                                  OOM_SCORE_ADJ_MIN_SUPPORTED_VALUE, OOM_SCORE_ADJ_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                oom_score_adjustment = (int) oom_score_adj;
+                break;
+            }
+            case OPTION_PREFETCH_ON_RESUME: {
+                char *strtol_endptr;
+                long budget_mib = strtol(optarg, &strtol_endptr, 10);
+                if (budget_mib < PREFETCH_BUDGET_MIN_SUPPORTED_VALUE || budget_mib > PREFETCH_BUDGET_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --prefetch-on-resume argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  optarg,
+                                  PREFETCH_BUDGET_MIN_SUPPORTED_VALUE, PREFETCH_BUDGET_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                prefetch_budget_mib = budget_mib;
+                break;
+            }
+            case OPTION_DEADLINE:
+                deadline_timestamp = parse_deadline_time_of_day(optarg);
+                if (deadline_timestamp == -1) {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --deadline argument: \"%s\". Expected time of day in HH:MM format\n",
+                                  argv[0],
+                                  optarg);
+                    exit(1);
+                }
+                break;
+            case OPTION_EXPECTED_CPU_TIME: {
+                char *strtol_endptr;
+                long expected_cpu_time = strtol(optarg, &strtol_endptr, 10);
+                if (expected_cpu_time < TIMEOUT_MIN_SUPPORTED_VALUE || expected_cpu_time > TIMEOUT_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --expected-cpu-time argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  optarg,
+                                  TIMEOUT_MIN_SUPPORTED_VALUE, TIMEOUT_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                expected_cpu_time_ms = expected_cpu_time * 1000;
+                break;
+            }
+            case OPTION_MIN_RUN_TIME:
+            case OPTION_MIN_ACTIVITY_TIME: {
+                const char *option_name = option == OPTION_MIN_RUN_TIME ? "--min-run-time" : "--min-activity-time";
+                char *strtol_endptr;
+                long time_seconds = strtol(optarg, &strtol_endptr, 10);
+                if (time_seconds < TIMEOUT_MIN_SUPPORTED_VALUE || time_seconds > TIMEOUT_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for %s argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  option_name,
+                                  optarg,
+                                  TIMEOUT_MIN_SUPPORTED_VALUE, TIMEOUT_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                if (option == OPTION_MIN_RUN_TIME) {
+                    min_run_time_ms = time_seconds * 1000;
+                } else {
+                    min_activity_time_ms = time_seconds * 1000;
+                }
+                break;
+            }
+            case OPTION_MAX_PAUSES_PER_HOUR: {
+                char *strtol_endptr;
+                long pauses = strtol(optarg, &strtol_endptr, 10);
+                if (pauses < MAX_PAUSES_PER_HOUR_MIN_SUPPORTED_VALUE || pauses > MAX_PAUSES_PER_HOUR_MAX_SUPPORTED_VALUE ||
+                    *strtol_endptr != '\0') {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --max-pauses-per-hour argument: \"%s\". Range supported: %ld-%ld\n",
+                                  argv[0],
+                                  optarg,
+                                  MAX_PAUSES_PER_HOUR_MIN_SUPPORTED_VALUE, MAX_PAUSES_PER_HOUR_MAX_SUPPORTED_VALUE);
+                    exit(1);
+                }
+                max_pauses_per_hour = (int) pauses;
+                break;
+            }
+            case OPTION_IDLE_HISTORY:
+                idle_history_file_path = optarg;
+                break;
+            case OPTION_IDLE_SOURCE:
+                if (set_idle_source(optarg) == -1) {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --idle-source argument: \"%s\". Expected wayland, x11, evdev, tty, fifo:<path> or socket:<path>\n",
+                                  argv[0],
+                                  optarg);
+                    exit(1);
+                }
+                break;
+            case OPTION_SCHEDULE:
+                if (add_schedule_rule(optarg) == -1) {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --schedule argument: \"%s\". Expected \"HH:MM-HH:MM=MODE\" with IDLE, RUN or PAUSE mode, at most 32 rules are supported\n",
+                                  argv[0],
+                                  optarg);
+                    exit(1);
+                }
+                break;
+            case OPTION_SCHEDULE_FILE:
+                if (load_schedule_file(optarg) == -1) {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    exit(1);
+                }
+                break;
+            case OPTION_IDLE_TIER:
+                if (add_idle_tier(optarg) == -1) {
+                    print_buffered_error_and_restore_stderr(old_stderr, getopt_error_buffer, sizeof (getopt_error_buffer));
+                    fprintf_error("%s: Invalid value for --idle-tier argument: \"%s\". Expected \"<seconds>:<method>\" with a method other than CGROUP_*, at most 8 tiers are supported\n",
+                                  argv[0],
+                                  optarg);
+                    exit(1);
+                }
+                break;
             case 'V':
                 print_version();
                 exit(0);
@@ -213,15 +589,31 @@ void parse_command_line_arguments(int argc, char *argv[]) {
 
     if (debug)
         fprintf(stderr,
-                "verbose: %i, debug: %i, quiet: %i, pause_method: %i, user_idle_timeout_ms: %lu, start_monitoring_after_ms: %ld\n",
+                "verbose: %i, debug: %i, quiet: %i, pause_method: %i, user_idle_timeout_ms: %lu, start_monitoring_after_ms: %ld, run_in_separate_process_group: %i, duty_cycle_percent: %i, duty_cycle_period_ms: %ld, reclaim_memory_after_ms: %ld, oom_score_adjustment: %i, prefetch_budget_mib: %ld, deadline_timestamp: %ld, expected_cpu_time_ms: %ld, min_run_time_ms: %ld, min_activity_time_ms: %ld, max_pauses_per_hour: %i, idle_history_file_path: %s\n",
                 verbose,
                 debug,
                 quiet,
                 pause_method,
                 user_idle_timeout_ms,
-                start_monitor_after_ms
+                start_monitor_after_ms,
+                run_in_separate_process_group,
+                duty_cycle_percent,
+                duty_cycle_period_ms,
+                reclaim_memory_after_ms,
+                oom_score_adjustment,
+                prefetch_budget_mib,
+                deadline_timestamp,
+                expected_cpu_time_ms,
+                min_run_time_ms,
+                min_activity_time_ms,
+                max_pauses_per_hour,
+                idle_history_file_path ? idle_history_file_path : "(none)"
         );
     if (external_pid) {
+        if (run_in_separate_process_group) {
+            fprintf_error("%s: Incompatible options --pid|-p and --process-group|-g used\n", argv[0]);
+            exit(1);
+        }
         if (optind < argc) {
             fprintf_error(
                     "%s: Running command is not supported when -p option is used. Found unexpected \"%s\"\n",
@@ -239,6 +631,27 @@ void parse_command_line_arguments(int argc, char *argv[]) {
         }
         shell_command_to_run = read_remaining_arguments_as_char(argc, argv);
     }
+    if (finalize_idle_levels(pause_method, user_idle_timeout_ms) == -1) {
+        fprintf_error("%s: Every --idle-tier must be shorter than --timeout and different from other tiers\n", argv[0]);
+        exit(1);
+    }
+    if (duty_cycle_percent && pause_method != PAUSE_METHOD_SIGSTOP && pause_method != PAUSE_METHOD_SIGTSTP &&
+        pause_method != PAUSE_METHOD_CGROUP_FREEZE) {
+        fprintf_error("%s: --duty-cycle can't be used with --pause-method=%s, which already keeps the command running\n",
+                      argv[0], pause_method_string[pause_method]);
+        exit(1);
+    }
+    if (reclaim_memory_after_ms && (duty_cycle_percent || (pause_method != PAUSE_METHOD_SIGSTOP &&
+                                                           pause_method != PAUSE_METHOD_SIGTSTP &&
+                                                           pause_method != PAUSE_METHOD_CGROUP_FREEZE))) {
+        fprintf_error("%s: --reclaim-memory-after can't be used with --duty-cycle or --pause-method=%s, "
+                      "which keep the command running\n", argv[0], pause_method_string[pause_method]);
+        exit(1);
+    }
+    if (expected_cpu_time_ms && !deadline_timestamp) {
+        fprintf_error("%s: --expected-cpu-time can only be used with --deadline\n", argv[0]);
+        exit(1);
+    }
     if (quiet && debug) {
         fprintf_error("%s: Incompatible options --quiet|-q and --debug used\n", argv[0]);
         exit(1);
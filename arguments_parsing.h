@@ -4,6 +4,21 @@ extern long start_monitor_after_ms;
 extern long unsigned user_idle_timeout_ms;
 extern char *shell_command_to_run;
 extern pid_t external_pid;
+extern int run_in_separate_process_group;
+extern char *throttle_cpu_max;
+extern char *throttle_io_max;
+extern int throttle_io_weight;
+extern int duty_cycle_percent;
+extern long duty_cycle_period_ms;
+extern long reclaim_memory_after_ms;
+extern int oom_score_adjustment;
+extern long prefetch_budget_mib;
+extern long deadline_timestamp;
+extern long expected_cpu_time_ms;
+extern long min_run_time_ms;
+extern long min_activity_time_ms;
+extern int max_pauses_per_hour;
+extern char *idle_history_file_path;
 
 /**
  * Parses command line arguments and sets relevant program options.
@@ -0,0 +1,509 @@
+#include "cgroup_utils.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "output_settings.h"
+#include "tty_utils.h"
+
+static char job_cgroup_path[PATH_MAX];
+static int job_cgroup_directory_file_descriptor = -1;
+static int job_cgroup_procs_file_descriptor = -1;
+static int job_cgroup_has_command = 0;
+
+// Parent of the job cgroup, i.e. the cgroup runwhenidle was started in
+static char parent_cgroup_path[PATH_MAX];
+static char enabled_parent_cgroup_controllers[64];
+// Leaf cgroup runwhenidle moves itself into, since controllers can't be enabled for a cgroup that has processes
+static char supervisor_cgroup_path[PATH_MAX];
+static char job_cgroup_io_device[32];
+
+static int find_cgroup2_mount(char *out_mount_point, size_t out_mount_point_size,
+                              char *out_mount_root, size_t out_mount_root_size) {
+    FILE *mountinfo_file = fopen("/proc/self/mountinfo", "r");
+    if (!mountinfo_file) {
+        return 0;
+    }
+
+    // Example line:
+    //36 25 0:31 / /sys/fs/cgroup rw,nosuid,nodev,noexec,relatime shared:9 - cgroup2 cgroup2 rw,nsdelegate
+    // Optional fields are terminated by " - ", after which the filesystem type follows.
+    char line[PATH_MAX * 2];
+    int found = 0;
+    while (fgets(line, sizeof(line), mountinfo_file)) {
+        const char *optional_fields_separator = strstr(line, " - ");
+        if (!optional_fields_separator) {
+            continue;
+        }
+        char filesystem_type[32];
+        if (sscanf(optional_fields_separator + 3, "%31s", filesystem_type) != 1 ||
+            strcmp(filesystem_type, "cgroup2") != 0) {
+            continue;
+        }
+        char mount_root[PATH_MAX];
+        char mount_point[PATH_MAX];
+        if (sscanf(line, "%*d %*d %*s %4095s %4095s", mount_root, mount_point) != 2) {
+            continue;
+        }
+        snprintf(out_mount_point, out_mount_point_size, "%s", mount_point);
+        snprintf(out_mount_root, out_mount_root_size, "%s", mount_root);
+        found = 1;
+        break;
+    }
+    fclose(mountinfo_file);
+
+    return found;
+}
+
+static int read_own_cgroup2_path(char *out_cgroup_path, size_t out_cgroup_path_size) {
+    FILE *cgroup_file = fopen("/proc/self/cgroup", "r");
+    if (!cgroup_file) {
+        return 0;
+    }
+
+    // cgroup v2 entry always has hierarchy ID 0 and an empty controller list, e.g. "0::/user.slice/session-2.scope"
+    char line[PATH_MAX + 8];
+    int found = 0;
+    while (fgets(line, sizeof(line), cgroup_file)) {
+        if (strncmp(line, "0::", 3) != 0) {
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+        snprintf(out_cgroup_path, out_cgroup_path_size, "%s", line + 3);
+        found = 1;
+        break;
+    }
+    fclose(cgroup_file);
+
+    return found;
+}
+
+int create_job_cgroup(void) {
+    char mount_point[PATH_MAX];
+    char mount_root[PATH_MAX];
+    char own_cgroup_path[PATH_MAX];
+
+    if (!find_cgroup2_mount(mount_point, sizeof(mount_point), mount_root, sizeof(mount_root))) {
+        if (verbose) fprintf(stderr, "cgroup v2 hierarchy is not mounted\n");
+        return 0;
+    }
+    if (!read_own_cgroup2_path(own_cgroup_path, sizeof(own_cgroup_path))) {
+        if (verbose) fprintf(stderr, "Failed to find cgroup v2 membership in /proc/self/cgroup\n");
+        return 0;
+    }
+
+    // cgroup path is relative to the root of the hierarchy, which is not necessarily what is mounted.
+    const char *own_cgroup_path_relative_to_mount = own_cgroup_path;
+    if (strcmp(mount_root, "/") != 0) {
+        size_t mount_root_length = strlen(mount_root);
+        if (strncmp(own_cgroup_path, mount_root, mount_root_length) != 0) {
+            if (verbose) fprintf(stderr, "cgroup %s is not visible under %s\n", own_cgroup_path, mount_point);
+            return 0;
+        }
+        own_cgroup_path_relative_to_mount += mount_root_length;
+    }
+    if (strcmp(own_cgroup_path_relative_to_mount, "/") == 0) {
+        own_cgroup_path_relative_to_mount = "";
+    }
+
+    int required_path_length = snprintf(parent_cgroup_path, sizeof(parent_cgroup_path), "%s%s", mount_point,
+                                        own_cgroup_path_relative_to_mount);
+    if (required_path_length < 0 || (size_t) required_path_length >= sizeof(parent_cgroup_path)) {
+        parent_cgroup_path[0] = '\0';
+        return 0;
+    }
+    required_path_length = snprintf(job_cgroup_path, sizeof(job_cgroup_path), "%s/runwhenidle-%d",
+                                        parent_cgroup_path, getpid());
+    if (required_path_length < 0 || (size_t) required_path_length >= sizeof(job_cgroup_path)) {
+        job_cgroup_path[0] = '\0';
+        return 0;
+    }
+
+    if (mkdir(job_cgroup_path, 0755) != 0) {
+        if (verbose) {
+            fprintf(stderr, "Failed to create cgroup %s: %s\n", job_cgroup_path, strerror(errno));
+        }
+        job_cgroup_path[0] = '\0';
+        return 0;
+    }
+
+    job_cgroup_directory_file_descriptor = open(job_cgroup_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (job_cgroup_directory_file_descriptor != -1) {
+        job_cgroup_procs_file_descriptor = openat(job_cgroup_directory_file_descriptor, "cgroup.procs",
+                                                  O_WRONLY | O_CLOEXEC);
+    }
+    if (job_cgroup_procs_file_descriptor == -1 ||
+        faccessat(job_cgroup_directory_file_descriptor, "cgroup.freeze", W_OK, 0) != 0) {
+        if (verbose) {
+            fprintf(stderr, "cgroup %s is not usable: %s\n", job_cgroup_path, strerror(errno));
+        }
+        remove_job_cgroup();
+        return 0;
+    }
+
+    if (debug) fprintf(stderr, "Created cgroup %s\n", job_cgroup_path);
+    return 1;
+}
+
+int move_current_process_into_job_cgroup(void) {
+    if (job_cgroup_procs_file_descriptor == -1) {
+        errno = ENOENT;
+        return -1;
+    }
+    // Writing "0" moves the writing process.
+    if (write(job_cgroup_procs_file_descriptor, "0", 1) != 1) {
+        return -1;
+    }
+    return 0;
+}
+
+void mark_job_cgroup_as_containing_command(void) {
+    if (job_cgroup_procs_file_descriptor != -1) {
+        close(job_cgroup_procs_file_descriptor);
+        job_cgroup_procs_file_descriptor = -1;
+    }
+    if (!job_cgroup_has_command) {
+        job_cgroup_has_command = 1;
+        atexit(remove_job_cgroup);
+    }
+}
+
+int job_cgroup_contains_command(void) {
+    return job_cgroup_has_command;
+}
+
+static int write_string_to_file(int directory_file_descriptor, const char *file_name, const char *value) {
+    int file_descriptor = openat(directory_file_descriptor, file_name, O_WRONLY | O_CLOEXEC);
+    if (file_descriptor == -1) {
+        return -1;
+    }
+    size_t value_length = strlen(value);
+    ssize_t bytes_written = write(file_descriptor, value, value_length);
+    int saved_errno = errno;
+    close(file_descriptor);
+    if (bytes_written != (ssize_t) value_length) {
+        errno = bytes_written < 0 ? saved_errno : EIO;
+        return -1;
+    }
+    return 0;
+}
+
+static int write_string_to_job_cgroup_file(const char *file_name, const char *value) {
+    return write_string_to_file(job_cgroup_directory_file_descriptor, file_name, value);
+}
+
+static int write_string_to_cgroup_file(const char *cgroup_path, const char *file_name, const char *value) {
+    char file_path[PATH_MAX];
+    int required_path_length = snprintf(file_path, sizeof(file_path), "%s/%s", cgroup_path, file_name);
+    if (required_path_length < 0 || (size_t) required_path_length >= sizeof(file_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return write_string_to_file(AT_FDCWD, file_path, value);
+}
+
+/**
+ * Moves runwhenidle into a new leaf cgroup next to the job cgroup, so that its own cgroup has no processes left
+ * in it and controllers can be enabled for its children.
+ */
+static int move_current_process_into_supervisor_cgroup(void) {
+    int required_path_length = snprintf(supervisor_cgroup_path, sizeof(supervisor_cgroup_path),
+                                        "%s/runwhenidle-%d-supervisor", parent_cgroup_path, getpid());
+    if (required_path_length < 0 || (size_t) required_path_length >= sizeof(supervisor_cgroup_path)) {
+        supervisor_cgroup_path[0] = '\0';
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (mkdir(supervisor_cgroup_path, 0755) != 0) {
+        supervisor_cgroup_path[0] = '\0';
+        return -1;
+    }
+    if (write_string_to_cgroup_file(supervisor_cgroup_path, "cgroup.procs", "0") != 0) {
+        int saved_errno = errno;
+        rmdir(supervisor_cgroup_path);
+        supervisor_cgroup_path[0] = '\0';
+        errno = saved_errno;
+        return -1;
+    }
+    if (debug) fprintf(stderr, "Moved runwhenidle into cgroup %s\n", supervisor_cgroup_path);
+    return 0;
+}
+
+static void move_current_process_back_from_supervisor_cgroup(void) {
+    if (supervisor_cgroup_path[0] == '\0') {
+        return;
+    }
+    if (write_string_to_cgroup_file(parent_cgroup_path, "cgroup.procs", "0") != 0 ||
+        rmdir(supervisor_cgroup_path) != 0) {
+        if (debug) {
+            fprintf(stderr, "Failed to remove cgroup %s: %s\n", supervisor_cgroup_path, strerror(errno));
+        }
+    }
+    supervisor_cgroup_path[0] = '\0';
+}
+
+/**
+ * @return 1 if the controller is already enabled for children of the parent cgroup, 0 if it isn't or it can't be
+ *         checked.
+ */
+static int controller_is_enabled_for_job_cgroup(const char *controller) {
+    char file_path[PATH_MAX];
+    int required_path_length = snprintf(file_path, sizeof(file_path), "%s/cgroup.subtree_control", parent_cgroup_path);
+    if (required_path_length < 0 || (size_t) required_path_length >= sizeof(file_path)) {
+        return 0;
+    }
+    int file_descriptor = open(file_path, O_RDONLY | O_CLOEXEC);
+    if (file_descriptor == -1) {
+        return 0;
+    }
+    char buffer[256];
+    ssize_t bytes_read = read(file_descriptor, buffer, sizeof(buffer) - 1);
+    close(file_descriptor);
+    if (bytes_read <= 0) {
+        return 0;
+    }
+    buffer[bytes_read] = '\0';
+    char *save_pointer;
+    for (const char *enabled_controller = strtok_r(buffer, " \n", &save_pointer); enabled_controller != NULL;
+         enabled_controller = strtok_r(NULL, " \n", &save_pointer)) {
+        if (strcmp(enabled_controller, controller) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Checks if the parent cgroup has children other than the ones of this process, e.g. of another runwhenidle.
+ * Empty cgroups left behind by runwhenidle processes that have exited are removed.
+ */
+static int parent_cgroup_has_other_children(void) {
+    DIR *parent_cgroup_directory = opendir(parent_cgroup_path);
+    if (!parent_cgroup_directory) {
+        return 1;
+    }
+    int other_children_exist = 0;
+    const struct dirent *directory_entry;
+    while ((directory_entry = readdir(parent_cgroup_directory)) != NULL) {
+        if (directory_entry->d_type != DT_DIR || strcmp(directory_entry->d_name, ".") == 0 ||
+            strcmp(directory_entry->d_name, "..") == 0) {
+            continue;
+        }
+        pid_t owner_pid;
+        int name_length = 0;
+        if (sscanf(directory_entry->d_name, "runwhenidle-%d%n", &owner_pid, &name_length) == 1 &&
+            (directory_entry->d_name[name_length] == '\0' ||
+             strcmp(directory_entry->d_name + name_length, "-supervisor") == 0)) {
+            if (owner_pid == getpid()) {
+                continue;
+            }
+            // Nothing can start using a cgroup of a process that no longer exists.
+            if (kill(owner_pid, 0) != 0 && errno == ESRCH &&
+                unlinkat(dirfd(parent_cgroup_directory), directory_entry->d_name, AT_REMOVEDIR) == 0) {
+                continue;
+            }
+        }
+        other_children_exist = 1;
+    }
+    closedir(parent_cgroup_directory);
+    return other_children_exist;
+}
+
+static int enable_controller_for_job_cgroup(const char *controller) {
+    if (controller_is_enabled_for_job_cgroup(controller)) {
+        // Enabled by someone else, who might still need it after runwhenidle exits.
+        if (debug) fprintf(stderr, "%s controller is already enabled in %s\n", controller, parent_cgroup_path);
+        return 0;
+    }
+    char enable_controller_command[32];
+    snprintf(enable_controller_command, sizeof(enable_controller_command), "+%s", controller);
+    int write_result = write_string_to_cgroup_file(parent_cgroup_path, "cgroup.subtree_control",
+                                                   enable_controller_command);
+    if (write_result != 0 && errno == EBUSY && supervisor_cgroup_path[0] == '\0') {
+        // Controllers can only be enabled for a cgroup without processes in it, unless it's the root cgroup
+        if (move_current_process_into_supervisor_cgroup() != 0) {
+            if (verbose) fprintf(stderr, "Failed to move runwhenidle into its own cgroup: %s\n", strerror(errno));
+            errno = EBUSY;
+            return -1;
+        }
+        write_result = write_string_to_cgroup_file(parent_cgroup_path, "cgroup.subtree_control",
+                                                   enable_controller_command);
+    }
+    if (write_result != 0) {
+        return -1;
+    }
+    size_t enabled_controllers_length = strlen(enabled_parent_cgroup_controllers);
+    snprintf(enabled_parent_cgroup_controllers + enabled_controllers_length,
+             sizeof(enabled_parent_cgroup_controllers) - enabled_controllers_length, "%s-%s",
+             enabled_controllers_length ? " " : "", controller);
+    if (debug) fprintf(stderr, "Enabled %s controller in %s\n", controller, parent_cgroup_path);
+    return 0;
+}
+
+int enable_job_cgroup_throttling_controllers(int io_controller_is_required) {
+    if (job_cgroup_directory_file_descriptor == -1) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (enable_controller_for_job_cgroup("cpu") != 0) {
+        if (verbose) fprintf(stderr, "Failed to enable cpu controller in %s: %s\n", parent_cgroup_path, strerror(errno));
+        return -1;
+    }
+    if (enable_controller_for_job_cgroup("io") != 0) {
+        if (io_controller_is_required) {
+            if (verbose) {
+                fprintf(stderr, "Failed to enable io controller in %s: %s\n", parent_cgroup_path, strerror(errno));
+            }
+            return -1;
+        }
+        if (verbose) fprintf(stderr, "io controller is not available in %s, only CPU will be throttled\n", parent_cgroup_path);
+    }
+    return 0;
+}
+
+int set_job_cgroup_throttled(int throttled, const char *cpu_max, const char *io_max, int io_weight) {
+    if (job_cgroup_directory_file_descriptor == -1) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (debug) {
+        fprintf(stderr, "%s cgroup %s\n", throttled ? "Throttling" : "Removing throttling from", job_cgroup_path);
+    }
+    if (write_string_to_job_cgroup_file("cpu.max", throttled ? cpu_max : "max") != 0) {
+        return -1;
+    }
+
+    if (io_max != NULL) {
+        if (throttled) {
+            // The value starts with MAJ:MIN of the device, which is needed to remove the limit later.
+            sscanf(io_max, "%31s", job_cgroup_io_device);
+            if (write_string_to_job_cgroup_file("io.max", io_max) != 0) {
+                return -1;
+            }
+        } else if (job_cgroup_io_device[0] != '\0') {
+            char io_max_unlimited[96];
+            snprintf(io_max_unlimited, sizeof(io_max_unlimited), "%s rbps=max wbps=max riops=max wiops=max",
+                     job_cgroup_io_device);
+            if (write_string_to_job_cgroup_file("io.max", io_max_unlimited) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    const int DEFAULT_IO_WEIGHT = 100;
+    char io_weight_value[32];
+    snprintf(io_weight_value, sizeof(io_weight_value), "default %d", throttled ? io_weight : DEFAULT_IO_WEIGHT);
+    // io.weight only exists when io controller is enabled, and only takes effect with a weight-based I/O scheduler.
+    if (write_string_to_job_cgroup_file("io.weight", io_weight_value) != 0 && errno != ENOENT && debug) {
+        fprintf(stderr, "Failed to write to %s/io.weight: %s\n", job_cgroup_path, strerror(errno));
+    }
+    return 0;
+}
+
+int enable_job_cgroup_memory_controller(void) {
+    if (job_cgroup_directory_file_descriptor == -1) {
+        errno = ENOENT;
+        return -1;
+    }
+    return enable_controller_for_job_cgroup("memory");
+}
+
+static int read_unsigned_long_long_from_job_cgroup_file(const char *file_name, unsigned long long *value) {
+    int file_descriptor = openat(job_cgroup_directory_file_descriptor, file_name, O_RDONLY | O_CLOEXEC);
+    if (file_descriptor == -1) {
+        return -1;
+    }
+    char buffer[32];
+    ssize_t bytes_read = read(file_descriptor, buffer, sizeof(buffer) - 1);
+    int saved_errno = errno;
+    close(file_descriptor);
+    if (bytes_read <= 0) {
+        errno = bytes_read < 0 ? saved_errno : EIO;
+        return -1;
+    }
+    buffer[bytes_read] = '\0';
+    *value = strtoull(buffer, NULL, 10);
+    return 0;
+}
+
+int reclaim_job_cgroup_memory(unsigned long long *reclaimed_bytes) {
+    if (job_cgroup_directory_file_descriptor == -1) {
+        errno = ENOENT;
+        return -1;
+    }
+    unsigned long long memory_before_reclaim;
+    // memory.current only exists when memory controller is enabled for the cgroup
+    if (read_unsigned_long_long_from_job_cgroup_file("memory.current", &memory_before_reclaim) != 0) {
+        return -1;
+    }
+    char reclaim_amount[32];
+    snprintf(reclaim_amount, sizeof(reclaim_amount), "%llu", memory_before_reclaim);
+    if (debug) fprintf(stderr, "Writing %s to %s/memory.reclaim\n", reclaim_amount, job_cgroup_path);
+    // EAGAIN means that less than requested was reclaimed, which is expected since not everything can be reclaimed.
+    if (write_string_to_job_cgroup_file("memory.reclaim", reclaim_amount) != 0 && errno != EAGAIN) {
+        return -1;
+    }
+    unsigned long long memory_after_reclaim;
+    if (read_unsigned_long_long_from_job_cgroup_file("memory.current", &memory_after_reclaim) != 0) {
+        return -1;
+    }
+    *reclaimed_bytes = memory_after_reclaim < memory_before_reclaim ? memory_before_reclaim - memory_after_reclaim : 0;
+    return 0;
+}
+
+int set_job_cgroup_frozen(int frozen) {
+    if (job_cgroup_directory_file_descriptor == -1) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (debug) fprintf(stderr, "Writing %d to %s/cgroup.freeze\n", frozen ? 1 : 0, job_cgroup_path);
+    return write_string_to_job_cgroup_file("cgroup.freeze", frozen ? "1" : "0");
+}
+
+void remove_job_cgroup(void) {
+    if (job_cgroup_directory_file_descriptor == -1) {
+        return;
+    }
+    // Processes that outlived the command should not stay frozen forever.
+    write_string_to_job_cgroup_file("cgroup.freeze", "0");
+
+    if (job_cgroup_procs_file_descriptor != -1) {
+        close(job_cgroup_procs_file_descriptor);
+        job_cgroup_procs_file_descriptor = -1;
+    }
+    close(job_cgroup_directory_file_descriptor);
+    job_cgroup_directory_file_descriptor = -1;
+
+    if (rmdir(job_cgroup_path) != 0 && debug) {
+        fprintf(stderr, "Failed to remove cgroup %s: %s\n", job_cgroup_path, strerror(errno));
+    }
+    job_cgroup_path[0] = '\0';
+    job_cgroup_has_command = 0;
+
+    // Controllers have to be disabled before runwhenidle can move back into the cgroup it was started in.
+    // They are left enabled while other cgroups, e.g. of another runwhenidle, could still be using them.
+    if (enabled_parent_cgroup_controllers[0] != '\0' && parent_cgroup_has_other_children()) {
+        if (debug) {
+            fprintf(stderr, "Leaving controllers enabled in %s, since it has other child cgroups\n",
+                    parent_cgroup_path);
+        }
+        enabled_parent_cgroup_controllers[0] = '\0';
+    }
+    if (enabled_parent_cgroup_controllers[0] != '\0') {
+        if (write_string_to_cgroup_file(parent_cgroup_path, "cgroup.subtree_control",
+                                        enabled_parent_cgroup_controllers) != 0 && debug) {
+            fprintf(stderr, "Failed to disable controllers in %s: %s\n", parent_cgroup_path, strerror(errno));
+        }
+        enabled_parent_cgroup_controllers[0] = '\0';
+    }
+    move_current_process_back_from_supervisor_cgroup();
+    job_cgroup_io_device[0] = '\0';
+}
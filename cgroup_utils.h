@@ -0,0 +1,78 @@
+#ifndef RUNWHENIDLE_CGROUP_UTILS_H
+#define RUNWHENIDLE_CGROUP_UTILS_H
+
+/**
+ * Creates a cgroup v2 directory for the command as a child of the cgroup runwhenidle is running in.
+ * This only succeeds if the current cgroup is delegated to the user running runwhenidle.
+ *
+ * @return 1 if the cgroup was created, 0 otherwise.
+ */
+int create_job_cgroup(void);
+
+/**
+ * Moves the calling process into the cgroup created by create_job_cgroup().
+ * Meant to be called in the child process between fork() and exec().
+ *
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int move_current_process_into_job_cgroup(void);
+
+/**
+ * Marks the job cgroup as containing the command, so that it's thawed and removed when runwhenidle exits.
+ */
+void mark_job_cgroup_as_containing_command(void);
+
+/**
+ * @return 1 if the command is running inside the job cgroup, 0 otherwise.
+ */
+int job_cgroup_contains_command(void);
+
+/**
+ * Freezes or thaws all processes in the job cgroup by writing to cgroup.freeze.
+ *
+ * @param frozen 1 to freeze, 0 to thaw.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int set_job_cgroup_frozen(int frozen);
+
+/**
+ * Enables cpu and io controllers for the job cgroup. If the cgroup runwhenidle is running in has other processes
+ * in it, which prevents enabling controllers for its children, runwhenidle moves itself into a separate leaf cgroup.
+ *
+ * @param io_controller_is_required If 0, failing to enable io controller is not considered an error.
+ * @return 0 on success, -1 on failure.
+ */
+int enable_job_cgroup_throttling_controllers(int io_controller_is_required);
+
+/**
+ * Limits or stops limiting resources available to the job cgroup.
+ *
+ * @param throttled 1 to apply the limits, 0 to remove them.
+ * @param cpu_max Value for cpu.max, e.g. "25000 100000" to allow 25% of one CPU.
+ * @param io_max Value for io.max, e.g. "8:0 wbps=1048576", or NULL to not limit I/O bandwidth.
+ * @param io_weight Value for io.weight between 1 and 10000.
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int set_job_cgroup_throttled(int throttled, const char *cpu_max, const char *io_max, int io_weight);
+
+/**
+ * Enables memory controller for the job cgroup, so that its memory can be reclaimed with reclaim_job_cgroup_memory().
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int enable_job_cgroup_memory_controller(void);
+
+/**
+ * Asks the kernel to reclaim as much memory of the job cgroup as it can by writing to memory.reclaim.
+ *
+ * @param reclaimed_bytes Set to the decrease of memory.current.
+ * @return 0 on success, -1 on failure (errno is set). errno is ENOENT if memory controller is not enabled.
+ */
+int reclaim_job_cgroup_memory(unsigned long long *reclaimed_bytes);
+
+/**
+ * Thaws and removes the job cgroup if it exists. Removal fails silently if processes are still running in it.
+ */
+void remove_job_cgroup(void);
+
+#endif //RUNWHENIDLE_CGROUP_UTILS_H
@@ -0,0 +1,190 @@
+#include "deadline.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arguments_parsing.h"
+#include "descriptor_utils.h"
+#include "output_settings.h"
+#include "process_tree.h"
+#include "time_utils.h"
+#include "tty_utils.h"
+
+static int deadline_timer_file_descriptor = -1;
+static int behind_deadline = 0;
+// Assume the command uses one CPU while running until it's measured.
+static double cpu_time_per_running_time = 1.0;
+static int run_rate_is_being_measured = 0;
+static struct timespec run_rate_measurement_start_time;
+static long long cpu_time_at_run_rate_measurement_start_ms;
+
+long parse_deadline_time_of_day(const char *time_of_day) {
+    int hours, minutes;
+    char extra_character;
+    if (sscanf(time_of_day, "%d:%d%c", &hours, &minutes, &extra_character) != 2 ||
+        hours < 0 || hours > 23 || minutes < 0 || minutes > 59) {
+        return -1;
+    }
+    time_t now = time(NULL);
+    struct tm deadline_time;
+    localtime_r(&now, &deadline_time);
+    deadline_time.tm_hour = hours;
+    deadline_time.tm_min = minutes;
+    deadline_time.tm_sec = 0;
+    deadline_time.tm_isdst = -1;
+    time_t deadline = mktime(&deadline_time);
+    if (deadline <= now) {
+        deadline_time.tm_mday++;
+        deadline_time.tm_isdst = -1;
+        deadline = mktime(&deadline_time);
+    }
+    return (long) deadline;
+}
+
+/**
+ * Reads utime, stime, cutime and cstime from /proc/PID/stat. cutime and cstime include CPU time of children
+ * that have exited and were waited for, so the command doesn't lose progress when its children exit.
+ *
+ * @return CPU time in milliseconds, or 0 if the process doesn't exist anymore.
+ */
+static long long get_cpu_time_of_process_ms(pid_t process_id) {
+    char stat_file_path[32];
+    snprintf(stat_file_path, sizeof(stat_file_path), "/proc/%i/stat", process_id);
+    FILE *stat_file = fopen(stat_file_path, "r");
+    if (!stat_file) {
+        return 0;
+    }
+    char file_contents[1024];
+    size_t bytes_read = fread(file_contents, 1, sizeof(file_contents) - 1, stat_file);
+    fclose(stat_file);
+    file_contents[bytes_read] = '\0';
+
+    // comm can contain any characters, but nothing after it can contain ")"
+    const char *closing_parenthesis = strrchr(file_contents, ')');
+    long long user_time, system_time, children_user_time, children_system_time;
+    if (!closing_parenthesis ||
+        sscanf(closing_parenthesis + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lld %lld %lld %lld",
+               &user_time, &system_time, &children_user_time, &children_system_time) != 4) {
+        if (debug) fprintf(stderr, "Failed to parse %s\n", stat_file_path);
+        return 0;
+    }
+    return (user_time + system_time + children_user_time + children_system_time) * 1000 / sysconf(_SC_CLK_TCK);
+}
+
+static long long get_cpu_time_of_command_ms(pid_t pid) {
+    long long cpu_time_ms = get_cpu_time_of_process_ms(pid);
+    ProcessInfo *child_processes = get_child_processes(pid);
+    for (size_t child_index = 0; child_processes[child_index].process_id != 0; child_index++) {
+        cpu_time_ms += get_cpu_time_of_process_ms(child_processes[child_index].process_id);
+    }
+    return cpu_time_ms;
+}
+
+/**
+ * @return How long the command can stay paused and still finish by the deadline if it runs without pauses after that.
+ */
+static long long get_time_until_falling_behind_ms(pid_t pid) {
+    struct timespec current_time;
+    clock_gettime(CLOCK_REALTIME, &current_time);
+    long long time_until_deadline_ms =
+            (long long) deadline_timestamp * 1000 - current_time.tv_sec * 1000LL - current_time.tv_nsec / 1000000;
+
+    long long remaining_cpu_time_ms = 0;
+    if (expected_cpu_time_ms) {
+        long long used_cpu_time_ms = get_cpu_time_of_command_ms(pid);
+        if (used_cpu_time_ms < expected_cpu_time_ms) {
+            remaining_cpu_time_ms = expected_cpu_time_ms - used_cpu_time_ms;
+        }
+        if (debug) {
+            fprintf(stderr, "Command has used %lldms of expected %ldms CPU time, running at %.2f CPU\n",
+                    used_cpu_time_ms, expected_cpu_time_ms, cpu_time_per_running_time);
+        }
+    }
+    long long remaining_running_time_ms = (long long) ((double) remaining_cpu_time_ms / cpu_time_per_running_time);
+
+    return time_until_deadline_ms - remaining_running_time_ms;
+}
+
+/**
+ * Arms the timer for the moment the command falls behind, or marks it as behind if that moment has passed.
+ */
+static void arm_deadline_timer_or_fall_behind(pid_t pid) {
+    long long time_until_falling_behind_ms = get_time_until_falling_behind_ms(pid);
+    if (time_until_falling_behind_ms <= 0) {
+        behind_deadline = 1;
+        if (!quiet) {
+            printf("Command needs to run without pauses to finish by the deadline\n");
+        }
+        return;
+    }
+    if (debug) fprintf(stderr, "Command will fall behind the deadline in %lldms\n", time_until_falling_behind_ms);
+    if (arm_one_shot_timer_file_descriptor_after_ms(deadline_timer_file_descriptor,
+                                                    (long) time_until_falling_behind_ms) < 0) {
+        fprintf_error("Failed to arm deadline timer: %s\n", strerror(errno));
+    }
+}
+
+int create_deadline_timer_file_descriptor(pid_t pid) {
+    if (!deadline_timestamp) {
+        return -1;
+    }
+    if (deadline_timer_file_descriptor == -1) {
+        // Created disarmed and armed below.
+        deadline_timer_file_descriptor = create_one_shot_timer_file_descriptor_after_ms(0);
+        if (deadline_timer_file_descriptor == -1) {
+            fprintf_error("Failed to create deadline timer: %s, command will not be guaranteed to finish by the deadline\n",
+                          strerror(errno));
+            return -1;
+        }
+        arm_deadline_timer_or_fall_behind(pid);
+    }
+    return deadline_timer_file_descriptor;
+}
+
+int handle_deadline_timer_expiration(pid_t pid) {
+    if (consume_timer_file_descriptor_checked(deadline_timer_file_descriptor, "deadline") < 0) {
+        return -1;
+    }
+    if (behind_deadline) {
+        return 1;
+    }
+    // The command could have been running since the timer was armed, which moves the moment it falls behind.
+    arm_deadline_timer_or_fall_behind(pid);
+    return behind_deadline;
+}
+
+int command_is_behind_deadline(void) {
+    return behind_deadline;
+}
+
+void start_measuring_command_run_rate(pid_t pid) {
+    if (!deadline_timestamp || !expected_cpu_time_ms) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &run_rate_measurement_start_time);
+    cpu_time_at_run_rate_measurement_start_ms = get_cpu_time_of_command_ms(pid);
+    run_rate_is_being_measured = 1;
+}
+
+void stop_measuring_command_run_rate(pid_t pid) {
+    if (!run_rate_is_being_measured) {
+        return;
+    }
+    run_rate_is_being_measured = 0;
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    long long running_time_ms = get_elapsed_time_ms(run_rate_measurement_start_time, current_time);
+    long long cpu_time_ms = get_cpu_time_of_command_ms(pid) - cpu_time_at_run_rate_measurement_start_ms;
+    // Short runs are dominated by the resolution of CPU time accounting.
+    const long long MIN_RUNNING_TIME_FOR_MEASUREMENT_MS = 1000;
+    if (running_time_ms < MIN_RUNNING_TIME_FOR_MEASUREMENT_MS || cpu_time_ms <= 0) {
+        return;
+    }
+    cpu_time_per_running_time = (double) cpu_time_ms / (double) running_time_ms;
+    if (debug) {
+        fprintf(stderr, "Command has used %lldms of CPU time in %lldms of running\n", cpu_time_ms, running_time_ms);
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef RUNWHENIDLE_DEADLINE_H
+#define RUNWHENIDLE_DEADLINE_H
+
+#include <sys/types.h>
+
+/**
+ * Parses time of day in HH:MM format into the nearest such moment in the future.
+ *
+ * @return Seconds since epoch or -1 if the format is invalid.
+ */
+long parse_deadline_time_of_day(const char *time_of_day);
+
+/**
+ * Creates the timer that expires when the command would not be able to finish by deadline_timestamp
+ * if it was paused any longer, and arms it for the command.
+ *
+ * @param pid The process ID of the command.
+ * @return Timer file descriptor, or -1 if there is no deadline or the timer could not be created.
+ */
+int create_deadline_timer_file_descriptor(pid_t pid);
+
+/**
+ * Re-evaluates how far the command is from falling behind the deadline. Should be called when the timer expires.
+ * If the command has made enough progress since the timer was armed, the timer is armed again.
+ *
+ * @param pid The process ID of the command.
+ * @return 1 if the command has fallen behind and should not be paused anymore, 0 if not, -1 if reading the timer failed.
+ */
+int handle_deadline_timer_expiration(pid_t pid);
+
+/**
+ * @return 1 if the command has fallen behind the deadline and should not be paused anymore, 0 otherwise.
+ */
+int command_is_behind_deadline(void);
+
+/**
+ * Starts measuring how much CPU time the command uses per second when it's running. Should be called when the command
+ * is resumed.
+ *
+ * @param pid The process ID of the command.
+ */
+void start_measuring_command_run_rate(pid_t pid);
+
+/**
+ * Finishes the measurement started by start_measuring_command_run_rate(). Should be called when the command
+ * is paused.
+ *
+ * @param pid The process ID of the command.
+ */
+void stop_measuring_command_run_rate(pid_t pid);
+
+#endif //RUNWHENIDLE_DEADLINE_H
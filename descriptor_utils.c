@@ -8,17 +8,21 @@
 
 #include "tty_utils.h"
 
+int arm_one_shot_timer_file_descriptor_after_ms(int timer_file_descriptor, long delay_ms) {
+    struct itimerspec timer_spec = {0};
+    timer_spec.it_value.tv_sec = delay_ms / 1000;
+    timer_spec.it_value.tv_nsec = (delay_ms % 1000) * 1000000L;
+
+    return timerfd_settime(timer_file_descriptor, 0, &timer_spec, NULL);
+}
+
 int create_one_shot_timer_file_descriptor_after_ms(long delay_ms) {
     int timer_file_descriptor = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
     if (timer_file_descriptor < 0) {
         return -1;
     }
 
-    struct itimerspec timer_spec = {0};
-    timer_spec.it_value.tv_sec = delay_ms / 1000;
-    timer_spec.it_value.tv_nsec = (delay_ms % 1000) * 1000000L;
-
-    if (timerfd_settime(timer_file_descriptor, 0, &timer_spec, NULL) < 0) {
+    if (arm_one_shot_timer_file_descriptor_after_ms(timer_file_descriptor, delay_ms) < 0) {
         close(timer_file_descriptor);
         return -1;
     }
@@ -44,6 +48,17 @@ int create_periodic_timer_file_descriptor_every_ms(long interval_ms) {
     return timer_file_descriptor;
 }
 
+int create_wall_clock_timer_file_descriptor(void) {
+    return timerfd_create(CLOCK_REALTIME, TFD_CLOEXEC | TFD_NONBLOCK);
+}
+
+int arm_wall_clock_timer_file_descriptor_at(int timer_file_descriptor, time_t expiration_time) {
+    struct itimerspec timer_spec = {0};
+    timer_spec.it_value.tv_sec = expiration_time;
+
+    return timerfd_settime(timer_file_descriptor, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &timer_spec, NULL);
+}
+
 void close_file_descriptor_if_open(int *file_descriptor, const char *description) {
     if (*file_descriptor < 0) {
         return;
@@ -76,6 +91,11 @@ int consume_timer_file_descriptor_checked(int timer_file_descriptor, const char
         return 0;
     }
 
+    // Wall clock timer was cancelled because the clock was changed, it has to be armed again just like after expiring.
+    if (bytes_read < 0 && errno == ECANCELED) {
+        return 0;
+    }
+
     if (bytes_read < 0) {
         const int saved_errno = errno;
         fprintf_error("Failed to read %s timer file descriptor: %s\n",
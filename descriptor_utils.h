@@ -1,8 +1,29 @@
 #ifndef RUNWHENIDLE_DESCRIPTOR_UTILS_H
 #define RUNWHENIDLE_DESCRIPTOR_UTILS_H
 
+#include <time.h>
+
 int create_one_shot_timer_file_descriptor_after_ms(long delay_ms);
+/**
+ * Makes the timer expire once after the delay, replacing any previous setting. Delay of 0 disarms the timer.
+ *
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int arm_one_shot_timer_file_descriptor_after_ms(int timer_file_descriptor, long delay_ms);
 int create_periodic_timer_file_descriptor_every_ms(long interval_ms);
+/**
+ * Creates a disarmed timer that measures time using the wall clock.
+ *
+ * @return Timer file descriptor or -1 on failure (errno is set).
+ */
+int create_wall_clock_timer_file_descriptor(void);
+/**
+ * Makes the wall clock timer expire at the specified time. The timer also becomes readable if the wall clock is set,
+ * e.g. manually or by NTP, so that the expiration time can be recalculated. Time zone changes don't set the clock.
+ *
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int arm_wall_clock_timer_file_descriptor_at(int timer_file_descriptor, time_t expiration_time);
 void close_file_descriptor_if_open(int *file_descriptor, const char *description);
 int consume_timer_file_descriptor_checked(int timer_file_descriptor, const char *description);
 #endif //RUNWHENIDLE_DESCRIPTOR_UTILS_H
\ No newline at end of file
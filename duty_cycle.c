@@ -0,0 +1,93 @@
+#include "duty_cycle.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "arguments_parsing.h"
+#include "descriptor_utils.h"
+#include "output_settings.h"
+#include "process_handling.h"
+#include "tty_utils.h"
+
+static int duty_cycle_timer_file_descriptor = -1;
+static int duty_cycle_is_active = 0;
+static int command_is_running_in_duty_cycle = 0;
+
+static long get_running_time_ms(void) {
+    return duty_cycle_period_ms * duty_cycle_percent / 100;
+}
+
+static long get_paused_time_ms(void) {
+    return duty_cycle_period_ms - get_running_time_ms();
+}
+
+static void arm_duty_cycle_timer(long delay_ms) {
+    if (arm_one_shot_timer_file_descriptor_after_ms(duty_cycle_timer_file_descriptor, delay_ms) < 0) {
+        fprintf_error("Failed to arm duty cycle timer: %s\n", strerror(errno));
+    }
+}
+
+int create_duty_cycle_timer_file_descriptor(void) {
+    if (!duty_cycle_percent) {
+        return -1;
+    }
+    if (duty_cycle_timer_file_descriptor == -1) {
+        // Created disarmed, start_duty_cycle() arms it.
+        duty_cycle_timer_file_descriptor = create_one_shot_timer_file_descriptor_after_ms(0);
+        if (duty_cycle_timer_file_descriptor == -1) {
+            fprintf_error("Failed to create duty cycle timer: %s, command will stay paused while user is active\n",
+                          strerror(errno));
+        }
+    }
+    return duty_cycle_timer_file_descriptor;
+}
+
+void start_duty_cycle(void) {
+    if (duty_cycle_timer_file_descriptor == -1) {
+        return;
+    }
+    duty_cycle_is_active = 1;
+    command_is_running_in_duty_cycle = 0;
+    arm_duty_cycle_timer(get_paused_time_ms());
+    if (verbose) {
+        fprintf(stderr, "Command will be running for %ldms every %ldms while user is active\n",
+                get_running_time_ms(), duty_cycle_period_ms);
+    }
+}
+
+void stop_duty_cycle(void) {
+    if (!duty_cycle_is_active) {
+        return;
+    }
+    arm_duty_cycle_timer(0);
+    duty_cycle_is_active = 0;
+    // Timer could have expired before it was disarmed.
+    consume_timer_file_descriptor_checked(duty_cycle_timer_file_descriptor, "duty cycle");
+}
+
+int handle_duty_cycle_timer_expiration(pid_t pid) {
+    if (consume_timer_file_descriptor_checked(duty_cycle_timer_file_descriptor, "duty cycle") < 0) {
+        return -1;
+    }
+    if (!duty_cycle_is_active) {
+        return 0;
+    }
+
+    // Messages for every cycle would drown out everything else.
+    set_pause_messages_enabled(0);
+    if (command_is_running_in_duty_cycle) {
+        if (debug) fprintf(stderr, "Duty cycle: pausing the command for %ldms\n", get_paused_time_ms());
+        pause_command_recursively(pid);
+        command_is_running_in_duty_cycle = 0;
+        arm_duty_cycle_timer(get_paused_time_ms());
+    } else {
+        if (debug) fprintf(stderr, "Duty cycle: resuming the command for %ldms\n", get_running_time_ms());
+        resume_command_recursively(pid);
+        command_is_running_in_duty_cycle = 1;
+        arm_duty_cycle_timer(get_running_time_ms());
+    }
+    set_pause_messages_enabled(1);
+
+    return 0;
+}
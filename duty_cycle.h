@@ -0,0 +1,32 @@
+#ifndef RUNWHENIDLE_DUTY_CYCLE_H
+#define RUNWHENIDLE_DUTY_CYCLE_H
+
+#include <sys/types.h>
+
+/**
+ * Creates the timer used to alternate between running and pausing the command while the user is active.
+ *
+ * @return Timer file descriptor, or -1 if duty cycle is disabled or the timer could not be created.
+ */
+int create_duty_cycle_timer_file_descriptor(void);
+
+/**
+ * Starts the duty cycle for a command that was just paused. The command will be resumed for
+ * duty_cycle_percent of every duty_cycle_period_ms.
+ */
+void start_duty_cycle(void);
+
+/**
+ * Stops the duty cycle. The command can be either paused or running after this.
+ */
+void stop_duty_cycle(void);
+
+/**
+ * Resumes or pauses the command, whichever is next in the duty cycle. Should be called when the timer expires.
+ *
+ * @param pid The process ID of the command.
+ * @return 0 on success, -1 if reading the timer failed.
+ */
+int handle_duty_cycle_timer_expiration(pid_t pid);
+
+#endif //RUNWHENIDLE_DUTY_CYCLE_H
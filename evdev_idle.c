@@ -0,0 +1,368 @@
+#include "evdev_idle.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/ioctl.h>
+
+#include "descriptor_utils.h"
+#include "idle_time_tracking.h"
+#include "output_settings.h"
+#include "time_utils.h"
+#include "tty_utils.h"
+
+#define INPUT_DEVICE_DIRECTORY "/dev/input"
+#define MAX_EVDEV_DEVICES 64
+// Values of epoll_event.data for descriptors other than devices, which use their index
+#define INOTIFY_EVENT_DATA UINT32_MAX
+#define IDLE_TIME_TIMER_EVENT_DATA (UINT32_MAX - 1)
+
+#define BITS_PER_LONG (sizeof(long) * CHAR_BIT)
+#define BIT_IS_SET(bits, bit) (((bits)[(bit) / BITS_PER_LONG] >> ((bit) % BITS_PER_LONG)) & 1)
+
+typedef struct EvdevDevice {
+    int file_descriptor; // -1 if the slot is free
+    unsigned number; // N in /dev/input/eventN
+    int timestamps_are_monotonic; // Otherwise the time of reading is used as the time of the event
+} EvdevDevice;
+
+static int evdev_epoll_file_descriptor = -1; // Waits for devices, inotify and idle time
+static int inotify_file_descriptor = -1;
+static int idle_time_timer_file_descriptor = -1;
+static EvdevDevice evdev_devices[MAX_EVDEV_DEVICES];
+/**
+ * Whether events on devices wake up. When they don't, they stay queued in the kernel and are read when idle time is
+ * queried, so that typing while the command is paused doesn't wake runwhenidle up on every key press. Event timestamps
+ * make idle time exact either way.
+ */
+static int device_events_wake_up = 0;
+
+static int event_is_user_activity(const struct input_event *event) {
+    switch (event->type) {
+        case EV_KEY:
+        case EV_REL:
+        case EV_ABS:
+            return 1;
+        case EV_SYN:
+            // Events were dropped because they were not read in time, the kernel keeps the most recent ones.
+            return event->code == SYN_DROPPED;
+        default:
+            // LEDs, switches, sounds and similar events don't come from the user touching the device.
+            return 0;
+    }
+}
+
+static void record_user_activity_at(struct timespec activity_time) {
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    const long long user_idle_time_ms = get_elapsed_time_ms(activity_time, current_time);
+    const long unsigned user_idle_time_since_activity_ms = user_idle_time_ms > 0 ? user_idle_time_ms : 0;
+    // Devices are read one after another, activity that was read earlier could be more recent.
+    if (user_idle_time_since_activity_ms < get_tracked_user_idle_time_ms()) {
+        set_tracked_user_idle_time(user_idle_time_since_activity_ms);
+    }
+}
+
+/**
+ * Reads all queued events from the device.
+ *
+ * @return 1 if there was user activity, 0 if there wasn't, -1 if the device was removed or reading from it failed.
+ */
+static int read_evdev_device(EvdevDevice *device) {
+    struct input_event events[64];
+    ssize_t bytes_read;
+    int user_was_active = 0;
+    struct timespec last_activity_time;
+    while ((bytes_read = read(device->file_descriptor, events, sizeof(events))) > 0) {
+        const size_t event_count = bytes_read / sizeof(events[0]);
+        for (size_t event_index = 0; event_index < event_count; event_index++) {
+            if (!event_is_user_activity(&events[event_index])) {
+                continue;
+            }
+            user_was_active = 1;
+            if (device->timestamps_are_monotonic) {
+                last_activity_time.tv_sec = events[event_index].input_event_sec;
+                last_activity_time.tv_nsec = events[event_index].input_event_usec * 1000;
+            } else {
+                clock_gettime(CLOCK_MONOTONIC, &last_activity_time);
+            }
+        }
+    }
+    const int read_errno = errno;
+    if (user_was_active) {
+        if (debug) fprintf(stderr, "evdev: user activity on %s/event%u\n", INPUT_DEVICE_DIRECTORY, device->number);
+        record_user_activity_at(last_activity_time);
+    }
+    if (bytes_read < 0 && (read_errno == EAGAIN || read_errno == EINTR)) {
+        return user_was_active;
+    }
+    if (bytes_read < 0 && read_errno != ENODEV) {
+        fprintf_error("Failed to read from %s/event%u: %s\n", INPUT_DEVICE_DIRECTORY, device->number,
+                      strerror(read_errno));
+    }
+    return -1;
+}
+
+static void close_evdev_device(EvdevDevice *device) {
+    if (verbose) fprintf(stderr, "Stopped watching %s/event%u\n", INPUT_DEVICE_DIRECTORY, device->number);
+    epoll_ctl(evdev_epoll_file_descriptor, EPOLL_CTL_DEL, device->file_descriptor, NULL);
+    close_file_descriptor_if_open(&device->file_descriptor, "input device");
+}
+
+/**
+ * @return 1 if the device can report user activity, 0 if it only has switches, LEDs, sensors and similar.
+ */
+static int evdev_device_is_used_by_user(int device_file_descriptor) {
+    unsigned long event_type_bits[EV_MAX / BITS_PER_LONG + 1] = {0};
+    if (ioctl(device_file_descriptor, EVIOCGBIT(0, sizeof(event_type_bits)), event_type_bits) < 0) {
+        return 0;
+    }
+    if (!BIT_IS_SET(event_type_bits, EV_KEY) && !BIT_IS_SET(event_type_bits, EV_REL) &&
+        !BIT_IS_SET(event_type_bits, EV_ABS)) {
+        return 0;
+    }
+    // Accelerometers report absolute position whenever the device moves.
+    unsigned long property_bits[INPUT_PROP_MAX / BITS_PER_LONG + 1] = {0};
+    if (ioctl(device_file_descriptor, EVIOCGPROP(sizeof(property_bits)), property_bits) >= 0 &&
+        BIT_IS_SET(property_bits, INPUT_PROP_ACCELEROMETER)) {
+        return 0;
+    }
+    return 1;
+}
+
+static void open_evdev_device(const char *file_name) {
+    unsigned device_number;
+    int file_name_length = 0;
+    if (sscanf(file_name, "event%u%n", &device_number, &file_name_length) != 1 || file_name[file_name_length] != '\0') {
+        return;
+    }
+    uint32_t device_index = MAX_EVDEV_DEVICES;
+    for (uint32_t checked_device_index = 0; checked_device_index < MAX_EVDEV_DEVICES; checked_device_index++) {
+        if (evdev_devices[checked_device_index].file_descriptor == -1) {
+            if (device_index == MAX_EVDEV_DEVICES) {
+                device_index = checked_device_index;
+            }
+        } else if (evdev_devices[checked_device_index].number == device_number) {
+            return;
+        }
+    }
+    if (device_index == MAX_EVDEV_DEVICES) {
+        fprintf_error("Too many input devices, not watching %s/%s\n", INPUT_DEVICE_DIRECTORY, file_name);
+        return;
+    }
+
+    char device_path[sizeof(INPUT_DEVICE_DIRECTORY) + NAME_MAX + 1];
+    snprintf(device_path, sizeof(device_path), "%s/%s", INPUT_DEVICE_DIRECTORY, file_name);
+    const int device_file_descriptor = open(device_path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (device_file_descriptor == -1) {
+        // Permissions of new devices are often set after they are created, they will be opened again then.
+        if (debug) fprintf(stderr, "evdev: failed to open %s: %s\n", device_path, strerror(errno));
+        return;
+    }
+    if (!evdev_device_is_used_by_user(device_file_descriptor)) {
+        if (debug) fprintf(stderr, "evdev: %s doesn't report user activity, ignoring it\n", device_path);
+        close(device_file_descriptor);
+        return;
+    }
+    const int clock_id = CLOCK_MONOTONIC;
+    EvdevDevice *device = &evdev_devices[device_index];
+    device->timestamps_are_monotonic = ioctl(device_file_descriptor, EVIOCSCLOCKID, &clock_id) == 0;
+    struct epoll_event event = {.events = device_events_wake_up ? EPOLLIN : 0, .data.u32 = device_index};
+    if (epoll_ctl(evdev_epoll_file_descriptor, EPOLL_CTL_ADD, device_file_descriptor, &event) != 0) {
+        fprintf_error("Failed to wait for %s: %s\n", device_path, strerror(errno));
+        close(device_file_descriptor);
+        return;
+    }
+    device->file_descriptor = device_file_descriptor;
+    device->number = device_number;
+    if (verbose) {
+        char device_name[256] = "unknown";
+        ioctl(device_file_descriptor, EVIOCGNAME(sizeof(device_name)), device_name);
+        device_name[sizeof(device_name) - 1] = '\0';
+        fprintf(stderr, "Watching %s (%s) for user activity\n", device_path, device_name);
+    }
+}
+
+static void open_all_evdev_devices(void) {
+    DIR *input_device_directory = opendir(INPUT_DEVICE_DIRECTORY);
+    if (!input_device_directory) {
+        return;
+    }
+    const struct dirent *directory_entry;
+    while ((directory_entry = readdir(input_device_directory)) != NULL) {
+        open_evdev_device(directory_entry->d_name);
+    }
+    closedir(input_device_directory);
+}
+
+static void handle_input_device_directory_changes(void) {
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t bytes_read;
+    while ((bytes_read = read(inotify_file_descriptor, buffer, sizeof(buffer))) > 0) {
+        for (char *position = buffer; position < buffer + bytes_read;) {
+            const struct inotify_event *inotify_event = (const struct inotify_event *) position;
+            position += sizeof(struct inotify_event) + inotify_event->len;
+            if (inotify_event->mask & IN_Q_OVERFLOW) {
+                open_all_evdev_devices();
+                continue;
+            }
+            if (inotify_event->len == 0) {
+                continue;
+            }
+            if (inotify_event->mask & (IN_CREATE | IN_ATTRIB)) {
+                open_evdev_device(inotify_event->name);
+                continue;
+            }
+            // Removed devices are also reported as readable with an error, this only handles them sooner.
+            unsigned device_number;
+            int file_name_length = 0;
+            if (sscanf(inotify_event->name, "event%u%n", &device_number, &file_name_length) != 1 ||
+                inotify_event->name[file_name_length] != '\0') {
+                continue;
+            }
+            for (uint32_t device_index = 0; device_index < MAX_EVDEV_DEVICES; device_index++) {
+                if (evdev_devices[device_index].file_descriptor != -1 &&
+                    evdev_devices[device_index].number == device_number) {
+                    close_evdev_device(&evdev_devices[device_index]);
+                }
+            }
+        }
+    }
+}
+
+static void teardown_evdev_idle_source(void) {
+    for (uint32_t device_index = 0; device_index < MAX_EVDEV_DEVICES; device_index++) {
+        if (evdev_devices[device_index].file_descriptor != -1) {
+            close_file_descriptor_if_open(&evdev_devices[device_index].file_descriptor, "input device");
+        }
+    }
+    close_file_descriptor_if_open(&inotify_file_descriptor, "input device inotify");
+    close_file_descriptor_if_open(&evdev_epoll_file_descriptor, "input device epoll");
+    stop_tracking_user_idle_time();
+    idle_time_timer_file_descriptor = -1;
+}
+
+static int init_evdev_idle_source(void) {
+    for (uint32_t device_index = 0; device_index < MAX_EVDEV_DEVICES; device_index++) {
+        evdev_devices[device_index].file_descriptor = -1;
+    }
+    device_events_wake_up = 0;
+    evdev_epoll_file_descriptor = epoll_create1(EPOLL_CLOEXEC);
+    if (evdev_epoll_file_descriptor == -1) {
+        fprintf_error("Failed to create epoll file descriptor for input devices: %s\n", strerror(errno));
+        return 0;
+    }
+    idle_time_timer_file_descriptor = start_tracking_user_idle_time();
+    struct epoll_event timer_event = {.events = EPOLLIN, .data.u32 = IDLE_TIME_TIMER_EVENT_DATA};
+    if (idle_time_timer_file_descriptor == -1 ||
+        epoll_ctl(evdev_epoll_file_descriptor, EPOLL_CTL_ADD, idle_time_timer_file_descriptor, &timer_event) != 0) {
+        teardown_evdev_idle_source();
+        return 0;
+    }
+
+    // Watching is started before opening the devices, so that devices added in between are not missed.
+    inotify_file_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_file_descriptor == -1 ||
+        inotify_add_watch(inotify_file_descriptor, INPUT_DEVICE_DIRECTORY, IN_CREATE | IN_ATTRIB | IN_DELETE) < 0) {
+        if (verbose) fprintf(stderr, "Failed to watch %s: %s\n", INPUT_DEVICE_DIRECTORY, strerror(errno));
+        teardown_evdev_idle_source();
+        return 0;
+    }
+    struct epoll_event inotify_event = {.events = EPOLLIN, .data.u32 = INOTIFY_EVENT_DATA};
+    if (epoll_ctl(evdev_epoll_file_descriptor, EPOLL_CTL_ADD, inotify_file_descriptor, &inotify_event) != 0) {
+        fprintf_error("Failed to wait for changes in %s: %s\n", INPUT_DEVICE_DIRECTORY, strerror(errno));
+        teardown_evdev_idle_source();
+        return 0;
+    }
+
+    open_all_evdev_devices();
+    for (uint32_t device_index = 0; device_index < MAX_EVDEV_DEVICES; device_index++) {
+        if (evdev_devices[device_index].file_descriptor != -1) {
+            return 1;
+        }
+    }
+    if (verbose) fprintf(stderr, "No input devices in %s could be opened\n", INPUT_DEVICE_DIRECTORY);
+    teardown_evdev_idle_source();
+    return 0;
+}
+
+static int get_evdev_idle_source_file_descriptor(void) {
+    return evdev_epoll_file_descriptor;
+}
+
+static int handle_evdev_idle_source_events(uint32_t events) {
+    (void)events;
+    struct epoll_event ready_events[MAX_EVDEV_DEVICES + 2];
+    const int ready_event_count = epoll_wait(evdev_epoll_file_descriptor, ready_events, MAX_EVDEV_DEVICES + 2, 0);
+    if (ready_event_count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    int user_idle_time_has_changed = 0;
+    for (int event_index = 0; event_index < ready_event_count; event_index++) {
+        const uint32_t data = ready_events[event_index].data.u32;
+        if (data == INOTIFY_EVENT_DATA) {
+            handle_input_device_directory_changes();
+        } else if (data == IDLE_TIME_TIMER_EVENT_DATA) {
+            if (handle_tracked_user_idle_time_timer_expiration() < 0) {
+                return -1;
+            }
+            user_idle_time_has_changed = 1;
+        } else if (evdev_devices[data].file_descriptor != -1) {
+            const int read_result = read_evdev_device(&evdev_devices[data]);
+            if (read_result < 0) {
+                close_evdev_device(&evdev_devices[data]);
+            } else if (read_result > 0 && device_events_wake_up) {
+                user_idle_time_has_changed = 1;
+            }
+        }
+    }
+    return user_idle_time_has_changed;
+}
+
+static long unsigned query_evdev_idle_time_ms(void) {
+    // Events that didn't wake up are still queued.
+    for (uint32_t device_index = 0; device_index < MAX_EVDEV_DEVICES; device_index++) {
+        if (evdev_devices[device_index].file_descriptor != -1 && read_evdev_device(&evdev_devices[device_index]) < 0) {
+            close_evdev_device(&evdev_devices[device_index]);
+        }
+    }
+    return get_tracked_user_idle_time_ms();
+}
+
+static int prepare_evdev_idle_source_to_wait(long unsigned wake_up_at_idle_time_ms, long unsigned user_idle_time_ms) {
+    const int device_events_should_wake_up = user_idle_time_ms != 0;
+    if (device_events_should_wake_up != device_events_wake_up) {
+        device_events_wake_up = device_events_should_wake_up;
+        for (uint32_t device_index = 0; device_index < MAX_EVDEV_DEVICES; device_index++) {
+            if (evdev_devices[device_index].file_descriptor == -1) {
+                continue;
+            }
+            struct epoll_event event = {.events = device_events_wake_up ? EPOLLIN : 0, .data.u32 = device_index};
+            if (epoll_ctl(evdev_epoll_file_descriptor, EPOLL_CTL_MOD, evdev_devices[device_index].file_descriptor,
+                          &event) != 0) {
+                fprintf_error("Failed to wait for %s/event%u: %s\n", INPUT_DEVICE_DIRECTORY,
+                              evdev_devices[device_index].number, strerror(errno));
+                return -1;
+            }
+        }
+    }
+    return wake_up_at_tracked_user_idle_time(wake_up_at_idle_time_ms);
+}
+
+const IdleSource evdev_idle_source = {
+        .name = "evdev",
+        .init = init_evdev_idle_source,
+        .get_file_descriptor = get_evdev_idle_source_file_descriptor,
+        .on_readable = handle_evdev_idle_source_events,
+        .query_idle_time_ms = query_evdev_idle_time_ms,
+        .prepare_to_wait = prepare_evdev_idle_source_to_wait,
+        .teardown = teardown_evdev_idle_source,
+};
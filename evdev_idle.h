@@ -0,0 +1,13 @@
+#ifndef RUNWHENIDLE_EVDEV_IDLE_H
+#define RUNWHENIDLE_EVDEV_IDLE_H
+
+#include "idle_sources.h"
+
+/**
+ * Treats key presses, pointer movement and touches on /dev/input/event* devices as user activity, which works without
+ * a graphical session. Devices that are added or removed later are picked up through inotify.
+ * Requires read access to the devices, usually by being root or a member of the input group.
+ */
+extern const IdleSource evdev_idle_source;
+
+#endif //RUNWHENIDLE_EVDEV_IDLE_H
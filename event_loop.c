@@ -0,0 +1,97 @@
+#include "event_loop.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+
+#include "output_settings.h"
+#include "tty_utils.h"
+
+#define MAX_EVENT_SOURCES 32
+
+typedef struct EventSource {
+    int file_descriptor; // -1 if the slot is free
+    EventHandler handler;
+} EventSource;
+
+static int epoll_file_descriptor = -1;
+static EventSource event_sources[MAX_EVENT_SOURCES];
+static size_t event_source_slot_count = 0;
+
+static int find_event_source(int file_descriptor) {
+    for (size_t source_index = 0; source_index < event_source_slot_count; source_index++) {
+        if (event_sources[source_index].file_descriptor == file_descriptor) {
+            return (int) source_index;
+        }
+    }
+    return -1;
+}
+
+int add_event_source(int file_descriptor, uint32_t events, EventHandler handler) {
+    if (file_descriptor == -1) {
+        return 0;
+    }
+    if (epoll_file_descriptor == -1) {
+        epoll_file_descriptor = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_file_descriptor == -1) {
+            fprintf_error("Failed to create epoll file descriptor: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    int source_index = find_event_source(-1);
+    if (source_index == -1) {
+        if (event_source_slot_count == MAX_EVENT_SOURCES) {
+            fprintf_error("Too many event sources, can't wait for file descriptor %d\n", file_descriptor);
+            return -1;
+        }
+        source_index = (int) event_source_slot_count++;
+    }
+    struct epoll_event event = {.events = events, .data.u32 = (uint32_t) source_index};
+    if (epoll_ctl(epoll_file_descriptor, EPOLL_CTL_ADD, file_descriptor, &event) != 0) {
+        fprintf_error("Failed to wait for file descriptor %d: %s\n", file_descriptor, strerror(errno));
+        return -1;
+    }
+    event_sources[source_index].file_descriptor = file_descriptor;
+    event_sources[source_index].handler = handler;
+    return 0;
+}
+
+int change_event_source_events(int file_descriptor, uint32_t events) {
+    const int source_index = find_event_source(file_descriptor);
+    if (source_index == -1 || file_descriptor == -1) {
+        return -1;
+    }
+    struct epoll_event event = {.events = events, .data.u32 = (uint32_t) source_index};
+    return epoll_ctl(epoll_file_descriptor, EPOLL_CTL_MOD, file_descriptor, &event);
+}
+
+void remove_event_source(int file_descriptor) {
+    const int source_index = find_event_source(file_descriptor);
+    if (source_index == -1 || file_descriptor == -1) {
+        return;
+    }
+    epoll_ctl(epoll_file_descriptor, EPOLL_CTL_DEL, file_descriptor, NULL);
+    event_sources[source_index].file_descriptor = -1;
+}
+
+int wait_for_events(int timeout_ms) {
+    if (epoll_file_descriptor == -1) {
+        errno = EBADF;
+        return -1;
+    }
+    struct epoll_event events[MAX_EVENT_SOURCES];
+    const int event_count = epoll_wait(epoll_file_descriptor, events, MAX_EVENT_SOURCES, timeout_ms);
+    if (event_count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    if (debug) fprintf(stderr, "Woken up by %d events\n", event_count);
+    for (int event_index = 0; event_index < event_count; event_index++) {
+        const EventSource *event_source = &event_sources[events[event_index].data.u32];
+        // A handler called earlier could have removed the source.
+        if (event_source->file_descriptor != -1) {
+            event_source->handler(events[event_index].events);
+        }
+    }
+    return event_count;
+}
@@ -0,0 +1,42 @@
+#ifndef RUNWHENIDLE_EVENT_LOOP_H
+#define RUNWHENIDLE_EVENT_LOOP_H
+
+#include <stdint.h>
+
+/**
+ * Called from wait_for_events() when the file descriptor it was registered for is ready.
+ *
+ * @param events EPOLLIN, EPOLLOUT, EPOLLHUP and EPOLLERR flags that are set.
+ */
+typedef void (*EventHandler)(uint32_t events);
+
+/**
+ * Registers a file descriptor to wait for in wait_for_events(). Does nothing for -1, so that file descriptors
+ * of features that are disabled can be passed as is.
+ *
+ * @param events EPOLLIN and/or EPOLLOUT.
+ * @return 0 on success, -1 on failure.
+ */
+int add_event_source(int file_descriptor, uint32_t events, EventHandler handler);
+
+/**
+ * Changes which events are waited for on a registered file descriptor.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int change_event_source_events(int file_descriptor, uint32_t events);
+
+/**
+ * Stops waiting for a file descriptor. Should be called before it's closed.
+ */
+void remove_event_source(int file_descriptor);
+
+/**
+ * Waits until at least one registered file descriptor is ready and calls handlers of all that are.
+ *
+ * @param timeout_ms How long to wait for in milliseconds, -1 to wait until an event arrives.
+ * @return Number of handled events, 0 on timeout or if a signal interrupted waiting, -1 on failure.
+ */
+int wait_for_events(int timeout_ms);
+
+#endif //RUNWHENIDLE_EVENT_LOOP_H
@@ -0,0 +1,97 @@
+#include "hysteresis.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "arguments_parsing.h"
+#include "output_settings.h"
+#include "time_utils.h"
+
+static const long long HOUR_MS = 3600000;
+
+static size_t pause_count = 0;
+static size_t resume_count = 0;
+static size_t postponed_pause_count = 0;
+static size_t skipped_pause_count = 0;
+static int pause_is_being_postponed = 0; // Repeated checks while waiting only count as one postponed pause
+static struct timespec last_resume_time;
+// Times of the last max_pauses_per_hour pauses, oldest at pause_count % max_pauses_per_hour
+static struct timespec *recent_pause_times = NULL;
+
+static void print_transition_counts(void) {
+    fprintf(stderr, "Command has been paused %zu times and resumed %zu times, %zu pauses were postponed and %zu "
+                    "were skipped due to hysteresis settings\n",
+            pause_count, resume_count, postponed_pause_count, skipped_pause_count);
+}
+
+int pause_hysteresis_applies(void) {
+    return resume_count > 0;
+}
+
+long long get_time_until_pause_is_allowed_ms(void) {
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    long long time_until_pause_is_allowed_ms = 0;
+
+    if (min_run_time_ms) {
+        long long running_time_ms = get_elapsed_time_ms(last_resume_time, current_time);
+        if (running_time_ms < min_run_time_ms) {
+            time_until_pause_is_allowed_ms = min_run_time_ms - running_time_ms;
+            if (debug) fprintf(stderr, "Command has only been running for %lldms since it was resumed\n", running_time_ms);
+        }
+    }
+    if (max_pauses_per_hour && pause_count >= (size_t) max_pauses_per_hour) {
+        const struct timespec oldest_recent_pause_time = recent_pause_times[pause_count % max_pauses_per_hour];
+        long long time_since_oldest_recent_pause_ms = get_elapsed_time_ms(oldest_recent_pause_time, current_time);
+        if (time_since_oldest_recent_pause_ms < HOUR_MS) {
+            if (HOUR_MS - time_since_oldest_recent_pause_ms > time_until_pause_is_allowed_ms) {
+                time_until_pause_is_allowed_ms = HOUR_MS - time_since_oldest_recent_pause_ms;
+            }
+            if (debug) fprintf(stderr, "Command has already been paused %d times in the last hour\n", max_pauses_per_hour);
+        }
+    }
+
+    if (time_until_pause_is_allowed_ms > 0 && !pause_is_being_postponed) {
+        pause_is_being_postponed = 1;
+        postponed_pause_count++;
+        if (verbose) {
+            fprintf(stderr, "Pausing the command is postponed by %lldms\n", time_until_pause_is_allowed_ms);
+        }
+    }
+    return time_until_pause_is_allowed_ms;
+}
+
+void record_skipped_pause(void) {
+    skipped_pause_count++;
+    if (verbose) {
+        fprintf(stderr, "User activity lasted less than %ldms, not pausing the command\n", min_activity_time_ms);
+    }
+}
+
+void record_command_paused_on_user_activity(void) {
+    if (max_pauses_per_hour) {
+        if (!recent_pause_times) {
+            recent_pause_times = calloc(max_pauses_per_hour, sizeof(struct timespec));
+            if (!recent_pause_times) {
+                perror("Failed to allocate memory for pause times");
+                exit(1);
+            }
+        }
+        clock_gettime(CLOCK_MONOTONIC, &recent_pause_times[pause_count % max_pauses_per_hour]);
+    }
+    pause_count++;
+    pause_is_being_postponed = 0;
+    if (verbose) {
+        print_transition_counts();
+    }
+}
+
+void record_command_resumed_on_user_idle(void) {
+    clock_gettime(CLOCK_MONOTONIC, &last_resume_time);
+    resume_count++;
+    pause_is_being_postponed = 0;
+    if (verbose) {
+        print_transition_counts();
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef RUNWHENIDLE_HYSTERESIS_H
+#define RUNWHENIDLE_HYSTERESIS_H
+
+/**
+ * Hysteresis is only applied to pausing the command after it has been resumed at least once, since pausing it
+ * when monitoring starts is expected.
+ *
+ * @return 1 if pausing the command should go through hysteresis checks, 0 otherwise.
+ */
+int pause_hysteresis_applies(void);
+
+/**
+ * Checks --min-run-time and --max-pauses-per-hour.
+ *
+ * @return 0 if the command can be paused now, otherwise how long it has to keep running in milliseconds.
+ *         Positive values returned until the command is paused or resumed are counted as one postponed pause.
+ */
+long long get_time_until_pause_is_allowed_ms(void);
+
+/**
+ * Counts a pause that didn't happen because user activity didn't last for --min-activity-time.
+ */
+void record_skipped_pause(void);
+
+/**
+ * Should be called every time the command is paused because of user activity.
+ */
+void record_command_paused_on_user_activity(void);
+
+/**
+ * Should be called every time the command is resumed because user is idle.
+ */
+void record_command_resumed_on_user_idle(void);
+
+#endif //RUNWHENIDLE_HYSTERESIS_H
@@ -0,0 +1,337 @@
+#include "idle_history.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "arguments_parsing.h"
+#include "descriptor_utils.h"
+#include "output_settings.h"
+#include "time_utils.h"
+#include "tty_utils.h"
+
+const long unsigned MIN_OBSERVED_IDLE_PERIOD_MS = 30000;
+static const long long RESUME_HOLD_MS = 60000;
+// Resume early when idle periods like the current one reach --timeout at least this often
+static const double LIKELY_TO_LAST_PROBABILITY = 0.8;
+// Hold resuming when idle periods like the current one end within RESUME_HOLD_MS at least this often
+static const double LIKELY_TO_END_PROBABILITY = 0.7;
+// Predictions based on fewer idle periods are too noisy
+static const double MIN_IDLE_PERIODS_FOR_PREDICTION = 10;
+// Counts of a time slot are halved once they reach this, so that recent habits outweigh old ones
+static const unsigned MAX_IDLE_PERIODS_PER_TIME_SLOT = 1000;
+
+#define WEEKDAY_COUNT 7
+#define HOUR_COUNT 24
+#define IDLE_PERIOD_LENGTH_BUCKET_COUNT 25
+
+// Shortest idle period length of every bucket in seconds, the last bucket is unbounded. Buckets are narrow around
+// common --timeout values, so that coming back within RESUME_HOLD_MS after them can be told apart.
+// IDLE_HISTORY_VERSION has to change when these change.
+static const long unsigned idle_period_length_bucket_starts_s[IDLE_PERIOD_LENGTH_BUCKET_COUNT] = {
+        30, 45, 60, 90, 120, 150, 180, 210, 240, 270, 300, 330, 360, 420, 480, 600, 720, 900, 1200, 1800, 2700, 3600,
+        5400, 7200, 10800
+};
+
+static const char IDLE_HISTORY_MAGIC[4] = {'R', 'W', 'I', 'H'};
+static const uint32_t IDLE_HISTORY_VERSION = 1;
+
+/**
+ * Written to the idle history file as is. Idle periods are counted by the weekday and hour they started at
+ * and by their length.
+ */
+typedef struct IdleHistory {
+    char magic[4];
+    uint32_t version;
+    uint16_t idle_period_counts[WEEKDAY_COUNT][HOUR_COUNT][IDLE_PERIOD_LENGTH_BUCKET_COUNT];
+} IdleHistory;
+
+static IdleHistory idle_history;
+static int idle_history_is_loaded = 0;
+static int idle_history_write_has_failed = 0;
+
+static int idle_period_is_observed = 0;
+static struct timespec idle_period_observation_start_time;
+static long unsigned idle_period_length_at_observation_start_ms;
+static int idle_period_start_weekday;
+static int idle_period_start_hour;
+static long unsigned last_observed_user_idle_time_ms = 0;
+// Idle period length until which resuming is held, 0 if it hasn't been held during the current idle period
+static long long resume_hold_end_ms = 0;
+static int idle_period_is_likely_to_last = 0;
+static int resume_hold_timer_file_descriptor = -1;
+
+int idle_history_is_enabled(void) {
+    return idle_history_file_path != NULL;
+}
+
+/**
+ * @return 0 on success, -1 if the file doesn't exist or is not a valid idle history file.
+ */
+static int read_idle_history_file(IdleHistory *history) {
+    FILE *idle_history_file = fopen(idle_history_file_path, "rb");
+    if (!idle_history_file) {
+        if (errno != ENOENT) {
+            fprintf_error("Failed to open idle history file %s: %s\n", idle_history_file_path, strerror(errno));
+        }
+        return -1;
+    }
+    const size_t histories_read = fread(history, sizeof(*history), 1, idle_history_file);
+    fclose(idle_history_file);
+    if (histories_read != 1 || memcmp(history->magic, IDLE_HISTORY_MAGIC, sizeof(IDLE_HISTORY_MAGIC)) != 0 ||
+        history->version != IDLE_HISTORY_VERSION) {
+        fprintf_error("Idle history file %s is not compatible with this version, it will be replaced\n",
+                      idle_history_file_path);
+        return -1;
+    }
+    return 0;
+}
+
+static void load_idle_history_if_needed(void) {
+    if (idle_history_is_loaded) {
+        return;
+    }
+    idle_history_is_loaded = 1;
+    if (read_idle_history_file(&idle_history) < 0) {
+        memset(&idle_history, 0, sizeof(idle_history));
+    }
+    memcpy(idle_history.magic, IDLE_HISTORY_MAGIC, sizeof(IDLE_HISTORY_MAGIC));
+    idle_history.version = IDLE_HISTORY_VERSION;
+}
+
+/**
+ * Writes to a temporary file first, so that other instances never read a partially written file.
+ */
+static void write_idle_history_file(void) {
+    char temporary_file_path[PATH_MAX];
+    snprintf(temporary_file_path, sizeof(temporary_file_path), "%s.%d", idle_history_file_path, getpid());
+    FILE *temporary_file = fopen(temporary_file_path, "wb");
+    int write_failed = !temporary_file;
+    if (temporary_file) {
+        write_failed = fwrite(&idle_history, sizeof(idle_history), 1, temporary_file) != 1;
+        write_failed |= fclose(temporary_file) != 0;
+        if (!write_failed) {
+            write_failed = rename(temporary_file_path, idle_history_file_path) != 0;
+        }
+        if (write_failed) {
+            unlink(temporary_file_path);
+        }
+    }
+    if (write_failed && !idle_history_write_has_failed) {
+        idle_history_write_has_failed = 1;
+        fprintf_error("Failed to write idle history file %s: %s\n", idle_history_file_path, strerror(errno));
+    }
+}
+
+static size_t get_idle_period_length_bucket(long unsigned idle_period_length_ms) {
+    size_t bucket = 0;
+    while (bucket + 1 < IDLE_PERIOD_LENGTH_BUCKET_COUNT &&
+           idle_period_length_ms >= idle_period_length_bucket_starts_s[bucket + 1] * 1000) {
+        bucket++;
+    }
+    return bucket;
+}
+
+static void record_idle_period(int weekday, int hour, long unsigned idle_period_length_ms) {
+    // Other instances could have recorded idle periods since the file was read.
+    IdleHistory stored_idle_history;
+    if (read_idle_history_file(&stored_idle_history) == 0) {
+        idle_history = stored_idle_history;
+    }
+
+    uint16_t *idle_period_counts = idle_history.idle_period_counts[weekday][hour];
+    unsigned total_idle_period_count = 0;
+    for (size_t bucket = 0; bucket < IDLE_PERIOD_LENGTH_BUCKET_COUNT; bucket++) {
+        total_idle_period_count += idle_period_counts[bucket];
+    }
+    if (total_idle_period_count >= MAX_IDLE_PERIODS_PER_TIME_SLOT) {
+        for (size_t bucket = 0; bucket < IDLE_PERIOD_LENGTH_BUCKET_COUNT; bucket++) {
+            idle_period_counts[bucket] /= 2;
+        }
+    }
+    idle_period_counts[get_idle_period_length_bucket(idle_period_length_ms)]++;
+    write_idle_history_file();
+}
+
+static long long get_current_idle_period_length_ms(void) {
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    return (long long) idle_period_length_at_observation_start_ms +
+           get_elapsed_time_ms(idle_period_observation_start_time, current_time);
+}
+
+void start_observing_user_idle_period(long unsigned user_idle_time_ms) {
+    if (!idle_history_is_enabled() || idle_period_is_observed || user_idle_time_ms < MIN_OBSERVED_IDLE_PERIOD_MS) {
+        return;
+    }
+    load_idle_history_if_needed();
+    idle_period_is_observed = 1;
+    idle_period_is_likely_to_last = 0;
+    resume_hold_end_ms = 0;
+    clock_gettime(CLOCK_MONOTONIC, &idle_period_observation_start_time);
+    idle_period_length_at_observation_start_ms = user_idle_time_ms;
+
+    const time_t idle_period_start_time = time(NULL) - (time_t) (user_idle_time_ms / 1000);
+    struct tm idle_period_start_local_time;
+    localtime_r(&idle_period_start_time, &idle_period_start_local_time);
+    idle_period_start_weekday = idle_period_start_local_time.tm_wday;
+    idle_period_start_hour = idle_period_start_local_time.tm_hour;
+}
+
+void finish_observing_user_idle_period(long unsigned user_idle_time_ms) {
+    if (!idle_period_is_observed) {
+        return;
+    }
+    idle_period_is_observed = 0;
+    long long idle_period_length_ms = get_current_idle_period_length_ms() - (long long) user_idle_time_ms;
+    if (idle_period_length_ms < (long long) MIN_OBSERVED_IDLE_PERIOD_MS) {
+        idle_period_length_ms = MIN_OBSERVED_IDLE_PERIOD_MS;
+    }
+    if (debug) {
+        fprintf(stderr, "Recording idle period of %llds that started on weekday %d at %d:xx\n",
+                idle_period_length_ms / 1000, idle_period_start_weekday, idle_period_start_hour);
+    }
+    record_idle_period(idle_period_start_weekday, idle_period_start_hour, idle_period_length_ms);
+}
+
+void observe_user_idle_time(long unsigned user_idle_time_ms) {
+    if (user_idle_time_ms < last_observed_user_idle_time_ms) {
+        finish_observing_user_idle_period(user_idle_time_ms);
+    }
+    last_observed_user_idle_time_ms = user_idle_time_ms;
+    start_observing_user_idle_period(user_idle_time_ms);
+}
+
+long long get_time_until_next_idle_observation_ms(long unsigned user_idle_time_ms) {
+    if (!idle_history_is_enabled()) {
+        return -1;
+    }
+    // The end of an observed idle period is only as precise as the polling.
+    if (idle_period_is_observed || user_idle_time_ms >= MIN_OBSERVED_IDLE_PERIOD_MS) {
+        return 0;
+    }
+    return MIN_OBSERVED_IDLE_PERIOD_MS - user_idle_time_ms;
+}
+
+/**
+ * @return Estimated number of idle periods that lasted at least idle_period_length_s,
+ *         assuming lengths are spread evenly within a bucket.
+ */
+static double count_idle_periods_lasting_at_least(const double *idle_period_counts, double idle_period_length_s) {
+    double idle_period_count = 0;
+    for (size_t bucket = 0; bucket < IDLE_PERIOD_LENGTH_BUCKET_COUNT; bucket++) {
+        const double bucket_start_s = (double) idle_period_length_bucket_starts_s[bucket];
+        const double bucket_end_s = bucket + 1 < IDLE_PERIOD_LENGTH_BUCKET_COUNT
+                                    ? (double) idle_period_length_bucket_starts_s[bucket + 1]
+                                    : bucket_start_s * 2;
+        if (idle_period_length_s <= bucket_start_s) {
+            idle_period_count += idle_period_counts[bucket];
+        } else if (idle_period_length_s < bucket_end_s) {
+            idle_period_count += idle_period_counts[bucket] * (bucket_end_s - idle_period_length_s) /
+                                 (bucket_end_s - bucket_start_s);
+        }
+    }
+    return idle_period_count;
+}
+
+/**
+ * Looks at idle periods that started at the same weekday and hour as the current one, or at the same hour
+ * of any weekday if there are not enough of them.
+ *
+ * @return Probability that the current idle period lasts at least idle_period_length_ms,
+ *         or -1 if no period is observed or there is not enough history.
+ */
+static double get_probability_of_idle_period_lasting(long long idle_period_length_ms) {
+    if (!idle_period_is_observed) {
+        return -1;
+    }
+    const double current_idle_period_length_s = (double) get_current_idle_period_length_ms() / 1000;
+    for (int any_weekday = 0; any_weekday <= 1; any_weekday++) {
+        double idle_period_counts[IDLE_PERIOD_LENGTH_BUCKET_COUNT] = {0};
+        for (int weekday = 0; weekday < WEEKDAY_COUNT; weekday++) {
+            if (!any_weekday && weekday != idle_period_start_weekday) {
+                continue;
+            }
+            for (size_t bucket = 0; bucket < IDLE_PERIOD_LENGTH_BUCKET_COUNT; bucket++) {
+                idle_period_counts[bucket] +=
+                        idle_history.idle_period_counts[weekday][idle_period_start_hour][bucket];
+            }
+        }
+        const double lasted_as_long_count =
+                count_idle_periods_lasting_at_least(idle_period_counts, current_idle_period_length_s);
+        if (lasted_as_long_count >= MIN_IDLE_PERIODS_FOR_PREDICTION) {
+            return count_idle_periods_lasting_at_least(idle_period_counts, (double) idle_period_length_ms / 1000) /
+                   lasted_as_long_count;
+        }
+    }
+    return -1;
+}
+
+int user_idle_period_is_likely_to_last(void) {
+    if (!idle_period_is_observed) {
+        return 0;
+    }
+    // The prediction is kept until the idle period ends, so that the command isn't paused again while it lasts.
+    if (idle_period_is_likely_to_last) {
+        return 1;
+    }
+    const double probability = get_probability_of_idle_period_lasting((long long) user_idle_timeout_ms);
+    if (probability < LIKELY_TO_LAST_PROBABILITY) {
+        return 0;
+    }
+    idle_period_is_likely_to_last = 1;
+    if (!quiet) {
+        printf("User stayed idle for %lus in %.0f%% of similar idle periods, not waiting for the timeout\n",
+               user_idle_timeout_ms / 1000, probability * 100);
+    }
+    return 1;
+}
+
+int resume_should_be_held(void) {
+    // Without the timer, the command could stay paused until the user comes back.
+    if (!idle_period_is_observed || create_resume_hold_timer_file_descriptor() < 0) {
+        return 0;
+    }
+    const long long current_idle_period_length_ms = get_current_idle_period_length_ms();
+    if (resume_hold_end_ms) {
+        return current_idle_period_length_ms < resume_hold_end_ms;
+    }
+    const double probability =
+            get_probability_of_idle_period_lasting(current_idle_period_length_ms + RESUME_HOLD_MS);
+    if (probability < 0 || probability > 1 - LIKELY_TO_END_PROBABILITY) {
+        return 0;
+    }
+    resume_hold_end_ms = current_idle_period_length_ms + RESUME_HOLD_MS;
+    if (!quiet) {
+        printf("User usually comes back within %llds after similar idle periods, waiting before resuming the command\n",
+               RESUME_HOLD_MS / 1000);
+    }
+    if (arm_one_shot_timer_file_descriptor_after_ms(resume_hold_timer_file_descriptor, (long) RESUME_HOLD_MS) < 0) {
+        fprintf_error("Failed to arm resume hold timer: %s\n", strerror(errno));
+        resume_hold_end_ms = 0;
+        return 0;
+    }
+    return 1;
+}
+
+int create_resume_hold_timer_file_descriptor(void) {
+    if (!idle_history_is_enabled()) {
+        return -1;
+    }
+    if (resume_hold_timer_file_descriptor == -1) {
+        // Created disarmed, armed when resuming is held.
+        resume_hold_timer_file_descriptor = create_one_shot_timer_file_descriptor_after_ms(0);
+        if (resume_hold_timer_file_descriptor == -1) {
+            fprintf_error("Failed to create resume hold timer: %s\n", strerror(errno));
+        }
+    }
+    return resume_hold_timer_file_descriptor;
+}
+
+int handle_resume_hold_timer_expiration(void) {
+    return consume_timer_file_descriptor_checked(resume_hold_timer_file_descriptor, "resume hold");
+}
@@ -0,0 +1,69 @@
+#ifndef RUNWHENIDLE_IDLE_HISTORY_H
+#define RUNWHENIDLE_IDLE_HISTORY_H
+
+/**
+ * Idle periods shorter than this are not recorded, so they don't need to be watched for.
+ */
+extern const long unsigned MIN_OBSERVED_IDLE_PERIOD_MS;
+
+/**
+ * @return 1 if --idle-history is used, 0 otherwise.
+ */
+int idle_history_is_enabled(void);
+
+/**
+ * Starts measuring an idle period once the user has been idle for MIN_OBSERVED_IDLE_PERIOD_MS or longer.
+ * Does nothing if a period is already being measured.
+ *
+ * @param user_idle_time_ms How long the user has been idle for at the moment.
+ */
+void start_observing_user_idle_period(long unsigned user_idle_time_ms);
+
+/**
+ * Records the length of the idle period being measured in the idle history file.
+ *
+ * @param user_idle_time_ms How long ago the user became active, 0 if just now.
+ */
+void finish_observing_user_idle_period(long unsigned user_idle_time_ms);
+
+/**
+ * Starts or finishes measuring idle periods based on polled idle time. Idle time going down means the user
+ * has been active since the last call.
+ */
+void observe_user_idle_time(long unsigned user_idle_time_ms);
+
+/**
+ * @return How long to wait before calling observe_user_idle_time() again, 0 if as soon as possible,
+ *         or -1 if idle history is not used.
+ */
+long long get_time_until_next_idle_observation_ms(long unsigned user_idle_time_ms);
+
+/**
+ * @return 1 if idle periods that started at this time of day and weekday and lasted as long as the current one
+ *         usually last for the whole --timeout, 0 otherwise or if there is not enough history.
+ *         Once 1 is returned, it's returned until the idle period ends.
+ */
+int user_idle_period_is_likely_to_last(void);
+
+/**
+ * Decides whether resuming the command should wait because the user usually comes back within a minute after idle
+ * periods like the current one reach --timeout. Resuming is held at most once per idle period, and the resume hold
+ * timer expires when the hold is over.
+ *
+ * @return 1 if the command should stay paused for now, 0 if it should be resumed.
+ */
+int resume_should_be_held(void);
+
+/**
+ * Creates the timer that expires when resuming the command is not held anymore.
+ *
+ * @return Timer file descriptor, or -1 if idle history is not used or the timer could not be created.
+ */
+int create_resume_hold_timer_file_descriptor(void);
+
+/**
+ * @return 0 on success, -1 if reading the timer failed.
+ */
+int handle_resume_hold_timer_expiration(void);
+
+#endif //RUNWHENIDLE_IDLE_HISTORY_H
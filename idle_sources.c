@@ -0,0 +1,75 @@
+#include "idle_sources.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "evdev_idle.h"
+#include "output_settings.h"
+#include "scripted_idle.h"
+#include "tty_idle.h"
+#include "tty_utils.h"
+#include "wayland.h"
+#include "x11_idle.h"
+
+// Tried in this order unless a source is selected with --idle-source
+static const IdleSource *const automatic_idle_sources[] = {
+        &wayland_idle_source,
+        &x11_idle_source,
+        &evdev_idle_source,
+        &tty_idle_source,
+};
+
+static const IdleSource *selected_idle_source = NULL;
+
+int set_idle_source(const char *idle_source_definition) {
+    if (strcasecmp(idle_source_definition, "wayland") == 0) {
+        selected_idle_source = &wayland_idle_source;
+        return 0;
+    }
+    if (strcasecmp(idle_source_definition, "x11") == 0) {
+        selected_idle_source = &x11_idle_source;
+        return 0;
+    }
+    if (strcasecmp(idle_source_definition, "evdev") == 0) {
+        selected_idle_source = &evdev_idle_source;
+        return 0;
+    }
+    if (strcasecmp(idle_source_definition, "tty") == 0) {
+        selected_idle_source = &tty_idle_source;
+        return 0;
+    }
+    const char *path = strchr(idle_source_definition, ':');
+    if (path == NULL || path[1] == '\0') {
+        return -1;
+    }
+    const size_t type_length = path - idle_source_definition;
+    if (type_length == strlen("fifo") && strncasecmp(idle_source_definition, "fifo", type_length) == 0) {
+        selected_idle_source = &fifo_idle_source;
+    } else if (type_length == strlen("socket") && strncasecmp(idle_source_definition, "socket", type_length) == 0) {
+        selected_idle_source = &socket_idle_source;
+    } else {
+        return -1;
+    }
+    set_scripted_idle_source_path(path + 1);
+    return 0;
+}
+
+const IdleSource *start_idle_source(void) {
+    if (selected_idle_source) {
+        if (selected_idle_source->init()) {
+            return selected_idle_source;
+        }
+        fprintf_error("Failed to start %s idle source\n", selected_idle_source->name);
+        return NULL;
+    }
+    for (size_t source_index = 0;
+         source_index < sizeof(automatic_idle_sources) / sizeof(automatic_idle_sources[0]); source_index++) {
+        if (automatic_idle_sources[source_index]->init()) {
+            return automatic_idle_sources[source_index];
+        }
+        if (verbose) fprintf(stderr, "%s idle source is not available\n", automatic_idle_sources[source_index]->name);
+    }
+    return NULL;
+}
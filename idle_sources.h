@@ -0,0 +1,67 @@
+#ifndef RUNWHENIDLE_IDLE_SOURCES_H
+#define RUNWHENIDLE_IDLE_SOURCES_H
+
+#include <stdint.h>
+
+/**
+ * Way of finding out how long the user has been idle for. Sources that provide a file descriptor wake runwhenidle up
+ * when idle time has to be queried again, others are polled.
+ */
+typedef struct IdleSource {
+    const char *name;
+
+    /**
+     * Connects to whatever reports user activity.
+     *
+     * @return 1 if the source can be used, 0 otherwise.
+     */
+    int (*init)(void);
+
+    /**
+     * @return File descriptor to wait for with EPOLLIN, or -1 if the source has to be polled.
+     */
+    int (*get_file_descriptor)(void);
+
+    /**
+     * Called when the file descriptor is ready.
+     *
+     * @param events EPOLLIN, EPOLLOUT, EPOLLHUP and EPOLLERR flags that are set.
+     * @return 1 if idle time has to be queried again, 0 if not, -1 if the source stopped working.
+     */
+    int (*on_readable)(uint32_t events);
+
+    /**
+     * @return How long the user has been idle for in milliseconds. Sources that only learn about idle time when it
+     *         passes certain values can return the last value passed.
+     */
+    long unsigned (*query_idle_time_ms)(void);
+
+    /**
+     * Called before waiting for events once monitoring has started.
+     *
+     * @param wake_up_at_idle_time_ms Idle time to wake up at, 0 if not needed.
+     * @param user_idle_time_ms Idle time queried last. If it's not 0, the source should wake up when the user becomes
+     *                          active. Otherwise user activity doesn't need to wake anything up.
+     * @return 1 if idle time has to be queried again without waiting, 0 if not, -1 if the source stopped working.
+     */
+    int (*prepare_to_wait)(long unsigned wake_up_at_idle_time_ms, long unsigned user_idle_time_ms);
+
+    void (*teardown)(void);
+} IdleSource;
+
+/**
+ * Selects the source to use instead of trying them one by one.
+ *
+ * @param idle_source_definition "wayland", "x11", "fifo:<path>" or "socket:<path>".
+ * @return 0 on success, -1 if the definition is invalid.
+ */
+int set_idle_source(const char *idle_source_definition);
+
+/**
+ * Initializes the source selected with set_idle_source(). If none was selected, tries Wayland, then X11.
+ *
+ * @return The source that was initialized, or NULL if none can be used.
+ */
+const IdleSource *start_idle_source(void);
+
+#endif //RUNWHENIDLE_IDLE_SOURCES_H
@@ -0,0 +1,89 @@
+#include "idle_tiers.h"
+
+#include <stdlib.h>
+#include <strings.h>
+
+#define MAX_IDLE_TIERS 8
+
+// Intermediate tiers are added between the level for active user and the level for idle user, so 2 extra.
+static IdleLevel idle_levels[MAX_IDLE_TIERS + 2];
+static size_t idle_tier_count = 0;
+static size_t idle_level_count = 0;
+
+int add_idle_tier(const char *idle_tier_definition) {
+    if (idle_tier_count >= MAX_IDLE_TIERS) {
+        return -1;
+    }
+    char *strtol_endptr;
+    long idle_time_seconds = strtol(idle_tier_definition, &strtol_endptr, 10);
+    if (strtol_endptr == idle_tier_definition || *strtol_endptr != ':' || idle_time_seconds <= 0) {
+        return -1;
+    }
+    const char *method = strtol_endptr + 1;
+
+    enum pause_method pause_method = PAUSE_METHOD_UNKNOWN;
+    if (strcasecmp(method, "RUN") != 0) {
+        for (int i = 1; pause_method_string[i] != NULL; i++) {
+            if (strcasecmp(pause_method_string[i], method) == 0) {
+                pause_method = i;
+                break;
+            }
+        }
+        // The command is started in a cgroup only when a cgroup pause method is used while the user is active.
+        if (pause_method == PAUSE_METHOD_UNKNOWN || pause_method == PAUSE_METHOD_CGROUP_FREEZE ||
+            pause_method == PAUSE_METHOD_CGROUP_THROTTLE) {
+            return -1;
+        }
+    }
+
+    // Level 0 is reserved for active user
+    idle_levels[idle_tier_count + 1].idle_time_ms = idle_time_seconds * 1000;
+    idle_levels[idle_tier_count + 1].pause_method = pause_method;
+    idle_tier_count++;
+    return 0;
+}
+
+static int compare_idle_levels_by_idle_time(const void *first, const void *second) {
+    const IdleLevel *first_level = first;
+    const IdleLevel *second_level = second;
+    if (first_level->idle_time_ms < second_level->idle_time_ms) return -1;
+    if (first_level->idle_time_ms > second_level->idle_time_ms) return 1;
+    return 0;
+}
+
+int finalize_idle_levels(enum pause_method active_pause_method, long unsigned user_idle_timeout_ms) {
+    qsort(&idle_levels[1], idle_tier_count, sizeof(IdleLevel), compare_idle_levels_by_idle_time);
+
+    idle_levels[0].idle_time_ms = 0;
+    idle_levels[0].pause_method = active_pause_method;
+    idle_level_count = idle_tier_count + 2;
+    idle_levels[idle_level_count - 1].idle_time_ms = user_idle_timeout_ms;
+    idle_levels[idle_level_count - 1].pause_method = PAUSE_METHOD_UNKNOWN;
+
+    for (size_t idle_level = 1; idle_level < idle_level_count; idle_level++) {
+        if (idle_levels[idle_level].idle_time_ms <= idle_levels[idle_level - 1].idle_time_ms) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+size_t get_idle_level_count(void) {
+    return idle_level_count;
+}
+
+const IdleLevel *get_idle_level(size_t idle_level) {
+    return &idle_levels[idle_level];
+}
+
+void set_idle_level_pause_method(size_t idle_level, enum pause_method pause_method) {
+    idle_levels[idle_level].pause_method = pause_method;
+}
+
+size_t get_idle_level_for_idle_time(long unsigned user_idle_time_ms) {
+    size_t idle_level = 0;
+    while (idle_level + 1 < idle_level_count && user_idle_time_ms >= idle_levels[idle_level + 1].idle_time_ms) {
+        idle_level++;
+    }
+    return idle_level;
+}
@@ -0,0 +1,53 @@
+#ifndef RUNWHENIDLE_IDLE_TIERS_H
+#define RUNWHENIDLE_IDLE_TIERS_H
+
+#include <stddef.h>
+
+#include "pause_methods.h"
+
+/**
+ * Pause method applied to the command once the user has been idle for idle_time_ms.
+ * Level 0 is the user being active, the last level is the user being idle for --timeout, at which point
+ * the command runs normally.
+ */
+typedef struct IdleLevel {
+    long unsigned idle_time_ms;
+    enum pause_method pause_method; // PAUSE_METHOD_UNKNOWN means the command runs normally
+} IdleLevel;
+
+/**
+ * Adds an intermediate idle level.
+ *
+ * @param idle_tier_definition "<seconds>:<pause method>" or "<seconds>:RUN", e.g. "30:SCHED_IDLE".
+ * @return 0 on success, -1 if the definition is invalid or there are too many levels.
+ */
+int add_idle_tier(const char *idle_tier_definition);
+
+/**
+ * Sorts levels added with add_idle_tier() and adds the first and the last level.
+ *
+ * @param active_pause_method Pause method used when the user is active.
+ * @param user_idle_timeout_ms Idle time after which the command runs normally.
+ * @return 0 on success, -1 if an intermediate level is not between 0 and user_idle_timeout_ms
+ *         or two levels have the same idle time.
+ */
+int finalize_idle_levels(enum pause_method active_pause_method, long unsigned user_idle_timeout_ms);
+
+/**
+ * @return Number of levels including the first and the last one, at least 2.
+ */
+size_t get_idle_level_count(void);
+
+const IdleLevel *get_idle_level(size_t idle_level);
+
+/**
+ * Replaces pause method of a level, e.g. when the requested one turned out not to be available.
+ */
+void set_idle_level_pause_method(size_t idle_level, enum pause_method pause_method);
+
+/**
+ * @return Index of the highest level whose idle time has been reached.
+ */
+size_t get_idle_level_for_idle_time(long unsigned user_idle_time_ms);
+
+#endif //RUNWHENIDLE_IDLE_TIERS_H
@@ -0,0 +1,59 @@
+#include "idle_time_tracking.h"
+
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+
+#include "descriptor_utils.h"
+#include "time_utils.h"
+#include "tty_utils.h"
+
+static int idle_time_timer_file_descriptor = -1;
+static long unsigned user_idle_time_at_last_update_ms = 0;
+static struct timespec last_update_time;
+
+int start_tracking_user_idle_time(void) {
+    // Created disarmed, armed before waiting for events.
+    idle_time_timer_file_descriptor = create_one_shot_timer_file_descriptor_after_ms(0);
+    if (idle_time_timer_file_descriptor == -1) {
+        fprintf_error("Failed to create idle time timer file descriptor: %s\n", strerror(errno));
+        return -1;
+    }
+    set_tracked_user_idle_time(0);
+    return idle_time_timer_file_descriptor;
+}
+
+void stop_tracking_user_idle_time(void) {
+    close_file_descriptor_if_open(&idle_time_timer_file_descriptor, "idle time timer");
+}
+
+void set_tracked_user_idle_time(long unsigned user_idle_time_ms) {
+    user_idle_time_at_last_update_ms = user_idle_time_ms;
+    clock_gettime(CLOCK_MONOTONIC, &last_update_time);
+}
+
+long unsigned get_tracked_user_idle_time_ms(void) {
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    return user_idle_time_at_last_update_ms + get_elapsed_time_ms(last_update_time, current_time);
+}
+
+int wake_up_at_tracked_user_idle_time(long unsigned wake_up_at_idle_time_ms) {
+    long delay_ms = 0;
+    if (wake_up_at_idle_time_ms) {
+        const long unsigned user_idle_time_ms = get_tracked_user_idle_time_ms();
+        if (user_idle_time_ms >= wake_up_at_idle_time_ms) {
+            return 1;
+        }
+        delay_ms = (long) (wake_up_at_idle_time_ms - user_idle_time_ms);
+    }
+    if (arm_one_shot_timer_file_descriptor_after_ms(idle_time_timer_file_descriptor, delay_ms) < 0) {
+        fprintf_error("Failed to arm idle time timer: %s\n", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int handle_tracked_user_idle_time_timer_expiration(void) {
+    return consume_timer_file_descriptor_checked(idle_time_timer_file_descriptor, "idle time");
+}
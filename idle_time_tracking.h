@@ -0,0 +1,41 @@
+#ifndef RUNWHENIDLE_IDLE_TIME_TRACKING_H
+#define RUNWHENIDLE_IDLE_TIME_TRACKING_H
+
+/**
+ * Keeps idle time for idle sources that know when the user was last active, and wakes them up when it reaches
+ * a value. Only one source can use it at a time.
+ */
+
+/**
+ * Starts tracking with idle time of 0.
+ *
+ * @return Timer file descriptor that becomes readable when idle time reaches the value passed to
+ *         wake_up_at_tracked_user_idle_time(), or -1 on failure.
+ */
+int start_tracking_user_idle_time(void);
+
+void stop_tracking_user_idle_time(void);
+
+/**
+ * Sets how long the user has been idle for at this moment, 0 when the user has just been active.
+ */
+void set_tracked_user_idle_time(long unsigned user_idle_time_ms);
+
+long unsigned get_tracked_user_idle_time_ms(void);
+
+/**
+ * Arms the timer for the idle time to wake up at, replacing what it was armed for before.
+ *
+ * @param wake_up_at_idle_time_ms Idle time to wake up at, 0 if not needed.
+ * @return 1 if the idle time has already been reached, 0 if the timer was armed, -1 on failure.
+ */
+int wake_up_at_tracked_user_idle_time(long unsigned wake_up_at_idle_time_ms);
+
+/**
+ * Should be called when the timer file descriptor is readable.
+ *
+ * @return 0 on success, -1 if reading the timer failed.
+ */
+int handle_tracked_user_idle_time_timer_expiration(void);
+
+#endif //RUNWHENIDLE_IDLE_TIME_TRACKING_H
@@ -5,26 +5,31 @@
 #include <limits.h>
 #include <string.h>
 #include <errno.h>
-#include <poll.h>
+#include <sys/epoll.h>
 #include <signal.h>
 #include <unistd.h>
 #include <sys/signalfd.h>
 
-#include <wayland-client.h>
-
-#include <X11/Xlib.h>
-#include <X11/extensions/scrnsaver.h>
-
 #include "environment_guessing.h"
 #include "sleep_utils.h"
 #include "time_utils.h"
 #include "tty_utils.h"
 #include "process_handling.h"
+#include "schedule.h"
+#include "process_tree.h"
 #include "arguments_parsing.h"
 #include "descriptor_utils.h"
-#include "ext-idle-notify-v1-client-protocol.h"
+#include "event_loop.h"
+#include "deadline.h"
+#include "duty_cycle.h"
+#include "hysteresis.h"
+#include "idle_history.h"
+#include "idle_sources.h"
+#include "memory_reclaim.h"
+#include "idle_tiers.h"
+#include "cgroup_utils.h"
 #include "pause_methods.h"
-#include "wayland.h"
+#include "thread_priority.h"
 
 #ifndef VERSION
 #define VERSION "unknown"
@@ -32,6 +37,21 @@
 
 char *shell_command_to_run;
 pid_t external_pid = 0;
+int run_in_separate_process_group = 0;
+char *throttle_cpu_max = "25000 100000";
+char *throttle_io_max = NULL;
+int throttle_io_weight = 10;
+int duty_cycle_percent = 0;
+long duty_cycle_period_ms = 500;
+long reclaim_memory_after_ms = 0;
+int oom_score_adjustment = 0;
+long prefetch_budget_mib = 0;
+long deadline_timestamp = 0;
+long expected_cpu_time_ms = 0;
+long min_run_time_ms = 0;
+long min_activity_time_ms = 0;
+int max_pauses_per_hour = 0;
+char *idle_history_file_path = NULL;
 int verbose = 0;
 int quiet = 0;
 int debug = 0;
@@ -40,23 +60,30 @@ enum pause_method pause_method = PAUSE_METHOD_SIGSTOP;
 long start_monitor_after_ms = 300;
 long unsigned user_idle_timeout_ms = 300000;
 const long long POLLING_INTERVAL_MS = 1000;
-const long long POLLING_INTERVAL_BEFORE_STARTING_MONITORING_MS = 100;
-const int POLLING_INTERVAL_WHEN_NOT_MONITORING_MS = 100;
+const long long SLEEP_UNTIL_WOKEN_UP_MS = INT_MAX;
 const char *pause_method_string[] = {
         //order must match order in pause_method enum
         [PAUSE_METHOD_SIGTSTP] = "SIGTSTP",
         [PAUSE_METHOD_SIGSTOP] = "SIGSTOP",
+        [PAUSE_METHOD_CGROUP_FREEZE] = "CGROUP_FREEZE",
+        [PAUSE_METHOD_CPU_AFFINITY] = "CPU_AFFINITY",
+        [PAUSE_METHOD_SCHED_IDLE] = "SCHED_IDLE",
+        [PAUSE_METHOD_NICE] = "NICE",
+        [PAUSE_METHOD_IOPRIO_IDLE] = "IOPRIO_IDLE",
+        [PAUSE_METHOD_CGROUP_THROTTLE] = "CGROUP_THROTTLE",
         NULL // Sentinel value to indicate the end of the array
 };
-int xscreensaver_is_available;
-Display *x_display;
-XScreenSaverInfo *xscreensaver_info;
+const IdleSource *idle_source = NULL; // NULL if no way of detecting idle time is available
 const long unsigned IDLE_TIME_NOT_AVAILABLE_VALUE = ULONG_MAX;
 
 int interruption_received = 0;
 int command_paused = 0;
+size_t current_idle_level; // Level of user idleness the command is currently paused or running according to
+int user_activity_is_pending = 0; // User became active, but not for long enough to pause yet, see --min-activity-time
+struct timespec user_activity_start_time;
 int sigchld_received = 0;
 int signal_fd = -1;
+int process_exit_file_descriptor = -1; // Wakes up loops when the command exits, even if it's not our child
 pid_t pid;
 
 void process_signalfd() {
@@ -73,9 +100,8 @@ void process_signalfd() {
 }
 
 long unsigned query_user_idle_time() {
-    if (xscreensaver_is_available) {
-        XScreenSaverQueryInfo(x_display, DefaultRootWindow(x_display), xscreensaver_info);
-        return xscreensaver_info->idle;
+    if (idle_source) {
+        return idle_source->query_idle_time_ms();
     }
 
     return IDLE_TIME_NOT_AVAILABLE_VALUE;
@@ -93,7 +119,8 @@ int handle_interruption() {
             if (!quiet) {
                 printf("Received SIGINT, sending SIGINT to the command and waiting for it to finish\n");
             }
-            send_signal_to_pid(pid, signal_number_that_caused_interruption, "SIGINT");
+            send_signal_to_pid(run_in_separate_process_group ? -pid : pid, signal_number_that_caused_interruption,
+                               "SIGINT");
         }
     } else if (signal_number_that_caused_interruption == SIGTERM) {
         if (external_pid) {
@@ -104,7 +131,8 @@ int handle_interruption() {
             if (!quiet) {
                 printf("Received SIGTERM, sending SIGTERM to the command and waiting for it to finish\n");
             }
-            send_signal_to_pid(pid, signal_number_that_caused_interruption, "SIGTERM");
+            send_signal_to_pid(run_in_separate_process_group ? -pid : pid, signal_number_that_caused_interruption,
+                               "SIGTERM");
         }
     }
 
@@ -116,6 +144,8 @@ int handle_interruption() {
             }
             fprintf(stderr, "\n");
         }
+        stop_duty_cycle();
+        cancel_memory_reclaim();
         command_paused = 0;
         resume_command_recursively(pid);
     }
@@ -131,112 +161,229 @@ static void resume_paused_command_on_user_idle(void) {
         printf("Lack of user activity detected. ");
         //intentionally no new line here, resume_command will print the rest of the message.
     }
+    stop_duty_cycle();
+    cancel_memory_reclaim();
+    // Pages start being read in while the command is still being resumed.
+    prefetch_working_set_of_command();
     resume_command_recursively(pid);
     command_paused = 0;
+    record_command_resumed_on_user_idle();
+    start_measuring_command_run_rate(pid);
 }
 
 static void pause_running_command_on_user_activity(void) {
+    stop_measuring_command_run_rate(pid);
     pause_command_recursively(pid);
     if (debug) fprintf(stderr, "Command paused\n");
     command_paused = 1;
+    record_command_paused_on_user_activity();
+    record_working_set_of_command(pid);
+    start_duty_cycle();
+    schedule_memory_reclaim();
 }
 
-static void wayland_idle_notification_idled(void *data, struct ext_idle_notification_v1 *notification) {
-    (void)data;
-    (void)notification;
-
-    if (!monitoring_started) {
-        return;
+/**
+ * Applies pause method of an intermediate idle level, undoing the one currently applied if it's different.
+ */
+static void throttle_command_for_idle_level(size_t idle_level) {
+    const IdleLevel *level = get_idle_level(idle_level);
+    if (!quiet) {
+        printf("User has been idle for %lus, switching to %s. ", level->idle_time_ms / 1000,
+               level->pause_method == PAUSE_METHOD_UNKNOWN ? "running normally"
+                                                           : pause_method_string[level->pause_method]);
+        //intentionally no new line here, pause and resume messages will be printed after it.
     }
-
-    if (debug) {
-        fprintf(stderr, "Wayland idle: idled()\n");
+    if (command_paused && level->pause_method != pause_method) {
+        stop_duty_cycle();
+        cancel_memory_reclaim();
+        resume_command_recursively(pid);
+        command_paused = 0;
     }
-
-    if (command_paused) {
-        resume_paused_command_on_user_idle();
-    } else if (debug) {
-        fprintf(stderr, "Command is not paused, not doing anything\n");
+    if (level->pause_method == PAUSE_METHOD_UNKNOWN) {
+        if (!quiet) printf("\n");
+        return;
+    }
+    if (!command_paused) {
+        pause_method = level->pause_method;
+        pause_command_recursively(pid);
+        command_paused = 1;
     }
 }
 
-static void wayland_idle_notification_resumed(void *data, struct ext_idle_notification_v1 *notification) {
-    (void)data;
-    (void)notification;
-
-    if (!monitoring_started) {
+static void switch_command_to_idle_level(size_t idle_level) {
+    // Time windows of the schedule take precedence over user activity
+    if (get_current_schedule_mode() == SCHEDULE_MODE_RUN) {
+        idle_level = get_idle_level_count() - 1;
+    } else if (get_current_schedule_mode() == SCHEDULE_MODE_PAUSE) {
+        idle_level = 0;
+    }
+    if (idle_level == current_idle_level) {
         return;
     }
+    if (debug) fprintf(stderr, "Switching from idle level %zu to %zu\n", current_idle_level, idle_level);
 
-    if (debug) {
-        fprintf(stderr, "Wayland idle: resumed()\n");
-    }
-    if (!command_paused) {
-        pause_running_command_on_user_activity();
+    if (idle_level == 0) {
+        const enum pause_method active_pause_method = get_idle_level(0)->pause_method;
+        if (command_paused && pause_method != active_pause_method) {
+            resume_command_recursively(pid);
+            command_paused = 0;
+        }
+        pause_method = active_pause_method;
+        if (!command_paused) {
+            pause_running_command_on_user_activity();
+            // Pause method could have fallen back to a different one
+            set_idle_level_pause_method(0, pause_method);
+        }
+    } else if (idle_level == get_idle_level_count() - 1) {
+        if (command_paused) {
+            resume_paused_command_on_user_idle();
+        }
+    } else {
+        throttle_command_for_idle_level(idle_level);
     }
+    current_idle_level = idle_level;
 }
 
-void sleep_for_ms_with_signalfd(struct pollfd* pfd, int sleep_time_ms) {
-    if (poll(pfd, 1, sleep_time_ms) > 0) {
-        if (pfd->revents & POLLIN) {
-            process_signalfd();
+/**
+ * Pauses the command because of user activity, unless hysteresis settings require waiting.
+ *
+ * @param user_is_still_active Whether the user has been active within the last half of --min-activity-time.
+ * @return 0 if the command was paused, -1 if user activity didn't last long enough to pause the command,
+ *         otherwise how long to wait in milliseconds before calling this again.
+ */
+static long long pause_command_on_user_activity_with_hysteresis(int user_is_still_active) {
+    if (!pause_hysteresis_applies()) {
+        switch_command_to_idle_level(0);
+        return 0;
+    }
+    if (min_activity_time_ms) {
+        struct timespec current_time;
+        clock_gettime(CLOCK_MONOTONIC, &current_time);
+        if (!user_activity_is_pending) {
+            if (debug) fprintf(stderr, "User has become active, waiting %ldms before pausing\n", min_activity_time_ms);
+            user_activity_is_pending = 1;
+            user_activity_start_time = current_time;
+            return min_activity_time_ms;
+        }
+        long long user_activity_time_ms = get_elapsed_time_ms(user_activity_start_time, current_time);
+        if (user_activity_time_ms < min_activity_time_ms) {
+            return min_activity_time_ms - user_activity_time_ms;
+        }
+        if (!user_is_still_active) {
+            user_activity_is_pending = 0;
+            record_skipped_pause();
+            return -1;
         }
     }
+    long long time_until_pause_is_allowed_ms = get_time_until_pause_is_allowed_ms();
+    if (time_until_pause_is_allowed_ms > 0) {
+        return time_until_pause_is_allowed_ms;
+    }
+    user_activity_is_pending = 0;
+    switch_command_to_idle_level(0);
+    return 0;
 }
 
-int resume_and_wait_for_pid_to_exit_checking_for_signals(void) {
-    if (command_paused) {
-        if (verbose) {
-            fprintf(stderr, "Since command was previously paused, we will try to resume it now to let it finish\n");
-        }
-        command_paused = 0;
-        resume_command_recursively(pid);
-    }
+static int schedule_mode_has_changed = 0;
+static int resume_hold_has_expired = 0;
+static int idle_source_has_woken_up = 0;
+static int idle_source_has_failed = 0;
+static int process_exit_fallback_timer_file_descriptor = -1;
 
-    struct pollfd pfd = { .fd = signal_fd, .events = POLLIN };
+static void handle_signal_event(uint32_t events) {
+    (void)events;
+    process_signalfd();
+}
 
-    while (1) {
-        if (interruption_received) {
-            return handle_interruption();
-        }
-        if (sigchld_received) {
-            sigchld_received = 0;
-        }
-        exit_if_pid_has_finished(pid);
+static void handle_process_exit_event(uint32_t events) {
+    (void)events;
+    exit_if_pid_has_finished(pid);
+}
 
-        // Use poll on signalfd to wake up instantly on signal
-        sleep_for_ms_with_signalfd(&pfd, POLLING_INTERVAL_WHEN_NOT_MONITORING_MS);
+static void handle_process_exit_fallback_timer_event(uint32_t events) {
+    (void)events;
+    if (consume_timer_file_descriptor_checked(process_exit_fallback_timer_file_descriptor, "process-exit fallback") == 0) {
+        exit_if_pid_has_finished(pid);
     }
 }
 
-const struct ext_idle_notification_v1_listener wayland_idle_notification_listener = {
-    .idled = wayland_idle_notification_idled,
-    .resumed = wayland_idle_notification_resumed
-};
+static void handle_paused_descendants_exit_event(uint32_t events) {
+    (void)events;
+    forget_exited_paused_descendants();
+}
 
-int run_wayland_idle_event_loop(struct wl_display *wayland_display) {
-    int result = -1;
-    int wayland_flush_is_pending = 0;
+static void handle_descendant_tracking_event(uint32_t events) {
+    (void)events;
+    update_tracked_descendants();
+}
 
-    int start_monitor_timer_file_descriptor = create_one_shot_timer_file_descriptor_after_ms(start_monitor_after_ms);
-    int process_exit_wait_file_descriptor = -1;
-    int external_pid_fallback_check_timer_file_descriptor = -1;
+static void handle_duty_cycle_timer_event(uint32_t events) {
+    (void)events;
+    handle_duty_cycle_timer_expiration(pid);
+}
 
-    if (start_monitor_timer_file_descriptor == -1) {
-        const int saved_errno = errno;
-        fprintf_error("Wayland idle event loop aborted: failed to create a timer file descriptor: %s\n",
-                      strerror(saved_errno));
-        goto run_wayland_idle_event_loop_cleanup;
+static void handle_memory_reclaim_timer_event(uint32_t events) {
+    (void)events;
+    handle_memory_reclaim_timer_expiration(pid);
+}
+
+static void handle_deadline_timer_event(uint32_t events) {
+    (void)events;
+    // Loops check command_is_behind_deadline() after waking up.
+    handle_deadline_timer_expiration(pid);
+}
+
+static void handle_schedule_timer_event(uint32_t events) {
+    (void)events;
+    if (handle_schedule_timer_expiration() == 1) {
+        schedule_mode_has_changed = 1;
     }
+}
 
-    const int wayland_display_file_descriptor = wl_display_get_fd(wayland_display);
-    if (wayland_display_file_descriptor == -1) {
-        fprintf_error("Wayland idle event loop aborted: failed to get Wayland display file descriptor\n");
-        goto run_wayland_idle_event_loop_cleanup;
+static void handle_resume_hold_timer_event(uint32_t events) {
+    (void)events;
+    if (handle_resume_hold_timer_expiration() == 0) {
+        resume_hold_has_expired = 1;
     }
+}
 
-    process_exit_wait_file_descriptor = open_pid_file_descriptor_for_process(pid);
-    if (process_exit_wait_file_descriptor == -1) {
+static void handle_idle_source_event(uint32_t events) {
+    const int result = idle_source->on_readable(events);
+    if (result < 0) {
+        idle_source_has_failed = 1;
+    } else if (result == 1) {
+        idle_source_has_woken_up = 1;
+    }
+}
+
+/**
+ * Replaces pause methods lowering CPU priority with SIGSTOP if the priority couldn't be raised back once the user
+ * is idle, since the command would stay slowed down after the first user activity otherwise.
+ */
+static void fall_back_to_sigstop_if_cpu_priority_can_not_be_restored(void) {
+    for (size_t idle_level = 0; idle_level < get_idle_level_count(); idle_level++) {
+        const enum pause_method level_pause_method = get_idle_level(idle_level)->pause_method;
+        if ((level_pause_method != PAUSE_METHOD_SCHED_IDLE && level_pause_method != PAUSE_METHOD_NICE) ||
+            lowered_cpu_priority_of_process_can_be_restored(pid)) {
+            continue;
+        }
+        if (!quiet) {
+            printf("Raising CPU priority back requires CAP_SYS_NICE or a high enough RLIMIT_NICE, "
+                   "using SIGSTOP instead of %s\n", pause_method_string[level_pause_method]);
+        }
+        set_idle_level_pause_method(idle_level, PAUSE_METHOD_SIGSTOP);
+    }
+}
+
+/**
+ * Registers the file descriptors that every idle detection backend waits for, so that the command exiting, signals
+ * and timers wake up whichever loop is running instead of being polled for.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int add_common_event_sources(void) {
+    process_exit_file_descriptor = open_pid_file_descriptor_for_process(pid);
+    if (process_exit_file_descriptor == -1) {
         const int saved_errno = errno;
         fprintf_error(
             "Failed to open file descriptor for pid %d: %s, falling back to a timer every %lldms for checking if process has exited\n",
@@ -244,284 +391,217 @@ int run_wayland_idle_event_loop(struct wl_display *wayland_display) {
             strerror(saved_errno),
             POLLING_INTERVAL_MS
         );
-        external_pid_fallback_check_timer_file_descriptor = create_periodic_timer_file_descriptor_every_ms(POLLING_INTERVAL_MS);
-        if (external_pid_fallback_check_timer_file_descriptor == -1) {
+        process_exit_fallback_timer_file_descriptor = create_periodic_timer_file_descriptor_every_ms(POLLING_INTERVAL_MS);
+        if (process_exit_fallback_timer_file_descriptor == -1) {
             const int timer_errno = errno;
-            fprintf_error("Failed to create periodic timer file descriptor for external pid fallback: %s\n",
+            fprintf_error("Failed to create periodic timer file descriptor for process exit fallback: %s\n",
                           strerror(timer_errno));
-            goto run_wayland_idle_event_loop_cleanup;
-        }
-    }
-
-    struct pollfd poll_file_descriptors[5];
-    int poll_file_descriptor_count = 0;
-
-    const int wayland_poll_index = poll_file_descriptor_count++;
-    poll_file_descriptors[wayland_poll_index] = (struct pollfd){
-            .fd = wayland_display_file_descriptor,
-            .events = POLLIN,
-            .revents = 0
-    };
-
-    const int start_monitor_poll_index = poll_file_descriptor_count++;
-    poll_file_descriptors[start_monitor_poll_index] = (struct pollfd){
-            .fd = start_monitor_timer_file_descriptor,
-            .events = POLLIN,
-            .revents = 0
-    };
-
-    const int signal_poll_index = poll_file_descriptor_count++;
-    poll_file_descriptors[signal_poll_index] = (struct pollfd){
-            .fd = signal_fd,
-            .events = POLLIN,
-            .revents = 0
-    };
-
-    int process_exit_poll_index = -1;
-    if (process_exit_wait_file_descriptor >= 0) {
-        process_exit_poll_index = poll_file_descriptor_count++;
-        poll_file_descriptors[process_exit_poll_index] = (struct pollfd){
-                .fd = process_exit_wait_file_descriptor,
-                .events = POLLIN,
-                .revents = 0
-        };
-    }
-
-    int external_pid_fallback_poll_index = -1;
-    if (external_pid_fallback_check_timer_file_descriptor >= 0) {
-        external_pid_fallback_poll_index = poll_file_descriptor_count++;
-        poll_file_descriptors[external_pid_fallback_poll_index] = (struct pollfd){
-                .fd = external_pid_fallback_check_timer_file_descriptor,
-                .events = POLLIN,
-                .revents = 0
-        };
-    }
-    //The child could exit after kill(pid, 0) succeeded but before SIGCHLD is delivered/observed
-    exit_if_pid_has_finished(pid);
-
-    if (debug) fprintf(stderr, "Wayland idle event loop started\n");
-    while (1) {
-        if (interruption_received) {
-            result = handle_interruption();
-            goto run_wayland_idle_event_loop_cleanup;
+            return -1;
         }
+    }
+    if (add_event_source(signal_fd, EPOLLIN, handle_signal_event) < 0 ||
+        add_event_source(process_exit_file_descriptor, EPOLLIN, handle_process_exit_event) < 0 ||
+        add_event_source(process_exit_fallback_timer_file_descriptor, EPOLLIN,
+                         handle_process_exit_fallback_timer_event) < 0 ||
+        add_event_source(get_paused_descendants_exit_notification_file_descriptor(), EPOLLIN,
+                         handle_paused_descendants_exit_event) < 0 ||
+        add_event_source(get_descendant_tracking_file_descriptor(), EPOLLIN, handle_descendant_tracking_event) < 0 ||
+        add_event_source(create_duty_cycle_timer_file_descriptor(), EPOLLIN, handle_duty_cycle_timer_event) < 0 ||
+        add_event_source(create_memory_reclaim_timer_file_descriptor(), EPOLLIN,
+                         handle_memory_reclaim_timer_event) < 0 ||
+        add_event_source(create_deadline_timer_file_descriptor(pid), EPOLLIN, handle_deadline_timer_event) < 0 ||
+        add_event_source(create_schedule_timer_file_descriptor(), EPOLLIN, handle_schedule_timer_event) < 0 ||
+        add_event_source(create_resume_hold_timer_file_descriptor(), EPOLLIN, handle_resume_hold_timer_event) < 0) {
+        return -1;
+    }
+    return 0;
+}
 
-        if (sigchld_received) {
-            sigchld_received = 0;
-            exit_if_pid_has_finished(pid);
-        }
-
-        if (wl_display_dispatch_pending(wayland_display) < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-
-            const int saved_errno = errno;
-            fprintf_error("Wayland display dispatch_pending failed: %s\n", strerror(saved_errno));
-            fprintf_error("User will be considered idle to allow the command to finish.\n");
-            break;
-        }
+/**
+ * @return 1 if the loop has to check idle time or the command before the sleep is over, 0 otherwise.
+ */
+static int idle_loop_needs_to_wake_up(void) {
+    return interruption_received || sigchld_received || command_is_behind_deadline() || schedule_mode_has_changed ||
+           resume_hold_has_expired || idle_source_has_woken_up || idle_source_has_failed;
+}
 
-        if (wl_display_flush(wayland_display) < 0) {
-            if (errno == EAGAIN) {
-                wayland_flush_is_pending = 1;
-            } else if (errno == EINTR) {
-                continue;
-            } else {
-                const int saved_errno = errno;
-                fprintf_error("Wayland display flush failed: %s\n", strerror(saved_errno));
-                fprintf_error("User will be considered idle to allow the command to finish.\n");
-                break;
+void sleep_for_ms_handling_events(long long sleep_time_ms) {
+    schedule_mode_has_changed = 0;
+    resume_hold_has_expired = 0;
+    idle_source_has_woken_up = 0;
+    struct timespec sleep_start_time;
+    clock_gettime(CLOCK_MONOTONIC, &sleep_start_time);
+    // Process events, duty cycle and memory reclaim should not cut the sleep short.
+    while (!idle_loop_needs_to_wake_up()) {
+        int timeout_ms = -1;
+        if (sleep_time_ms != SLEEP_UNTIL_WOKEN_UP_MS) {
+            struct timespec current_time;
+            clock_gettime(CLOCK_MONOTONIC, &current_time);
+            const long long remaining_sleep_time_ms =
+                    sleep_time_ms - get_elapsed_time_ms(sleep_start_time, current_time);
+            if (remaining_sleep_time_ms <= 0) {
+                return;
             }
-        } else {
-            wayland_flush_is_pending = 0;
+            timeout_ms = remaining_sleep_time_ms > INT_MAX ? INT_MAX : (int) remaining_sleep_time_ms;
         }
-
-        poll_file_descriptors[wayland_poll_index].events = POLLIN;
-        if (wayland_flush_is_pending) {
-            poll_file_descriptors[wayland_poll_index].events |= POLLOUT;
-        }
-
-        const int poll_result = poll(poll_file_descriptors, poll_file_descriptor_count, -1);
-        if (debug) fprintf(stderr, "poll() returned %d\n", poll_result);
-        if (poll_result < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-
+        if (wait_for_events(timeout_ms) < 0) {
             const int saved_errno = errno;
-            fprintf_error("poll() failed: %s\n", strerror(saved_errno));
-            result = -1;
-            goto run_wayland_idle_event_loop_cleanup;
-        }
-
-        // Check if we received signals via signalfd
-        if (poll_file_descriptors[signal_poll_index].revents & POLLIN) {
-            process_signalfd();
-        }
-
-        if (poll_file_descriptors[wayland_poll_index].revents & POLLNVAL) {
-            fprintf_error("Wayland display file descriptor became invalid\n");
-            result = -1;
-            goto run_wayland_idle_event_loop_cleanup;
-        }
-
-        if (poll_file_descriptors[wayland_poll_index].revents & (POLLHUP | POLLERR)) {
-            fprintf_error("Wayland connection closed, user will be considered idle to allow the command to finish.\n");
-            break;
+            fprintf_error("Waiting for events failed: %s\n", strerror(saved_errno));
+            sleep_for_milliseconds(POLLING_INTERVAL_MS);
+            return;
         }
+    }
+}
 
-        if (poll_file_descriptors[wayland_poll_index].revents & POLLOUT) {
-            if (wl_display_flush(wayland_display) < 0) {
-                if (errno == EAGAIN) {
-                    wayland_flush_is_pending = 1;
-                } else if (errno != EINTR) {
-                    const int saved_errno = errno;
-                    fprintf_error("Wayland display flush failed: %s\n", strerror(saved_errno));
-                    fprintf_error("User will be considered idle to allow the command to finish.\n");
-                    break;
-                }
-            } else {
-                wayland_flush_is_pending = 0;
-            }
+int resume_and_wait_for_pid_to_exit_checking_for_signals(void) {
+    if (command_paused) {
+        if (verbose) {
+            fprintf(stderr, "Since command was previously paused, we will try to resume it now to let it finish\n");
         }
+        stop_duty_cycle();
+        cancel_memory_reclaim();
+        command_paused = 0;
+        resume_command_recursively(pid);
+    }
 
-        if (!monitoring_started && poll_file_descriptors[start_monitor_poll_index].fd >= 0) {
-            const short start_monitor_revents = poll_file_descriptors[start_monitor_poll_index].revents;
-
-            if (start_monitor_revents & POLLNVAL) {
-                fprintf_error("Start-monitor timer file descriptor became invalid\n");
-                result = -1;
-                goto run_wayland_idle_event_loop_cleanup;
-            }
-
-            if (start_monitor_revents & POLLERR) {
-                fprintf_error("Start-monitor timer file descriptor reported an error\n");
-                result = -1;
-                goto run_wayland_idle_event_loop_cleanup;
-            }
-
-            if (start_monitor_revents & POLLIN) {
-                if (consume_timer_file_descriptor_checked(start_monitor_timer_file_descriptor, "start-monitor") < 0) {
-                    result = -1;
-                    goto run_wayland_idle_event_loop_cleanup;
-                }
-
-                close_file_descriptor_if_open(&start_monitor_timer_file_descriptor, "start-monitor timer");
-                poll_file_descriptors[start_monitor_poll_index].fd = -1;
-
-                monitoring_started = 1;
-
-                if (start_wayland_idle_notification_object(&wayland_idle_notification_listener) < 0) {
-                    fprintf_error("Failed to create Wayland idle notification object, user will be considered idle.\n");
-                    break;
-                }
-
-                if (!command_paused) {
-                    pause_running_command_on_user_activity();
-                }
-            }
+    while (1) {
+        if (interruption_received) {
+            return handle_interruption();
         }
-
-        if (process_exit_poll_index >= 0) {
-            const short process_exit_revents = poll_file_descriptors[process_exit_poll_index].revents;
-
-            if (process_exit_revents & POLLNVAL) {
-                fprintf_error("Process-exit file descriptor became invalid\n");
-                result = -1;
-                goto run_wayland_idle_event_loop_cleanup;
-            }
-
-            if (process_exit_revents & (POLLIN | POLLHUP | POLLERR)) {
-                exit_if_pid_has_finished(pid);
-            }
+        if (sigchld_received) {
+            sigchld_received = 0;
         }
+        exit_if_pid_has_finished(pid);
 
-        if (external_pid_fallback_poll_index >= 0) {
-            const short fallback_revents = poll_file_descriptors[external_pid_fallback_poll_index].revents;
-
-            if (fallback_revents & POLLNVAL) {
-                fprintf_error("External-pid fallback timer file descriptor became invalid\n");
-                result = -1;
-                goto run_wayland_idle_event_loop_cleanup;
-            }
-
-            if (fallback_revents & POLLERR) {
-                fprintf_error("External-pid fallback timer file descriptor reported an error\n");
-                result = -1;
-                goto run_wayland_idle_event_loop_cleanup;
-            }
-
-            if (fallback_revents & POLLIN) {
-                if (consume_timer_file_descriptor_checked(external_pid_fallback_check_timer_file_descriptor,
-                                                          "external-pid fallback") < 0) {
-                    result = -1;
-                    goto run_wayland_idle_event_loop_cleanup;
-                }
-
-                exit_if_pid_has_finished(pid);
-            }
+        // The command exiting and signals wake this up, so there is nothing to poll for.
+        if (wait_for_events(-1) < 0) {
+            const int saved_errno = errno;
+            fprintf_error("Waiting for events failed: %s\n", strerror(saved_errno));
+            sleep_for_milliseconds(POLLING_INTERVAL_MS);
         }
+    }
+}
 
-        if (poll_file_descriptors[wayland_poll_index].revents & POLLIN) {
-            const int dispatch_result = wl_display_dispatch(wayland_display);
-            if (dispatch_result < 0) {
-                if (errno == EINTR || errno == EAGAIN) {
-                    continue;
-                }
+/**
+ * @return 1 if the loop is woken up by the idle source and by the command exiting, so it doesn't need to poll for them.
+ *         Without any way of detecting idle time, there is nothing to poll for either.
+ */
+static int idle_loop_is_event_driven(void) {
+    return (!idle_source || idle_source->get_file_descriptor() >= 0) && process_exit_file_descriptor >= 0;
+}
 
-                const int saved_errno = errno;
-                fprintf_error("Wayland display dispatch failed: %s\n", strerror(saved_errno));
-                fprintf_error("User will be considered idle to allow the command to finish.\n");
-                break;
-            }
-        }
+/**
+ * Tells the idle source to wake up at the idle time at which the next idle level is reached or an idle period starts
+ * being measured, and when the user becomes active if it matters for the current idle level or the measured idle period.
+ *
+ * @return 1 if idle time has to be queried again without waiting, 0 if not, -1 if the idle source stopped working.
+ */
+static int prepare_idle_source_for_idle_time(unsigned long user_idle_time_ms) {
+    const size_t idle_level = get_idle_level_for_idle_time(user_idle_time_ms);
+    long unsigned wake_up_at_idle_time_ms = 0;
+    if (idle_level + 1 < get_idle_level_count()) {
+        wake_up_at_idle_time_ms = get_idle_level(idle_level + 1)->idle_time_ms;
     }
-
-    close_file_descriptor_if_open(&start_monitor_timer_file_descriptor, "start-monitor timer");
-    close_file_descriptor_if_open(&process_exit_wait_file_descriptor, "process-exit");
-    close_file_descriptor_if_open(&external_pid_fallback_check_timer_file_descriptor, "external-pid fallback timer");
-    if (verbose) {
-        fprintf(stderr, "Wayland connection lost or loop finished.\n");
+    if (idle_history_is_enabled() && user_idle_time_ms < MIN_OBSERVED_IDLE_PERIOD_MS &&
+        (!wake_up_at_idle_time_ms || MIN_OBSERVED_IDLE_PERIOD_MS < wake_up_at_idle_time_ms)) {
+        wake_up_at_idle_time_ms = MIN_OBSERVED_IDLE_PERIOD_MS;
     }
-    return resume_and_wait_for_pid_to_exit_checking_for_signals();
-
-run_wayland_idle_event_loop_cleanup:
-    close_file_descriptor_if_open(&start_monitor_timer_file_descriptor, "start-monitor timer");
-    close_file_descriptor_if_open(&process_exit_wait_file_descriptor, "process-exit");
-    close_file_descriptor_if_open(&external_pid_fallback_check_timer_file_descriptor, "external-pid fallback timer");
+    const int user_activity_matters = current_idle_level != 0 ||
+                                      (idle_history_is_enabled() && user_idle_time_ms >= MIN_OBSERVED_IDLE_PERIOD_MS);
+    // While the user is typing, waking up on every key press would cost more than polling.
+    const int user_is_active = user_idle_time_ms < (unsigned long) POLLING_INTERVAL_MS;
+    return idle_source->prepare_to_wait(wake_up_at_idle_time_ms,
+                                        user_activity_matters && !user_is_active ? user_idle_time_ms : 0);
+}
 
-    return result;
+/**
+ * Stops monitoring user activity, so that the loop can return.
+ */
+static void stop_idle_source(void) {
+    if (!idle_source) {
+        return;
+    }
+    remove_event_source(idle_source->get_file_descriptor());
+    idle_source->teardown();
+    idle_source = NULL;
 }
 
 static long long pause_or_resume_command_depending_on_user_activity(
         long long sleep_time_ms,
         unsigned long user_idle_time_ms) {
-    if (user_idle_time_ms >= user_idle_timeout_ms) {
+    observe_user_idle_time(user_idle_time_ms);
+    if (get_current_schedule_mode() != SCHEDULE_MODE_IDLE) {
+        // Idle level doesn't matter, it will be overridden by the schedule.
+        switch_command_to_idle_level(0);
+        // The schedule timer wakes the loop up when the window ends, only new threads of a command that keeps
+        // running while paused need to be checked for until then.
+        if (command_paused && pause_method_keeps_command_running()) {
+            throttle_new_threads_of_command(pid);
+            return POLLING_INTERVAL_MS;
+        }
+        return SLEEP_UNTIL_WOKEN_UP_MS;
+    }
+    size_t idle_level = get_idle_level_for_idle_time(user_idle_time_ms);
+    if (idle_level < get_idle_level_count() - 1 && user_idle_period_is_likely_to_last()) {
+        idle_level = get_idle_level_count() - 1;
+    }
+    if (idle_level == get_idle_level_count() - 1) {
+        user_activity_is_pending = 0;
         if (debug)
             fprintf(stderr, "Idle time: %lums, idle timeout: %lums, user is inactive\n", user_idle_time_ms,
                     user_idle_timeout_ms);
-        if (command_paused) {
+        if (current_idle_level != idle_level && resume_should_be_held()) {
+            return POLLING_INTERVAL_MS;
+        }
+        if (current_idle_level != idle_level) {
             sleep_time_ms = POLLING_INTERVAL_MS; //reset to default value
-            if (verbose) {
+            if (verbose && command_paused) {
                 fprintf(stderr, "Idle time: %lums, idle timeout: %lums, resuming command\n", user_idle_time_ms,
                         user_idle_timeout_ms);
             }
-            resume_paused_command_on_user_idle();
+            switch_command_to_idle_level(idle_level);
+        }
+        if (idle_loop_is_event_driven()) {
+            sleep_time_ms = SLEEP_UNTIL_WOKEN_UP_MS;
+        }
+    } else if (idle_level > 0) {
+        user_activity_is_pending = 0;
+        if (debug)
+            fprintf(stderr, "Idle time: %lums, user has reached idle level %zu\n", user_idle_time_ms, idle_level);
+        if (current_idle_level != idle_level) {
+            switch_command_to_idle_level(idle_level);
+        } else if (command_paused) {
+            throttle_new_threads_of_command(pid);
+        }
+        // Command is not fully paused, so user activity needs to be noticed as fast as when the command is running.
+        sleep_time_ms = POLLING_INTERVAL_MS;
+        if (idle_loop_is_event_driven() && !(command_paused && pause_method_keeps_command_running())) {
+            sleep_time_ms = SLEEP_UNTIL_WOKEN_UP_MS;
         }
     } else {
         struct timespec time_when_starting_to_pause;
         int command_was_paused_this_iteration = 0;
         // User is active
-        if (!command_paused) {
+        if (current_idle_level != 0) {
             clock_gettime(CLOCK_MONOTONIC, &time_when_starting_to_pause);
             if (verbose) {
                 fprintf(stderr, "Idle time: %lums.\n", user_idle_time_ms);
             }
-            pause_running_command_on_user_activity();
+            long long time_until_next_attempt_ms = pause_command_on_user_activity_with_hysteresis(
+                    user_idle_time_ms < (unsigned long) min_activity_time_ms / 2);
+            if (time_until_next_attempt_ms != 0) {
+                if (time_until_next_attempt_ms < POLLING_INTERVAL_MS ||
+                    (command_paused && pause_method_keeps_command_running())) {
+                    return POLLING_INTERVAL_MS;
+                }
+                return time_until_next_attempt_ms;
+            }
             command_was_paused_this_iteration = 1;
+        } else {
+            throttle_new_threads_of_command(pid);
         }
-        sleep_time_ms = user_idle_timeout_ms - user_idle_time_ms;
+        // Sleep until the next idle level can be reached
+        sleep_time_ms = get_idle_level(1)->idle_time_ms - user_idle_time_ms;
         if (debug) fprintf(stderr, "Target sleep time: %llums\n", sleep_time_ms);
         if (command_was_paused_this_iteration) {
             if (debug) fprintf(stderr, "Command was paused this iteration\n");
@@ -536,6 +616,15 @@ static long long pause_or_resume_command_depending_on_user_activity(
 
         }
 
+        const long long time_until_next_idle_observation_ms =
+                get_time_until_next_idle_observation_ms(user_idle_time_ms);
+        if (!idle_loop_is_event_driven() && time_until_next_idle_observation_ms >= 0 &&
+            time_until_next_idle_observation_ms < sleep_time_ms) {
+            if (debug)
+                fprintf(stderr, "Checking idle time in %lldms to measure the idle period\n",
+                        time_until_next_idle_observation_ms);
+            sleep_time_ms = time_until_next_idle_observation_ms;
+        }
         if (sleep_time_ms < POLLING_INTERVAL_MS) {
             if (debug)
                 fprintf(stderr,
@@ -543,6 +632,12 @@ static long long pause_or_resume_command_depending_on_user_activity(
                         sleep_time_ms, POLLING_INTERVAL_MS);
             sleep_time_ms = POLLING_INTERVAL_MS;
         }
+        if (pause_method_keeps_command_running() && sleep_time_ms > POLLING_INTERVAL_MS) {
+            if (debug)
+                fprintf(stderr, "Command keeps running while paused, checking for its new threads in %lldms\n",
+                        POLLING_INTERVAL_MS);
+            sleep_time_ms = POLLING_INTERVAL_MS;
+        }
         if (verbose) {
             fprintf(
                     stderr,
@@ -584,60 +679,76 @@ int main(int argc, char *argv[]) {
             fprintf_error("PID %d is not running\n", pid);
             exit(1);
         }
+        // Descendants started after this inherit the value.
+        raise_oom_score_adj_of_process(pid);
     }
     free(shell_command_to_run);
 
-    best_effort_infer_graphical_session_environment_if_missing(verbose);
+    if (pause_method == PAUSE_METHOD_CGROUP_FREEZE && !job_cgroup_contains_command()) {
+        if (!quiet) {
+            printf("Delegated cgroup v2 is not available, using SIGSTOP instead of CGROUP_FREEZE\n");
+        }
+        pause_method = PAUSE_METHOD_SIGSTOP;
+    }
+    if (pause_method == PAUSE_METHOD_CGROUP_THROTTLE && !job_cgroup_contains_command()) {
+        if (!quiet) {
+            printf("Delegated cgroup v2 with cpu and io controllers is not available, "
+                   "using SIGSTOP instead of CGROUP_THROTTLE\n");
+        }
+        pause_method = PAUSE_METHOD_SIGSTOP;
+    }
+    set_idle_level_pause_method(0, pause_method);
+    fall_back_to_sigstop_if_cpu_priority_can_not_be_restored();
+    pause_method = get_idle_level(0)->pause_method;
+    current_idle_level = get_idle_level_count() - 1;
+    if (pause_method != PAUSE_METHOD_CGROUP_FREEZE) {
+        start_tracking_descendants(pid);
+    }
 
-    const int wayland_loop_result = try_monitor_wayland_idle_notify(run_wayland_idle_event_loop);
-    if (wayland_loop_result >= 0) {
+    // The command is running until it's paused for the first time, so that's when its run rate is measured first.
+    start_measuring_command_run_rate(pid);
+    if (add_common_event_sources() < 0) {
+        fprintf_error("Failed to wait for the command and timers\n");
+        exit(1);
+    }
+    if (command_is_behind_deadline()) {
+        const int result = resume_and_wait_for_pid_to_exit_checking_for_signals();
         close(signal_fd);
-        return wayland_loop_result;
+        return result;
     }
 
-    //Wayland failed, try X11
-    x_display = open_x11_display_best_effort();
-    if (!x_display) {
-        xscreensaver_is_available = 0;
-        fprintf_error("Couldn't open an X11 display!\n");
-    } else {
-        int xscreensaver_event_base, xscreensaver_error_base;
-        xscreensaver_is_available = XScreenSaverQueryExtension(
-                x_display, &xscreensaver_event_base, &xscreensaver_error_base);
-        if (xscreensaver_is_available) {
-            xscreensaver_info = XScreenSaverAllocInfo();
-        }
-    }
+    best_effort_infer_graphical_session_environment_if_missing(verbose);
 
-    if (!xscreensaver_is_available) {
+    idle_source = start_idle_source();
+    if (idle_source &&
+        add_event_source(idle_source->get_file_descriptor(), EPOLLIN, handle_idle_source_event) < 0) {
+        idle_source->teardown();
+        idle_source = NULL;
+    }
+    if (!idle_source) {
         fprintf_error("No available method for detecting user idle time on the system, the command will not be paused.\n");
     }
 
     struct timespec time_when_command_started;
     clock_gettime(CLOCK_MONOTONIC, &time_when_command_started);
 
-    long long sleep_time_ms = POLLING_INTERVAL_BEFORE_STARTING_MONITORING_MS;
+    long long sleep_time_ms = start_monitor_after_ms;
     unsigned long user_idle_time_ms = 0;
 
     if (verbose) {
-        if (xscreensaver_is_available) {
-            fprintf(stderr, "Starting to monitor user activity (X11 polling)\n");
-        } else {
+        if (!idle_source) {
             fprintf(stderr, "Starting to monitor the process in fallback mode\n");
+        } else if (idle_source->get_file_descriptor() >= 0) {
+            fprintf(stderr, "Starting to monitor user activity (%s events)\n", idle_source->name);
+        } else {
+            fprintf(stderr, "Starting to monitor user activity (%s polling)\n", idle_source->name);
         }
     }
 
-    struct pollfd pfd = { .fd = signal_fd, .events = POLLIN };
-
     while (1) {
         if (interruption_received) {
             int result_from_interruption = handle_interruption();
-            if (xscreensaver_is_available && xscreensaver_info) {
-                XFree(xscreensaver_info);
-            }
-            if (x_display) {
-                XCloseDisplay(x_display);
-            }
+            stop_idle_source();
             close(signal_fd);
             return result_from_interruption;
         }
@@ -645,6 +756,16 @@ int main(int argc, char *argv[]) {
             sigchld_received = 0;
             exit_if_pid_has_finished(pid);
         }
+        if (idle_source_has_failed) {
+            fprintf_error("User will be considered idle to allow the command to finish.\n");
+        }
+        if (command_is_behind_deadline() || idle_source_has_failed) {
+            // Command will not be paused anymore, so there is no need to monitor user activity.
+            stop_idle_source();
+            const int result = resume_and_wait_for_pid_to_exit_checking_for_signals();
+            close(signal_fd);
+            return result;
+        }
         if (!monitoring_started) {
             struct timespec current_time;
             clock_gettime(CLOCK_MONOTONIC, &current_time);
@@ -652,13 +773,16 @@ int main(int argc, char *argv[]) {
             if (debug) fprintf(stderr, "%lldms elapsed since command started\n", elapsed_ms);
             if (elapsed_ms >= start_monitor_after_ms) {
                 monitoring_started = 1;
+                sleep_time_ms = POLLING_INTERVAL_MS;
+            } else {
+                sleep_time_ms = start_monitor_after_ms - elapsed_ms;
             }
         }
         if (monitoring_started) {
             user_idle_time_ms = query_user_idle_time();
         }
-        // Checking this after querying the screensaver timer so that the command is still running while
-        // we're querying the screensaver and has a chance to do some work and finish,
+        // Checking this after querying the idle source so that the command is still running while
+        // we're querying it and has a chance to do some work and finish,
         // but before potentially pausing the command to avoid trying to pause it if it completed.
         exit_if_pid_has_finished(pid);
 
@@ -667,13 +791,17 @@ int main(int argc, char *argv[]) {
                 sleep_time_ms,
                 user_idle_time_ms);
         }
-        if (debug) fprintf(stderr, "Sleeping for %lldms\n", sleep_time_ms);
-        int sleep_time_ms_int;
-        if (sleep_time_ms > INT_MAX) {
-            sleep_time_ms_int = INT_MAX;
-        } else {
-            sleep_time_ms_int = (int) sleep_time_ms;
+        if (monitoring_started && idle_source) {
+            const int prepare_result = prepare_idle_source_for_idle_time(user_idle_time_ms);
+            if (prepare_result < 0) {
+                idle_source_has_failed = 1;
+                continue;
+            }
+            if (prepare_result == 1) {
+                continue;
+            }
         }
-        sleep_for_ms_with_signalfd(&pfd, sleep_time_ms_int);
+        if (debug) fprintf(stderr, "Sleeping for %lldms\n", sleep_time_ms);
+        sleep_for_ms_handling_events(sleep_time_ms);
     }
-}
\ No newline at end of file
+}
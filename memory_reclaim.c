@@ -0,0 +1,452 @@
+#include "memory_reclaim.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+
+#include "arguments_parsing.h"
+#include "cgroup_utils.h"
+#include "descriptor_utils.h"
+#include "output_settings.h"
+#include "process_handling.h"
+#include "process_tree.h"
+#include "tty_utils.h"
+
+#ifndef MADV_PAGEOUT
+#define MADV_PAGEOUT 21
+#endif
+
+#define PROCESS_MADVISE_MAX_RANGES 1024 // UIO_MAXIOV
+
+typedef struct WorkingSetRange {
+    pid_t process_id;
+    struct iovec range;
+} WorkingSetRange;
+
+static int memory_reclaim_timer_file_descriptor = -1;
+static int process_madvise_is_permitted = 1;
+static WorkingSetRange *working_set_ranges = NULL;
+static size_t working_set_range_count = 0;
+static size_t working_set_ranges_allocated = 0;
+static unsigned long long working_set_resident_bytes = 0;
+
+static long process_madvise_with_pid_file_descriptor(int pid_file_descriptor, const struct iovec *ranges,
+                                                     size_t range_count, int advice) {
+#if defined(SYS_process_madvise)
+    return syscall(SYS_process_madvise, pid_file_descriptor, ranges, range_count, advice, 0);
+#elif defined(__NR_process_madvise)
+    return syscall(__NR_process_madvise, pid_file_descriptor, ranges, range_count, advice, 0);
+#else
+    (void) pid_file_descriptor;
+    (void) ranges;
+    (void) range_count;
+    (void) advice;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/**
+ * @return Resident memory of the process in bytes, or 0 if it could not be read.
+ */
+static unsigned long long get_resident_memory_of_process(pid_t process_id) {
+    char statm_path[64];
+    snprintf(statm_path, sizeof(statm_path), "/proc/%i/statm", process_id);
+    FILE *statm_file = fopen(statm_path, "r");
+    if (!statm_file) {
+        return 0;
+    }
+    unsigned long long total_pages, resident_pages;
+    int fields_read = fscanf(statm_file, "%llu %llu", &total_pages, &resident_pages);
+    fclose(statm_file);
+    if (fields_read != 2) {
+        return 0;
+    }
+    return resident_pages * (unsigned long long) sysconf(_SC_PAGESIZE);
+}
+
+/**
+ * @return 1 for mappings of the kernel that process_madvise() can't be used for, 0 otherwise.
+ */
+static int is_special_kernel_mapping(const char *path) {
+    return strcmp(path, "[vsyscall]") == 0 || strncmp(path, "[vvar", strlen("[vvar")) == 0;
+}
+
+/**
+ * Gives the advice to the kernel for all the ranges. process_madvise() stops at the first range it can't apply
+ * the advice to, e.g. a locked or a huge TLB mapping, so such ranges are skipped and the rest are retried.
+ */
+static void advise_ranges(pid_t process_id, int pid_file_descriptor, struct iovec *ranges, size_t range_count,
+                          int advice) {
+    size_t first_range_index = 0;
+    while (first_range_index < range_count) {
+        long bytes_advised = process_madvise_with_pid_file_descriptor(pid_file_descriptor, ranges + first_range_index,
+                                                                      range_count - first_range_index, advice);
+        if (bytes_advised < 0) {
+            if (errno == EPERM || errno == ENOSYS) {
+                process_madvise_is_permitted = 0;
+                fprintf_error("Failed to use process_madvise() for PID %i: %s. Memory of paused command will not be "
+                              "reclaimed or prefetched, --pause-method=CGROUP_FREEZE allows reclaiming it using "
+                              "cgroup memory controller\n",
+                              process_id, strerror(errno));
+                return;
+            }
+            if (errno == ESRCH) {
+                return;
+            }
+            if (debug) {
+                fprintf(stderr, "Failed to advise %zu bytes at %p of PID %i: %s\n",
+                        ranges[first_range_index].iov_len, ranges[first_range_index].iov_base, process_id,
+                        strerror(errno));
+            }
+            first_range_index++;
+            continue;
+        }
+        // Skip the ranges that were fully advised and the one that caused process_madvise() to stop, if any.
+        while (first_range_index < range_count && (size_t) bytes_advised >= ranges[first_range_index].iov_len) {
+            bytes_advised -= (long) ranges[first_range_index].iov_len;
+            first_range_index++;
+        }
+        if (first_range_index < range_count) {
+            first_range_index++;
+        }
+    }
+}
+
+static int open_pid_file_descriptor_for_process_madvise(pid_t process_id) {
+    int pid_file_descriptor = open_pid_file_descriptor_for_process(process_id);
+    if (pid_file_descriptor == -1 && errno == ENOSYS) {
+        process_madvise_is_permitted = 0;
+        fprintf_error("pidfd_open() is not supported by the kernel, memory of paused command will not be reclaimed "
+                      "or prefetched\n");
+    }
+    return pid_file_descriptor;
+}
+
+static void page_out_memory_of_process(pid_t process_id) {
+    char maps_path[64];
+    snprintf(maps_path, sizeof(maps_path), "/proc/%i/maps", process_id);
+    FILE *maps_file = fopen(maps_path, "r");
+    if (!maps_file) {
+        if (debug) fprintf(stderr, "Failed to open %s: %s\n", maps_path, strerror(errno));
+        return;
+    }
+    int pid_file_descriptor = open_pid_file_descriptor_for_process_madvise(process_id);
+    if (pid_file_descriptor == -1) {
+        fclose(maps_file);
+        return;
+    }
+
+    struct iovec ranges[PROCESS_MADVISE_MAX_RANGES];
+    size_t range_count = 0;
+    char line[PATH_MAX + 128];
+    while (fgets(line, sizeof(line), maps_file) && process_madvise_is_permitted) {
+        unsigned long range_start, range_end;
+        char path[PATH_MAX] = "";
+        if (sscanf(line, "%lx-%lx %*s %*s %*s %*s %4095s", &range_start, &range_end, path) < 2) {
+            continue;
+        }
+        if (is_special_kernel_mapping(path)) {
+            continue;
+        }
+        ranges[range_count].iov_base = (void *) range_start;
+        ranges[range_count].iov_len = range_end - range_start;
+        range_count++;
+        if (range_count == PROCESS_MADVISE_MAX_RANGES) {
+            advise_ranges(process_id, pid_file_descriptor, ranges, range_count, MADV_PAGEOUT);
+            range_count = 0;
+        }
+    }
+    fclose(maps_file);
+    if (range_count && process_madvise_is_permitted) {
+        advise_ranges(process_id, pid_file_descriptor, ranges, range_count, MADV_PAGEOUT);
+    }
+    close(pid_file_descriptor);
+}
+
+static unsigned long long page_out_memory_of_process_tree(pid_t pid) {
+    unsigned long long resident_memory_before = get_resident_memory_of_process(pid);
+    page_out_memory_of_process(pid);
+    unsigned long long resident_memory_after = get_resident_memory_of_process(pid);
+
+    ProcessInfo *child_processes = get_child_processes(pid);
+    for (size_t child_index = 0;
+         child_processes[child_index].process_id != 0 && process_madvise_is_permitted;
+         child_index++) {
+        const pid_t child_process_id = child_processes[child_index].process_id;
+        resident_memory_before += get_resident_memory_of_process(child_process_id);
+        page_out_memory_of_process(child_process_id);
+        resident_memory_after += get_resident_memory_of_process(child_process_id);
+    }
+
+    return resident_memory_after < resident_memory_before ? resident_memory_before - resident_memory_after : 0;
+}
+
+static void add_working_set_range(pid_t process_id, unsigned long range_start, unsigned long range_end) {
+    if (working_set_range_count == working_set_ranges_allocated) {
+        size_t new_allocated = working_set_ranges_allocated ? working_set_ranges_allocated * 2 : 256;
+        WorkingSetRange *new_ranges = realloc(working_set_ranges, new_allocated * sizeof(WorkingSetRange));
+        if (!new_ranges) {
+            perror("Failed to allocate memory for working set");
+            exit(1);
+        }
+        working_set_ranges = new_ranges;
+        working_set_ranges_allocated = new_allocated;
+    }
+    working_set_ranges[working_set_range_count].process_id = process_id;
+    working_set_ranges[working_set_range_count].range.iov_base = (void *) range_start;
+    working_set_ranges[working_set_range_count].range.iov_len = range_end - range_start;
+    working_set_range_count++;
+}
+
+/**
+ * Records runs of pages of the mapping that are present according to /proc/PID/pagemap, until the specified amount
+ * of them is found.
+ *
+ * @return Number of bytes recorded, 0 if pagemap couldn't be read.
+ */
+static unsigned long long record_present_pages_of_range(pid_t process_id, int pagemap_file_descriptor,
+                                                        unsigned long range_start, unsigned long range_end,
+                                                        unsigned long long bytes_to_record) {
+    const unsigned long page_size = (unsigned long) sysconf(_SC_PAGESIZE);
+    uint64_t pagemap_entries[512];
+    unsigned long long recorded_bytes = 0;
+    unsigned long run_start = 0, run_end = 0;
+    unsigned long address = range_start;
+    while (address < range_end && recorded_bytes < bytes_to_record) {
+        size_t entry_count = (range_end - address) / page_size;
+        if (entry_count > sizeof(pagemap_entries) / sizeof(pagemap_entries[0])) {
+            entry_count = sizeof(pagemap_entries) / sizeof(pagemap_entries[0]);
+        }
+        const ssize_t bytes_read = pread(pagemap_file_descriptor, pagemap_entries, entry_count * sizeof(uint64_t),
+                                         (off_t) (address / page_size * sizeof(uint64_t)));
+        if (bytes_read < (ssize_t) sizeof(uint64_t)) {
+            break;
+        }
+        const size_t read_entry_count = bytes_read / sizeof(uint64_t);
+        for (size_t entry_index = 0; entry_index < read_entry_count && recorded_bytes < bytes_to_record;
+             entry_index++) {
+            const unsigned long page_address = address + entry_index * page_size;
+            if (!(pagemap_entries[entry_index] >> 63 & 1)) {
+                continue;
+            }
+            if (page_address != run_end) {
+                if (run_end != run_start) {
+                    add_working_set_range(process_id, run_start, run_end);
+                }
+                run_start = page_address;
+            }
+            run_end = page_address + page_size;
+            recorded_bytes += page_size;
+        }
+        address += read_entry_count * page_size;
+    }
+    if (run_end != run_start) {
+        add_working_set_range(process_id, run_start, run_end);
+    }
+    return recorded_bytes;
+}
+
+/**
+ * Records pages of the process that are resident, until the prefetch budget is used up.
+ *
+ * @return 0 if the budget is used up, 1 otherwise.
+ */
+static int record_working_set_of_process(pid_t process_id) {
+    char smaps_path[64];
+    snprintf(smaps_path, sizeof(smaps_path), "/proc/%i/smaps", process_id);
+    FILE *smaps_file = fopen(smaps_path, "r");
+    if (!smaps_file) {
+        if (debug) fprintf(stderr, "Failed to open %s: %s\n", smaps_path, strerror(errno));
+        return 1;
+    }
+    char pagemap_path[64];
+    snprintf(pagemap_path, sizeof(pagemap_path), "/proc/%i/pagemap", process_id);
+    int pagemap_file_descriptor = open(pagemap_path, O_RDONLY | O_CLOEXEC);
+    if (pagemap_file_descriptor == -1 && debug) {
+        fprintf(stderr, "Failed to open %s: %s, beginnings of mappings will be prefetched\n", pagemap_path,
+                strerror(errno));
+    }
+    const unsigned long long budget_bytes = (unsigned long long) prefetch_budget_mib * 1024 * 1024;
+    unsigned long range_start = 0, range_end = 0;
+    int range_can_be_prefetched = 0;
+    int budget_is_used_up = 0;
+    char line[PATH_MAX + 128];
+    while (!budget_is_used_up && fgets(line, sizeof(line), smaps_file)) {
+        unsigned long next_range_start, next_range_end;
+        char permissions[5];
+        char path[PATH_MAX] = "";
+        if (sscanf(line, "%lx-%lx %4s %*s %*s %*s %4095s", &next_range_start, &next_range_end, permissions,
+                   path) >= 3) {
+            range_start = next_range_start;
+            range_end = next_range_end;
+            range_can_be_prefetched = !is_special_kernel_mapping(path);
+            continue;
+        }
+        unsigned long long resident_kib;
+        if (!range_can_be_prefetched || sscanf(line, "Rss: %llu kB", &resident_kib) != 1 || resident_kib == 0) {
+            continue;
+        }
+        unsigned long long bytes_to_record = resident_kib * 1024;
+        if (bytes_to_record >= budget_bytes - working_set_resident_bytes) {
+            bytes_to_record = budget_bytes - working_set_resident_bytes;
+            budget_is_used_up = 1;
+        }
+        // Only pages that are resident are recorded, so that a large sparse mapping is not read in whole.
+        unsigned long long recorded_bytes = 0;
+        if (pagemap_file_descriptor != -1) {
+            recorded_bytes = record_present_pages_of_range(process_id, pagemap_file_descriptor, range_start, range_end,
+                                                           bytes_to_record);
+        }
+        if (recorded_bytes == 0) {
+            // Resident pages could be anywhere in the mapping, but the beginning of it is as good a guess as any.
+            if (bytes_to_record < range_end - range_start) {
+                range_end = range_start + (unsigned long) bytes_to_record;
+            }
+            add_working_set_range(process_id, range_start, range_end);
+            recorded_bytes = range_end - range_start;
+        }
+        working_set_resident_bytes += recorded_bytes;
+    }
+    if (pagemap_file_descriptor != -1) {
+        close(pagemap_file_descriptor);
+    }
+    fclose(smaps_file);
+    return !budget_is_used_up;
+}
+
+void record_working_set_of_command(pid_t pid) {
+    if (!prefetch_budget_mib || !process_madvise_is_permitted) {
+        return;
+    }
+    working_set_range_count = 0;
+    working_set_resident_bytes = 0;
+    if (record_working_set_of_process(pid)) {
+        ProcessInfo *child_processes = get_child_processes(pid);
+        for (size_t child_index = 0; child_processes[child_index].process_id != 0; child_index++) {
+            if (!record_working_set_of_process(child_processes[child_index].process_id)) {
+                break;
+            }
+        }
+    }
+    if (debug) {
+        fprintf(stderr, "Recorded %zu ranges with %llu MiB resident in working set of the command\n",
+                working_set_range_count, working_set_resident_bytes / (1024 * 1024));
+    }
+}
+
+void prefetch_working_set_of_command(void) {
+    if (!working_set_range_count || !process_madvise_is_permitted) {
+        return;
+    }
+    if (verbose) {
+        fprintf(stderr, "Prefetching %llu MiB of working set of the command\n",
+                working_set_resident_bytes / (1024 * 1024));
+    }
+    struct iovec ranges[PROCESS_MADVISE_MAX_RANGES];
+    size_t range_index = 0;
+    // Ranges are recorded process by process, so every process is advised in batches of consecutive ranges.
+    while (range_index < working_set_range_count && process_madvise_is_permitted) {
+        const pid_t process_id = working_set_ranges[range_index].process_id;
+        size_t batch_range_count = 0;
+        while (range_index < working_set_range_count && batch_range_count < PROCESS_MADVISE_MAX_RANGES &&
+               working_set_ranges[range_index].process_id == process_id) {
+            ranges[batch_range_count++] = working_set_ranges[range_index++].range;
+        }
+        int pid_file_descriptor = open_pid_file_descriptor_for_process_madvise(process_id);
+        if (pid_file_descriptor == -1) {
+            continue;
+        }
+        // MADV_WILLNEED only starts reading the pages in, so this doesn't wait for I/O.
+        advise_ranges(process_id, pid_file_descriptor, ranges, batch_range_count, MADV_WILLNEED);
+        close(pid_file_descriptor);
+    }
+    working_set_range_count = 0;
+    working_set_resident_bytes = 0;
+}
+
+int create_memory_reclaim_timer_file_descriptor(void) {
+    if (!reclaim_memory_after_ms) {
+        return -1;
+    }
+    if (memory_reclaim_timer_file_descriptor == -1) {
+        // Created disarmed, schedule_memory_reclaim() arms it.
+        memory_reclaim_timer_file_descriptor = create_one_shot_timer_file_descriptor_after_ms(0);
+        if (memory_reclaim_timer_file_descriptor == -1) {
+            fprintf_error("Failed to create memory reclaim timer: %s, memory of paused command will not be reclaimed\n",
+                          strerror(errno));
+        }
+    }
+    return memory_reclaim_timer_file_descriptor;
+}
+
+void schedule_memory_reclaim(void) {
+    if (memory_reclaim_timer_file_descriptor == -1) {
+        return;
+    }
+    if (arm_one_shot_timer_file_descriptor_after_ms(memory_reclaim_timer_file_descriptor, reclaim_memory_after_ms) < 0) {
+        fprintf_error("Failed to arm memory reclaim timer: %s\n", strerror(errno));
+    }
+}
+
+void cancel_memory_reclaim(void) {
+    if (memory_reclaim_timer_file_descriptor == -1) {
+        return;
+    }
+    arm_one_shot_timer_file_descriptor_after_ms(memory_reclaim_timer_file_descriptor, 0);
+    // Timer could have expired before it was disarmed.
+    consume_timer_file_descriptor_checked(memory_reclaim_timer_file_descriptor, "memory reclaim");
+}
+
+int handle_memory_reclaim_timer_expiration(pid_t pid) {
+    if (consume_timer_file_descriptor_checked(memory_reclaim_timer_file_descriptor, "memory reclaim") < 0) {
+        return -1;
+    }
+
+    unsigned long long reclaimed_bytes = 0;
+    const char *reclaim_mechanism = "memory.reclaim";
+    if (!job_cgroup_contains_command() || reclaim_job_cgroup_memory(&reclaimed_bytes) != 0) {
+        if (job_cgroup_contains_command() && debug) {
+            fprintf(stderr, "Failed to reclaim memory of the job cgroup: %s, falling back to process_madvise()\n",
+                    strerror(errno));
+        }
+        if (!process_madvise_is_permitted) {
+            return 0;
+        }
+        reclaim_mechanism = "process_madvise()";
+        reclaimed_bytes = page_out_memory_of_process_tree(pid);
+    }
+    if (verbose) {
+        fprintf(stderr, "Reclaimed %llu MiB of memory of paused command using %s\n", reclaimed_bytes / (1024 * 1024),
+                reclaim_mechanism);
+    }
+
+    return 0;
+}
+
+void raise_oom_score_adj_of_process(pid_t process_id) {
+    if (!oom_score_adjustment) {
+        return;
+    }
+    char oom_score_adj_path[64];
+    snprintf(oom_score_adj_path, sizeof(oom_score_adj_path), "/proc/%i/oom_score_adj", process_id);
+    FILE *oom_score_adj_file = fopen(oom_score_adj_path, "w");
+    if (!oom_score_adj_file) {
+        fprintf_error("Failed to open %s: %s\n", oom_score_adj_path, strerror(errno));
+        return;
+    }
+    fprintf(oom_score_adj_file, "%d", oom_score_adjustment);
+    if (fclose(oom_score_adj_file) != 0) {
+        fprintf_error("Failed to write to %s: %s\n", oom_score_adj_path, strerror(errno));
+    } else if (debug) {
+        fprintf(stderr, "Set oom_score_adj of PID %i to %d\n", process_id, oom_score_adjustment);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef RUNWHENIDLE_MEMORY_RECLAIM_H
+#define RUNWHENIDLE_MEMORY_RECLAIM_H
+
+#include <sys/types.h>
+
+/**
+ * Creates the timer used to reclaim memory of the command once it has been paused for reclaim_memory_after_ms.
+ *
+ * @return Timer file descriptor, or -1 if memory reclaim is disabled or the timer could not be created.
+ */
+int create_memory_reclaim_timer_file_descriptor(void);
+
+/**
+ * Schedules memory of the command to be reclaimed if it stays paused for reclaim_memory_after_ms.
+ */
+void schedule_memory_reclaim(void);
+
+/**
+ * Cancels memory reclaim scheduled by schedule_memory_reclaim(). Should be called when the command is resumed.
+ */
+void cancel_memory_reclaim(void);
+
+/**
+ * Reclaims memory of the command. Uses memory.reclaim if the command is in its own cgroup with memory controller
+ * enabled, otherwise pages out every mapping of every process in the tree using process_madvise().
+ * Should be called when the timer expires.
+ *
+ * @param pid The process ID of the command.
+ * @return 0 on success, -1 if reading the timer failed.
+ */
+int handle_memory_reclaim_timer_expiration(pid_t pid);
+
+/**
+ * Records mappings of the paused command that have resident pages, up to prefetch_budget_mib of resident memory,
+ * so that they can be prefetched with prefetch_working_set_of_command() before it's resumed.
+ * Does nothing if prefetch_budget_mib is 0.
+ *
+ * @param pid The process ID of the command.
+ */
+void record_working_set_of_command(pid_t pid);
+
+/**
+ * Asks the kernel to start reading in the working set recorded by record_working_set_of_command(), which could have
+ * been swapped out or evicted from page cache while the command was paused.
+ */
+void prefetch_working_set_of_command(void);
+
+/**
+ * Sets oom_score_adj of the process to oom_score_adjustment, making OOM killer choose it before other processes.
+ * Children inherit the value, so it's enough to call this for the command before it starts any.
+ * Does nothing if oom_score_adjustment is 0.
+ */
+void raise_oom_score_adj_of_process(pid_t process_id);
+
+#endif //RUNWHENIDLE_MEMORY_RECLAIM_H
@@ -10,6 +10,12 @@ enum pause_method {
     //order must match order in pause_method_string
     PAUSE_METHOD_SIGTSTP = 1,
     PAUSE_METHOD_SIGSTOP = 2,
+    PAUSE_METHOD_CGROUP_FREEZE = 3,
+    PAUSE_METHOD_CPU_AFFINITY = 4,
+    PAUSE_METHOD_SCHED_IDLE = 5,
+    PAUSE_METHOD_NICE = 6,
+    PAUSE_METHOD_IOPRIO_IDLE = 7,
+    PAUSE_METHOD_CGROUP_THROTTLE = 8,
 };
 
 extern const char *pause_method_string[];
@@ -0,0 +1,160 @@
+#include "process_events.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/filter.h>
+#include <linux/netlink.h>
+
+#include "output_settings.h"
+#include "tty_utils.h"
+
+static int send_proc_connector_operation(int process_events_socket, enum proc_cn_mcast_op operation) {
+    struct __attribute__((aligned(NLMSG_ALIGNTO))) {
+        struct nlmsghdr netlink_header;
+        struct __attribute__((__packed__)) {
+            struct cn_msg connector_message;
+            enum proc_cn_mcast_op operation;
+        } payload;
+    } message;
+    memset(&message, 0, sizeof(message));
+    message.netlink_header.nlmsg_len = sizeof(message);
+    message.netlink_header.nlmsg_type = NLMSG_DONE;
+    message.netlink_header.nlmsg_pid = getpid();
+    message.payload.connector_message.id.idx = CN_IDX_PROC;
+    message.payload.connector_message.id.val = CN_VAL_PROC;
+    message.payload.connector_message.len = sizeof(enum proc_cn_mcast_op);
+    message.payload.operation = operation;
+
+    if (send(process_events_socket, &message, sizeof(message), 0) != sizeof(message)) {
+        return -1;
+    }
+    return 0;
+}
+
+// Offsets of proc_event fields in a message received from the proc connector
+#define PROC_EVENT_OFFSET (NLMSG_HDRLEN + offsetof(struct cn_msg, data))
+#define PROC_EVENT_FIELD_OFFSET(field) (PROC_EVENT_OFFSET + offsetof(struct proc_event, field))
+
+/**
+ * Makes the kernel drop every message except fork and exit of a process, so that threads starting and exiting,
+ * exec() and other events of the whole system don't wake up the socket.
+ */
+static int attach_process_events_filter(int process_events_socket) {
+    // Word loads convert from network byte order, both sides of the comparisons are converted the same way.
+    struct sock_filter filter[] = {
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_EVENT_FIELD_OFFSET(what)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(PROC_EVENT_FORK), 0, 4),
+            // Fork of a process, not a thread: child_pid == child_tgid
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_EVENT_FIELD_OFFSET(event_data.fork.child_pid)),
+            BPF_STMT(BPF_MISC | BPF_TAX, 0),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_EVENT_FIELD_OFFSET(event_data.fork.child_tgid)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_X, 0, 5, 6),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, htonl(PROC_EVENT_EXIT), 0, 5),
+            // Exit of a process, not a thread: process_pid == process_tgid
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_EVENT_FIELD_OFFSET(event_data.exit.process_pid)),
+            BPF_STMT(BPF_MISC | BPF_TAX, 0),
+            BPF_STMT(BPF_LD | BPF_W | BPF_ABS, PROC_EVENT_FIELD_OFFSET(event_data.exit.process_tgid)),
+            BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_X, 0, 0, 1),
+            BPF_STMT(BPF_RET | BPF_K, 0xffffffff),
+            BPF_STMT(BPF_RET | BPF_K, 0),
+    };
+    struct sock_fprog program = {
+            .len = sizeof(filter) / sizeof(filter[0]),
+            .filter = filter,
+    };
+    return setsockopt(process_events_socket, SOL_SOCKET, SO_ATTACH_FILTER, &program, sizeof(program));
+}
+
+int open_process_events_socket(void) {
+    int process_events_socket = socket(PF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (process_events_socket == -1) {
+        return -1;
+    }
+
+    struct sockaddr_nl address = {
+            .nl_family = AF_NETLINK,
+            .nl_groups = CN_IDX_PROC,
+            .nl_pid = 0, // let the kernel assign a unique ID
+    };
+    // Joining the proc connector group is what requires CAP_NET_ADMIN.
+    // The filter is attached before that, so that no unfiltered events are queued.
+    if (attach_process_events_filter(process_events_socket) == -1 ||
+        bind(process_events_socket, (struct sockaddr *) &address, sizeof(address)) == -1 ||
+        send_proc_connector_operation(process_events_socket, PROC_CN_MCAST_LISTEN) == -1) {
+        int saved_errno = errno;
+        close(process_events_socket);
+        errno = saved_errno;
+        return -1;
+    }
+
+    // Events from the whole system go through this socket, a larger buffer makes overflows less likely.
+    // SO_RCVBUFFORCE ignores rmem_max and is allowed since we already have CAP_NET_ADMIN.
+    const int RECEIVE_BUFFER_SIZE = 4 * 1024 * 1024;
+    if (setsockopt(process_events_socket, SOL_SOCKET, SO_RCVBUFFORCE, &RECEIVE_BUFFER_SIZE,
+                   sizeof(RECEIVE_BUFFER_SIZE)) == -1 && debug) {
+        fprintf(stderr, "Failed to increase process events socket buffer: %s\n", strerror(errno));
+    }
+
+    return process_events_socket;
+}
+
+int read_process_events(int process_events_socket, ProcessForkHandler fork_handler, ProcessExitHandler exit_handler) {
+    char buffer[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+    int events_were_lost = 0;
+    while (1) {
+        ssize_t bytes_received = recv(process_events_socket, buffer, sizeof(buffer), 0);
+        if (bytes_received == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return events_were_lost ? -1 : 0;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == ENOBUFS) {
+                if (verbose) fprintf(stderr, "Process events were lost because socket buffer was full\n");
+                // Events still queued would otherwise be applied after the descendants are reread from /proc,
+                // and an exit of a process whose ID was reused since then would remove a live descendant.
+                events_were_lost = 1;
+                continue;
+            }
+            fprintf_error("Failed to receive process events: %s\n", strerror(errno));
+            return -1;
+        }
+
+        for (struct nlmsghdr *netlink_header = (struct nlmsghdr *) buffer;
+             NLMSG_OK(netlink_header, (size_t) bytes_received);
+             netlink_header = NLMSG_NEXT(netlink_header, bytes_received)) {
+            if (netlink_header->nlmsg_type == NLMSG_ERROR || netlink_header->nlmsg_type == NLMSG_NOOP) {
+                continue;
+            }
+            struct cn_msg *connector_message = NLMSG_DATA(netlink_header);
+            if (connector_message->id.idx != CN_IDX_PROC || connector_message->id.val != CN_VAL_PROC) {
+                continue;
+            }
+            struct proc_event *event = (struct proc_event *) connector_message->data;
+            switch (event->what) {
+                case PROC_EVENT_FORK:
+                    // New threads are reported as forks too, only new processes are interesting.
+                    if (event->event_data.fork.child_pid == event->event_data.fork.child_tgid) {
+                        fork_handler(event->event_data.fork.parent_tgid, event->event_data.fork.child_tgid);
+                    }
+                    break;
+                case PROC_EVENT_EXIT:
+                    if (event->event_data.exit.process_pid == event->event_data.exit.process_tgid) {
+                        exit_handler(event->event_data.exit.process_tgid);
+                    }
+                    break;
+                default:
+                    // exec() does not change which processes belong to the tree
+                    break;
+            }
+        }
+    }
+}
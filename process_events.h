@@ -0,0 +1,25 @@
+#ifndef RUNWHENIDLE_PROCESS_EVENTS_H
+#define RUNWHENIDLE_PROCESS_EVENTS_H
+
+#include <sys/types.h>
+
+typedef void (*ProcessForkHandler)(pid_t parent_process_id, pid_t child_process_id);
+typedef void (*ProcessExitHandler)(pid_t process_id);
+
+/**
+ * Opens a netlink socket subscribed to fork and exit events of all processes on the system
+ * using the proc connector. Other events and events of threads are dropped by a socket filter. Requires CAP_NET_ADMIN.
+ *
+ * @return Non-blocking socket file descriptor or -1 on failure (errno is set).
+ */
+int open_process_events_socket(void);
+
+/**
+ * Reads all pending events from the socket and calls the handlers for processes (not threads)
+ * that were forked or have exited. The socket is drained even if events were lost.
+ *
+ * @return 0 on success, -1 if events were lost because socket buffer overflowed or the socket failed.
+ */
+int read_process_events(int process_events_socket, ProcessForkHandler fork_handler, ProcessExitHandler exit_handler);
+
+#endif //RUNWHENIDLE_PROCESS_EVENTS_H
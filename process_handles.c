@@ -0,0 +1,182 @@
+#include "process_handles.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "output_settings.h"
+#include "process_handling.h"
+#include "tty_utils.h"
+
+static int send_signal_to_pid_file_descriptor(int pid_file_descriptor, int signal) {
+#if defined(SYS_pidfd_send_signal)
+    return (int) syscall(SYS_pidfd_send_signal, pid_file_descriptor, signal, NULL, 0);
+#elif defined(__NR_pidfd_send_signal)
+    return (int) syscall(__NR_pidfd_send_signal, pid_file_descriptor, signal, NULL, 0);
+#else
+    (void) pid_file_descriptor;
+    (void) signal;
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+/**
+ * Every tracked process needs a file descriptor, which can exceed the default soft limit of 1024 for large trees.
+ */
+static void raise_open_files_soft_limit_to_hard_limit(void) {
+    static int open_files_limit_raised = 0;
+    if (open_files_limit_raised) {
+        return;
+    }
+    open_files_limit_raised = 1;
+
+    struct rlimit open_files_limit;
+    if (getrlimit(RLIMIT_NOFILE, &open_files_limit) != 0 || open_files_limit.rlim_cur == open_files_limit.rlim_max) {
+        return;
+    }
+    open_files_limit.rlim_cur = open_files_limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &open_files_limit) != 0) {
+        if (debug) fprintf(stderr, "Failed to raise open files limit: %s\n", strerror(errno));
+    } else if (debug) {
+        fprintf(stderr, "Raised open files limit to %llu\n", (unsigned long long) open_files_limit.rlim_cur);
+    }
+}
+
+static void ensure_process_handle_set_capacity(ProcessHandleSet *set) {
+    if (set->count < set->allocated) {
+        return;
+    }
+    size_t new_allocated = set->allocated ? set->allocated * 2 : 64;
+    ProcessHandle *new_handles = realloc(set->handles, new_allocated * sizeof(ProcessHandle));
+    if (!new_handles) {
+        perror("Failed to allocate memory for process list");
+        exit(1);
+    }
+    set->handles = new_handles;
+    set->allocated = new_allocated;
+}
+
+ProcessHandle *find_process_handle(ProcessHandleSet *set, pid_t process_id) {
+    int handle_index;
+    if (!get_process_id_map_value(&set->handle_index_by_process_id, process_id, &handle_index)) {
+        return NULL;
+    }
+    return &set->handles[handle_index];
+}
+
+int get_process_handle_set_exit_notification_file_descriptor(ProcessHandleSet *set) {
+    if (set->exit_notification_file_descriptor == -1) {
+        set->exit_notification_file_descriptor = epoll_create1(EPOLL_CLOEXEC);
+        if (set->exit_notification_file_descriptor == -1) {
+            fprintf_error("Failed to create epoll file descriptor: %s\n", strerror(errno));
+        }
+    }
+    return set->exit_notification_file_descriptor;
+}
+
+static void open_pid_file_descriptor_for_handle(ProcessHandleSet *set, size_t handle_index) {
+    ProcessHandle *handle = &set->handles[handle_index];
+    // There is still a short window between finding the process and opening pidfd in which PID could be reused,
+    // but once pidfd is open, it always refers to the same process.
+    handle->pid_file_descriptor = open_pid_file_descriptor_for_process(handle->process_id);
+    if (handle->pid_file_descriptor == -1 && errno == EMFILE) {
+        raise_open_files_soft_limit_to_hard_limit();
+        handle->pid_file_descriptor = open_pid_file_descriptor_for_process(handle->process_id);
+    }
+    if (handle->pid_file_descriptor == -1) {
+        if (errno == ESRCH) {
+            handle->has_exited = 1;
+        } else if (debug) {
+            fprintf(stderr, "Failed to open pidfd for PID %i: %s, will use PID instead\n", handle->process_id,
+                    strerror(errno));
+        }
+        return;
+    }
+
+    int exit_notification_file_descriptor = get_process_handle_set_exit_notification_file_descriptor(set);
+    if (exit_notification_file_descriptor == -1) {
+        return;
+    }
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = (uint32_t) handle_index};
+    if (epoll_ctl(exit_notification_file_descriptor, EPOLL_CTL_ADD, handle->pid_file_descriptor, &event) != 0 &&
+        debug) {
+        fprintf(stderr, "Failed to watch pidfd of PID %i: %s\n", handle->process_id, strerror(errno));
+    }
+}
+
+ProcessHandle *add_process_handle(ProcessHandleSet *set, pid_t process_id) {
+    ProcessHandle *existing_handle = find_process_handle(set, process_id);
+    if (existing_handle) {
+        if (existing_handle->has_exited) {
+            existing_handle->has_exited = 0;
+            open_pid_file_descriptor_for_handle(set, existing_handle - set->handles);
+        }
+        return existing_handle;
+    }
+
+    ensure_process_handle_set_capacity(set);
+    size_t handle_index = set->count++;
+    set->handles[handle_index].process_id = process_id;
+    set->handles[handle_index].pid_file_descriptor = -1;
+    set->handles[handle_index].has_exited = 0;
+    set_process_id_map_value(&set->handle_index_by_process_id, process_id, (int) handle_index);
+    open_pid_file_descriptor_for_handle(set, handle_index);
+
+    return &set->handles[handle_index];
+}
+
+int send_signal_to_process_handle(const ProcessHandle *handle, int signal) {
+    if (handle->has_exited) {
+        errno = ESRCH;
+        return -1;
+    }
+    if (handle->pid_file_descriptor != -1) {
+        return send_signal_to_pid_file_descriptor(handle->pid_file_descriptor, signal);
+    }
+    return kill(handle->process_id, signal);
+}
+
+size_t forget_exited_process_handles(ProcessHandleSet *set) {
+    if (set->exit_notification_file_descriptor == -1) {
+        return 0;
+    }
+    size_t exited_count = 0;
+    const int MAX_EVENTS = 64;
+    struct epoll_event events[MAX_EVENTS];
+    int events_count;
+    do {
+        events_count = epoll_wait(set->exit_notification_file_descriptor, events, MAX_EVENTS, 0);
+        for (int event_index = 0; event_index < events_count; event_index++) {
+            size_t handle_index = events[event_index].data.u32;
+            if (handle_index >= set->count) {
+                continue;
+            }
+            ProcessHandle *handle = &set->handles[handle_index];
+            if (debug) fprintf(stderr, "PID %i has exited\n", handle->process_id);
+            // Closing pidfd also removes it from epoll
+            close(handle->pid_file_descriptor);
+            handle->pid_file_descriptor = -1;
+            handle->has_exited = 1;
+            exited_count++;
+        }
+    } while (events_count == MAX_EVENTS);
+
+    return exited_count;
+}
+
+void clear_process_handle_set(ProcessHandleSet *set) {
+    for (size_t handle_index = 0; handle_index < set->count; handle_index++) {
+        if (set->handles[handle_index].pid_file_descriptor != -1) {
+            close(set->handles[handle_index].pid_file_descriptor);
+        }
+    }
+    set->count = 0;
+    clear_process_id_map(&set->handle_index_by_process_id);
+}
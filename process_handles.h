@@ -0,0 +1,69 @@
+#ifndef RUNWHENIDLE_PROCESS_HANDLES_H
+#define RUNWHENIDLE_PROCESS_HANDLES_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "process_id_map.h"
+
+typedef struct ProcessHandle {
+    pid_t process_id;
+    int pid_file_descriptor; // -1 if pidfd could not be opened, signals are sent using PID then.
+    int has_exited;
+} ProcessHandle;
+
+/**
+ * A set of processes, each referred to by a pidfd when kernel supports it,
+ * so that signals are never delivered to an unrelated process that reused the PID.
+ */
+typedef struct ProcessHandleSet {
+    ProcessHandle *handles;
+    size_t count;
+    size_t allocated;
+    ProcessIdMap handle_index_by_process_id;
+    int exit_notification_file_descriptor; // epoll file descriptor watching all pidfds in the set
+} ProcessHandleSet;
+
+#define PROCESS_HANDLE_SET_INITIALIZER {NULL, 0, 0, PROCESS_ID_MAP_INITIALIZER, -1}
+
+/**
+ * Adds a process to the set, opening a pidfd for it. If the process is already in the set and has exited,
+ * it's assumed that the PID was reused and a new pidfd is opened.
+ *
+ * @return Pointer to the handle, valid until the next modification of the set.
+ */
+ProcessHandle *add_process_handle(ProcessHandleSet *set, pid_t process_id);
+
+/**
+ * @return Pointer to the handle if the process is in the set, NULL otherwise.
+ */
+ProcessHandle *find_process_handle(ProcessHandleSet *set, pid_t process_id);
+
+/**
+ * Sends a signal using pidfd_send_signal() if pidfd is available or kill() otherwise.
+ *
+ * @return 0 on success, -1 on failure (errno is set). errno is ESRCH if the process has exited.
+ */
+int send_signal_to_process_handle(const ProcessHandle *handle, int signal);
+
+/**
+ * Returns a file descriptor that becomes readable when a process in the set exits.
+ * It stays the same for the lifetime of the set, so it can be added to poll() once.
+ *
+ * @return File descriptor or -1 if pidfds are not supported.
+ */
+int get_process_handle_set_exit_notification_file_descriptor(ProcessHandleSet *set);
+
+/**
+ * Marks processes that have exited since the last call and closes their pidfds.
+ *
+ * @return Number of processes that have exited.
+ */
+size_t forget_exited_process_handles(ProcessHandleSet *set);
+
+/**
+ * Removes all processes from the set and closes their pidfds. Memory is kept for reuse.
+ */
+void clear_process_handle_set(ProcessHandleSet *set);
+
+#endif //RUNWHENIDLE_PROCESS_HANDLES_H
@@ -6,24 +6,65 @@
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/wait.h>
-#include <dirent.h>
 
 #include "arguments_parsing.h"
+#include "cgroup_utils.h"
+#include "memory_reclaim.h"
 #include "process_handling.h"
 #include "output_settings.h"
 #include "pause_methods.h"
+#include "process_handles.h"
+#include "process_tree.h"
+#include "thread_affinity.h"
+#include "thread_priority.h"
 #include "tty_utils.h"
 
 pid_t run_shell_command(const char *shell_command_to_run) {
     if (verbose) {
         printf("Starting \"%s\"\n", shell_command_to_run);
     }
+    int job_cgroup_created = 0;
+    int cgroup_move_status_pipe[2] = {-1, -1};
+    if (pause_method == PAUSE_METHOD_CGROUP_FREEZE || pause_method == PAUSE_METHOD_CGROUP_THROTTLE) {
+        job_cgroup_created = create_job_cgroup();
+        if (job_cgroup_created && pause_method == PAUSE_METHOD_CGROUP_THROTTLE &&
+            enable_job_cgroup_throttling_controllers(throttle_io_max != NULL) == -1) {
+            remove_job_cgroup();
+            job_cgroup_created = 0;
+        }
+        if (job_cgroup_created && reclaim_memory_after_ms && enable_job_cgroup_memory_controller() == -1 && verbose) {
+            fprintf(stderr, "Failed to enable memory controller for the job cgroup: %s, memory will be reclaimed "
+                            "using process_madvise() instead\n", strerror(errno));
+        }
+        if (job_cgroup_created && pipe(cgroup_move_status_pipe) == -1) {
+            perror("pipe");
+            remove_job_cgroup();
+            job_cgroup_created = 0;
+        }
+    }
     pid_t pid = fork();
     if (pid < 0) {
         perror("fork");
         exit(1);
     } else if (pid == 0) {
         // Child process
+        if (job_cgroup_created) {
+            // Moving before exec() guarantees every descendant of the command starts inside the cgroup.
+            int move_errno = 0;
+            if (move_current_process_into_job_cgroup() == -1) {
+                move_errno = errno;
+            }
+            close(cgroup_move_status_pipe[0]);
+            if (write(cgroup_move_status_pipe[1], &move_errno, sizeof(move_errno)) != sizeof(move_errno)) {
+                perror("write");
+            }
+            close(cgroup_move_status_pipe[1]);
+        }
+        raise_oom_score_adj_of_process(getpid());
+        if (run_in_separate_process_group && setpgid(0, 0) == -1) {
+            perror("setpgid");
+            exit(1);
+        }
         sigset_t empty_set;
         sigemptyset(&empty_set);
         if (sigprocmask(SIG_SETMASK, &empty_set, NULL) == -1) {
@@ -34,6 +75,29 @@ pid_t run_shell_command(const char *shell_command_to_run) {
         perror("execl");
         exit(1);
     }
+    if (run_in_separate_process_group) {
+        // Also done in the parent so that the group exists by the time the command needs to be paused.
+        // Fails harmlessly if the child has already called exec().
+        setpgid(pid, pid);
+    }
+    if (job_cgroup_created) {
+        close(cgroup_move_status_pipe[1]);
+        int move_errno;
+        ssize_t bytes_read;
+        do {
+            bytes_read = read(cgroup_move_status_pipe[0], &move_errno, sizeof(move_errno));
+        } while (bytes_read < 0 && errno == EINTR);
+        close(cgroup_move_status_pipe[0]);
+        if (bytes_read == sizeof(move_errno) && move_errno == 0) {
+            mark_job_cgroup_as_containing_command();
+        } else {
+            if (verbose) {
+                fprintf(stderr, "Failed to move PID %i into its cgroup: %s\n", pid,
+                        bytes_read == sizeof(move_errno) ? strerror(move_errno) : "no status received");
+            }
+            remove_job_cgroup();
+        }
+    }
     if (!quiet) {
         printf("Started \"%s\" with PID %i\n", shell_command_to_run, pid);
     }
@@ -51,212 +115,318 @@ void handle_kill_error(char *signal_name, pid_t pid, int kill_errno) {
     fprintf(stderr, "Failed to send %s signal to PID %i: %s\n", signal_name, pid, strerror(kill_errno));
 }
 
-typedef struct ProcessInfo {
-    int process_id;
-    int parent_process_id;
-} ProcessInfo;
-
-pid_t read_parent_process_id(pid_t process_id) {
-    const int STAT_FILE_PATH_MAX_LENGTH = 64; // proc/%d/stat, where max value of process_id is 4194304, so 64 should never be reached.
-    char stat_file_path[STAT_FILE_PATH_MAX_LENGTH];
-    //Write path into stat_file_path
-    snprintf(stat_file_path, sizeof(stat_file_path), "/proc/%d/stat", process_id);
-
-    // Examples of stat file contents:
-    //3 (rcu_gp) I 2 0 0 0 -1 69238880 0 0 0 0 0 0 0 0 0 -20 1 0 40 0 0 18446744073709551615 0 0 0 0 0 0 0 2147483647 0 0 0 0 17 0 0 0 0 0 0 0 0 0 0 0 0 0 0
-    //2534 ((sd-pam)) S 2508 2508 2508 0 -1 4194624 56 0 0 0 0 0 0 0 20 0 1 0 1649 26865664 1392 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 9 0 0 0 0 0 0 0 0 0 0 0 0 0
-    //784178 (Isolated Web Co) S 3554906 3120 3120 0 -1 4194560 156270 0 0 0 563 133 0 0 20 0 26 0 78028739 2777669632 61094 18446744073709551615 94276324115952 94276324727360 140721125253344 0 0 0 0 69638 1082131704 0 0 0 17 19 0 0 0 0 0 94276324739952 94276324740056 94276339920896 140721125257544 140721125257859 140721125257859 140721125261279 0
-    //87 (kworker/11:0H-events_highpri) I 2 0 0 0 -1 69238880 0 0 0 0 0 0 0 0 0 -20 1 0 41 0 0 18446744073709551615 0 0 0 0 0 0 0 2147483647 0 0 0 0 17 11 0 0 0 0 0 0 0 0 0 0 0 0 0
-
-    // What we need is parent pid, which comes after state.
-    // https://man7.org/linux/man-pages/man5/proc.5.html
-
-    FILE *stat_file;
-    stat_file = fopen(stat_file_path, "r");
-    if (stat_file == NULL) {
-        if ((!quiet && errno != ENOENT) || debug) {
-            fprintf_error("Failed to open %s for reading: %s\n", stat_file_path, strerror(errno));
-        }
-        return 0;
-    }
-    const int MAX_STAT_FILE_READ_LENGTH =
-            7 //length of 4194304 which is max PID value
-            + 1 //space
-            + 64 //Max length of "comm". Documentation says it's 16 characters, but I found longer examples. Better safe than sorry.
-            + 2 //parenthesis around comm
-            + 1 //space
-            + 1 //state
-            + 1 //space
-            + 7 //length of 4194304
-            + 1 //space
-    ;
-    char file_contents[MAX_STAT_FILE_READ_LENGTH];
-    if (!fgets(file_contents, MAX_STAT_FILE_READ_LENGTH, stat_file)) {
-        fprintf_error("Failed to read from %s\n", stat_file_path);
-        fclose(stat_file);
-        return 0;
-    }
-    fclose(stat_file);
-    const int MIN_STAT_FILE_READ_CLOSING_PARENTHESIS_POSITION =
-            1 //min PID length
-            + 1//space
-            + 1 //opening parenthesis
-    ;
-    int file_contents_index;
-    //loop until we find ") ".
-    for (file_contents_index = MIN_STAT_FILE_READ_CLOSING_PARENTHESIS_POSITION;
-         file_contents_index < MAX_STAT_FILE_READ_LENGTH - 1; file_contents_index++) {
-        if (file_contents[file_contents_index] == ')' && file_contents[file_contents_index + 1] == ' ') {
-            break;
-        }
-    }
-    if (file_contents_index == MAX_STAT_FILE_READ_LENGTH - 1) {
-        fprintf_error("Failed to parse %s: reached %d bytes and but did not find \") \".\n", stat_file_path,
-                      MAX_STAT_FILE_READ_LENGTH);
-        return 0;
+void send_signal_to_pid(pid_t pid, int signal, char *signal_name) {
+    if (debug) {
+        printf("Sending %s to %i\n", signal_name, pid);
     }
-    char *parent_process_string = strtok(&file_contents[file_contents_index + 3], " ");
-    return strtol(parent_process_string, NULL, 10);
-}
-
-ProcessInfo *get_child_processes(int initial_parent_process_id) {
-    DIR *proc_directory = opendir("/proc/");
-    if (proc_directory == NULL) {
-        fprintf_error("Could not open /proc directory");
+    int kill_result = kill(pid, signal);
+    if (kill_result == -1) {
+        handle_kill_error(signal_name, pid, errno);
         exit(1);
+    } else {
+        if (debug) fprintf(stderr, "kill function sending %s returned %i\n", signal_name, kill_result);
     }
+}
 
-    // Stage 1: Read all process and parent IDs into an array
-    const int NUMBER_OF_PROCESSES_INITIALLY_ALLOCATED = 4096;
-    int processes_allocated = NUMBER_OF_PROCESSES_INITIALLY_ALLOCATED;
-    ProcessInfo *all_processes;
-    all_processes = malloc(processes_allocated * (sizeof *all_processes));
-    int total_processes = 0;
-
-    struct dirent *directory_entry;
-
-    while ((directory_entry = readdir(proc_directory)) != NULL) {
-        if (total_processes == processes_allocated) {
-            processes_allocated *= 2;
-            ProcessInfo *new_all_processes = realloc(all_processes, processes_allocated * sizeof(ProcessInfo));
-            if (!new_all_processes) {
-                perror("Failed to allocate memory while reading processes list");
-                exit(1);
-            }
-            all_processes = new_all_processes;
-        }
-        int process_id, parent_process_id;
-
-        //Skip everything that's not a directory
-        if (directory_entry->d_type != DT_DIR) continue;
-
-        //Skip all the dirs in that are not numbers
-        if (sscanf(directory_entry->d_name, "%d", &process_id) != 1) continue;
+/**
+ * Descendants stopped by the last pause_command_recursively() call. Stopped processes can't fork,
+ * so this is exactly the set of processes that needs to be resumed.
+ */
+static ProcessHandleSet paused_descendants = PROCESS_HANDLE_SET_INITIALIZER;
 
-        parent_process_id = read_parent_process_id(process_id);
-        if (parent_process_id == 0) {
+/**
+ * Sends a signal to a descendant of the command. Unlike send_signal_to_pid(), doesn't treat descendant
+ * having exited as an error.
+ *
+ * @return 1 if signal was sent, 0 if the process doesn't exist anymore.
+ */
+static int send_signal_to_descendant(const ProcessHandle *descendant, int signal, char *signal_name) {
+    if (debug) {
+        printf("Sending %s to %i\n", signal_name, descendant->process_id);
+    }
+    if (send_signal_to_process_handle(descendant, signal) == -1) {
+        if (errno == ESRCH) {
             if (debug) {
-                fprintf_error("Failed to read parent process id for %d\n", process_id);
+                fprintf(stderr, "PID %i has exited before %s could be sent\n", descendant->process_id, signal_name);
             }
-            continue;
+            return 0;
         }
-
-        all_processes[total_processes].process_id = process_id;
-        all_processes[total_processes].parent_process_id = parent_process_id;
-        total_processes++;
-    }
-    if (debug) {
-        fprintf(stderr, "Read %d processes from /proc\n", total_processes);
-    }
-    closedir(proc_directory);
-
-    // Stage 2: Build an array containing only children of a process
-    ProcessInfo *descendants;
-    descendants = malloc((sizeof *descendants) * total_processes);
-    if (descendants == NULL) {
-        perror("Memory allocation failed");
+        handle_kill_error(signal_name, descendant->process_id, errno);
         exit(1);
     }
-    int known_descendants = 1; //initial value that will be increased if more descendants are found
-    pid_t checked_process_id = initial_parent_process_id;
+    return 1;
+}
 
-    //Iterations can be added to this loop when known_descendants is increased inside it.
-    for (int descendantIndex = 0; descendantIndex < known_descendants; descendantIndex++) {
-        for (int processIndex = 0; processIndex < total_processes; processIndex++) {
-            if (all_processes[processIndex].parent_process_id != checked_process_id) continue;
+static int pause_messages_are_enabled = 1;
 
-            // Add this process ID to descendants to check its children next.
-            descendants[known_descendants - 1] = all_processes[processIndex];
-            known_descendants++;
-        }
-        checked_process_id = descendants[descendantIndex].process_id;
-    }
-    if (debug) {
-        fprintf(stderr, "%d descendants found for the process\n", known_descendants);
-    }
-    descendants[known_descendants - 1].process_id = 0;
-    free(all_processes);
+void set_pause_messages_enabled(int enabled) {
+    pause_messages_are_enabled = enabled;
+}
 
-    return descendants;
+static int pause_messages_are_printed(void) {
+    return !quiet && pause_messages_are_enabled;
 }
 
-void send_signal_to_pid(pid_t pid, int signal, char *signal_name) {
-    if (debug) {
-        printf("Sending %s to %i\n", signal_name, pid);
-    }
-    int kill_result = kill(pid, signal);
-    if (kill_result == -1) {
-        handle_kill_error(signal_name, pid, errno);
-        exit(1);
-    } else {
-        if (debug) fprintf(stderr, "kill function sending %s returned %i\n", signal_name, kill_result);
+static int get_pause_signal(char **signal_name) {
+    switch (pause_method) {
+        case PAUSE_METHOD_SIGTSTP:
+            *signal_name = "SIGTSTP";
+            return SIGTSTP;
+        case PAUSE_METHOD_SIGSTOP:
+            *signal_name = "SIGSTOP";
+            return SIGSTOP;
+        default:
+            fprintf_error("Unsupported pause method: %i\n", pause_method);
+            exit(1);
     }
 }
 
 void pause_command(pid_t pid) {
-    if (!quiet) {
+    if (pause_messages_are_printed()) {
         printf("Pausing PID %i\n", pid);
     }
+    char *signal_name;
+    int signal = get_pause_signal(&signal_name);
+    send_signal_to_pid(pid, signal, signal_name);
+}
+
+int pause_method_keeps_command_running(void) {
+    return pause_method_keeps_command_running_for(pause_method);
+}
+
+int pause_method_keeps_command_running_for(enum pause_method method) {
+    switch (method) {
+        case PAUSE_METHOD_CPU_AFFINITY:
+        case PAUSE_METHOD_SCHED_IDLE:
+        case PAUSE_METHOD_NICE:
+        case PAUSE_METHOD_IOPRIO_IDLE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Applies pause method that keeps the command running to threads of the process that are not throttled yet.
+ *
+ * @return Number of threads throttled.
+ */
+static size_t throttle_threads_of_process(pid_t process_id) {
     switch (pause_method) {
-        case PAUSE_METHOD_SIGTSTP:
-            send_signal_to_pid(pid, SIGTSTP, "SIGTSTP");
-            break;
-        case PAUSE_METHOD_SIGSTOP:
-            send_signal_to_pid(pid, SIGSTOP, "SIGSTOP");
-            break;
+        case PAUSE_METHOD_CPU_AFFINITY:
+            return restrict_threads_of_process_to_reserved_cpus(process_id);
+        case PAUSE_METHOD_SCHED_IDLE:
+            return demote_threads_of_process(process_id, DEMOTE_CPU_TO_SCHED_IDLE | DEMOTE_IO_TO_IDLE_CLASS);
+        case PAUSE_METHOD_NICE:
+            return demote_threads_of_process(process_id, DEMOTE_CPU_TO_NICE_19);
+        case PAUSE_METHOD_IOPRIO_IDLE:
+            return demote_threads_of_process(process_id, DEMOTE_IO_TO_IDLE_CLASS);
         default:
             fprintf_error("Unsupported pause method: %i\n", pause_method);
             exit(1);
     }
 }
 
-void pause_command_recursively(pid_t pid) {
-    pause_command(pid);
+/**
+ * Throttles threads of the command and all its descendants that are not throttled yet.
+ *
+ * @return Number of threads throttled.
+ */
+static size_t throttle_command_tree(pid_t pid) {
+    size_t threads_throttled = throttle_threads_of_process(pid);
     ProcessInfo *child_process_ids = get_child_processes(pid);
-    ProcessInfo *initial_child_process_ids_pointer = child_process_ids;
     while (child_process_ids->process_id != 0) {
-        pause_command(child_process_ids->process_id);
+        threads_throttled += throttle_threads_of_process(child_process_ids->process_id);
         child_process_ids++;
     }
-    free(initial_child_process_ids_pointer);
+    return threads_throttled;
+}
+
+void pause_command_recursively(pid_t pid) {
+    if (pause_method == PAUSE_METHOD_CGROUP_THROTTLE) {
+        if (pause_messages_are_printed()) {
+            printf("Throttling cgroup of PID %i\n", pid);
+        }
+        if (set_job_cgroup_throttled(1, throttle_cpu_max, throttle_io_max, throttle_io_weight) == -1) {
+            fprintf_error("Failed to throttle cgroup of PID %i: %s\n", pid, strerror(errno));
+            exit(1);
+        }
+        return;
+    }
+    if (pause_method_keeps_command_running()) {
+        if (pause_messages_are_printed()) {
+            if (pause_method == PAUSE_METHOD_CPU_AFFINITY) {
+                printf("Restricting PID %i and its descendants to reserved CPUs\n", pid);
+            } else {
+                printf("Lowering priority of PID %i and its descendants\n", pid);
+            }
+        }
+        throttle_command_tree(pid);
+        return;
+    }
+    if (pause_method == PAUSE_METHOD_CGROUP_FREEZE) {
+        if (pause_messages_are_printed()) {
+            printf("Pausing PID %i\n", pid);
+        }
+        if (set_job_cgroup_frozen(1) == 0) {
+            return;
+        }
+        fprintf_error("Failed to freeze cgroup of PID %i: %s, falling back to SIGSTOP\n", pid, strerror(errno));
+        pause_method = PAUSE_METHOD_SIGSTOP;
+    }
+    char *signal_name;
+    int signal = get_pause_signal(&signal_name);
+    if (run_in_separate_process_group) {
+        // All processes in the group are stopped at once, only processes that left the group need to be paused
+        // individually.
+        if (pause_messages_are_printed()) {
+            printf("Pausing process group %i\n", pid);
+        }
+        send_signal_to_pid(-pid, signal, signal_name);
+    } else {
+        pause_command(pid);
+    }
+    clear_process_handle_set(&paused_descendants);
+
+    // Descendants that were still running while the tree was being searched can fork new processes
+    // that are not found by the search. Keep searching until no new descendants are found.
+    // Processes in the group were stopped at once and can't fork, so when no process left the group, a single pass
+    // is enough.
+    const int MAX_PAUSE_PASSES = 10;
+    int pass_number;
+    size_t stragglers_paused = 0;
+    for (pass_number = 1; pass_number <= MAX_PAUSE_PASSES; pass_number++) {
+        size_t descendants_paused_before_this_pass = paused_descendants.count;
+        ProcessInfo *child_process_ids = get_child_processes(pid);
+        while (child_process_ids->process_id != 0) {
+            const ProcessInfo *descendant_info = child_process_ids;
+            pid_t descendant_process_id = descendant_info->process_id;
+            child_process_ids++;
+            if (find_process_handle(&paused_descendants, descendant_process_id)) {
+                continue;
+            }
+            // Process group is read from /proc/PID/stat while finding descendants, except for descendants known
+            // from process events, which don't include it.
+            if (run_in_separate_process_group &&
+                (descendant_info->process_group_id ? descendant_info->process_group_id
+                                                   : getpgid(descendant_process_id)) == pid) {
+                continue;
+            }
+            if (pause_messages_are_printed()) {
+                printf("Pausing PID %i\n", descendant_process_id);
+            }
+            ProcessHandle *descendant = add_process_handle(&paused_descendants, descendant_process_id);
+            send_signal_to_descendant(descendant, signal, signal_name);
+        }
+        size_t descendants_paused_this_pass = paused_descendants.count - descendants_paused_before_this_pass;
+        if (pass_number > 1) {
+            stragglers_paused += descendants_paused_this_pass;
+        }
+        if (descendants_paused_this_pass == 0) {
+            break;
+        }
+    }
+    if (pass_number > MAX_PAUSE_PASSES) {
+        pass_number = MAX_PAUSE_PASSES;
+        if (verbose) {
+            fprintf(stderr, "New descendants were still appearing after %d passes, some of them might be running\n",
+                    MAX_PAUSE_PASSES);
+        }
+    }
+    if (debug) {
+        fprintf(stderr, "Paused %zu descendants in %d passes, %zu of them were found after the first pass\n",
+                paused_descendants.count, pass_number, stragglers_paused);
+    }
 }
 
 void resume_command(pid_t pid) {
-    if (!quiet) {
+    if (pause_messages_are_printed()) {
         printf("Resuming PID %i\n", pid);
     }
     send_signal_to_pid(pid, SIGCONT, "SIGCONT");
 }
 
 void resume_command_recursively(pid_t pid) {
-    resume_command(pid);
-    ProcessInfo *child_process_ids = get_child_processes(pid);
-    ProcessInfo *initial_child_process_ids_pointer = child_process_ids;
-    while (child_process_ids->process_id != 0) {
-        resume_command(child_process_ids->process_id);
-        child_process_ids++;
+    if (pause_method == PAUSE_METHOD_CGROUP_THROTTLE) {
+        if (pause_messages_are_printed()) {
+            printf("Removing throttling from cgroup of PID %i\n", pid);
+        }
+        if (set_job_cgroup_throttled(0, throttle_cpu_max, throttle_io_max, throttle_io_weight) == -1) {
+            fprintf_error("Failed to remove throttling from cgroup of PID %i: %s\n", pid, strerror(errno));
+            exit(1);
+        }
+        return;
+    }
+    if (pause_method == PAUSE_METHOD_CPU_AFFINITY) {
+        if (pause_messages_are_printed()) {
+            printf("Restoring CPU affinity of PID %i and its descendants\n", pid);
+        }
+        // Threads started since the last check inherited the reserved CPUs, record them so that they are restored too.
+        throttle_command_tree(pid);
+        restore_cpu_affinity_of_restricted_threads();
+        return;
+    }
+    if (pause_method_keeps_command_running()) {
+        if (pause_messages_are_printed()) {
+            printf("Restoring priority of PID %i and its descendants\n", pid);
+        }
+        // Threads started since the last check inherited the lowered priority, record them so that it's restored too.
+        throttle_command_tree(pid);
+        restore_priority_of_demoted_threads();
+        return;
+    }
+    if (pause_method == PAUSE_METHOD_CGROUP_FREEZE) {
+        if (pause_messages_are_printed()) {
+            printf("Resuming PID %i\n", pid);
+        }
+        if (set_job_cgroup_frozen(0) == -1) {
+            fprintf_error("Failed to thaw cgroup of PID %i: %s\n", pid, strerror(errno));
+            exit(1);
+        }
+        return;
+    }
+    if (run_in_separate_process_group) {
+        if (pause_messages_are_printed()) {
+            printf("Resuming process group %i\n", pid);
+        }
+        send_signal_to_pid(-pid, SIGCONT, "SIGCONT");
+    } else {
+        resume_command(pid);
+    }
+    // No need to look for descendants again: processes that were stopped can't have forked since.
+    forget_exited_process_handles(&paused_descendants);
+    for (size_t paused_descendant_index = 0; paused_descendant_index < paused_descendants.count;
+         paused_descendant_index++) {
+        const ProcessHandle *descendant = &paused_descendants.handles[paused_descendant_index];
+        if (descendant->has_exited) {
+            continue;
+        }
+        if (pause_messages_are_printed()) {
+            printf("Resuming PID %i\n", descendant->process_id);
+        }
+        send_signal_to_descendant(descendant, SIGCONT, "SIGCONT");
+    }
+    clear_process_handle_set(&paused_descendants);
+}
+
+void throttle_new_threads_of_command(pid_t pid) {
+    if (pause_method_keeps_command_running()) {
+        size_t threads_throttled = throttle_command_tree(pid);
+        if (verbose && threads_throttled) {
+            fprintf(stderr, "Throttled %zu new threads of the command\n", threads_throttled);
+        }
+    }
+}
+
+int get_paused_descendants_exit_notification_file_descriptor(void) {
+    return get_process_handle_set_exit_notification_file_descriptor(&paused_descendants);
+}
+
+void forget_exited_paused_descendants(void) {
+    size_t exited_count = forget_exited_process_handles(&paused_descendants);
+    if (verbose && exited_count) {
+        fprintf(stderr, "%zu paused descendants have exited\n", exited_count);
     }
-    free(initial_child_process_ids_pointer);
 }
 
 int wait_for_pid_to_exit_synchronously(int pid) {
@@ -310,4 +480,4 @@ int open_pid_file_descriptor_for_process(pid_t process_id) {
     errno = ENOSYS;
     return -1;
 #endif
-}
\ No newline at end of file
+}
@@ -1,6 +1,10 @@
 #ifndef RUNWHENIDLE_PROCESS_HANDLING_H
 #define RUNWHENIDLE_PROCESS_HANDLING_H
 
+#include <sys/types.h>
+
+#include "pause_methods.h"
+
 /**
  * Sends a signal to a specified process and handles any errors that occur during the process.
  *
@@ -10,6 +14,12 @@
  */
 void send_signal_to_pid(pid_t pid, int signal, char *signal_name);
 
+/**
+ * Enables or disables "Pausing PID"/"Resuming PID" messages printed when pausing and resuming the command.
+ * Disabled while pausing and resuming frequently, e.g. for duty cycle.
+ */
+void set_pause_messages_enabled(int enabled);
+
 /**
  * Pauses a specified process using pause method specified in pause_method variable
  *
@@ -33,7 +43,8 @@ void pause_command_recursively(pid_t pid);
 void resume_command(pid_t pid);
 
 /**
- * Resumes a specified process and all child processes by sending SIGCONT signal to each process.
+ * Resumes a specified process and all child processes that were paused by pause_command_recursively()
+ * by sending SIGCONT signal to each process.
  *
  * @param pid The process ID of the target process.
  */
@@ -65,6 +76,39 @@ int wait_for_pid_to_exit_synchronously(int pid);
  */
 void exit_if_pid_has_finished(pid_t pid);
 
+/**
+ * @return 1 if the pause method only slows the command down instead of stopping it, so the command can create
+ *         new threads and processes while paused and throttle_new_threads_of_command() needs to be called
+ *         periodically, 0 otherwise.
+ */
+int pause_method_keeps_command_running(void);
+
+/**
+ * Same as pause_method_keeps_command_running(), but for the specified pause method instead of the current one.
+ */
+int pause_method_keeps_command_running_for(enum pause_method method);
+
+/**
+ * Applies the pause method to threads and processes the command has created since it was paused.
+ * Does nothing for pause methods that stop the command.
+ *
+ * @param pid The process ID of the target process.
+ */
+void throttle_new_threads_of_command(pid_t pid);
+
+/**
+ * Returns a file descriptor that becomes readable when one of the descendants paused by
+ * pause_command_recursively() exits. forget_exited_paused_descendants() should be called when it is readable.
+ *
+ * @return File descriptor or -1 if pidfds are not supported.
+ */
+int get_paused_descendants_exit_notification_file_descriptor(void);
+
+/**
+ * Stops tracking paused descendants that have exited.
+ */
+void forget_exited_paused_descendants(void);
+
 int open_pid_file_descriptor_for_process(pid_t process_id);
 
 #endif //RUNWHENIDLE_PROCESS_HANDLING_H
@@ -0,0 +1,101 @@
+#include "process_id_map.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static size_t get_process_id_home_slot(pid_t process_id, size_t slots) {
+    // Fibonacci hashing, sequential PIDs end up in different slots.
+    return ((unsigned int) process_id * 2654435761u) & (slots - 1);
+}
+
+static size_t find_process_id_slot(const ProcessIdMap *map, pid_t process_id) {
+    size_t slot = get_process_id_home_slot(process_id, map->slots);
+    while (map->process_ids[slot] != 0 && map->process_ids[slot] != process_id) {
+        slot = (slot + 1) & (map->slots - 1);
+    }
+    return slot;
+}
+
+static void grow_process_id_map(ProcessIdMap *map) {
+    size_t old_slots = map->slots;
+    pid_t *old_process_ids = map->process_ids;
+    int *old_values = map->values;
+
+    map->slots = old_slots ? old_slots * 2 : 128;
+    map->process_ids = calloc(map->slots, sizeof(pid_t));
+    map->values = malloc(map->slots * sizeof(int));
+    if (!map->process_ids || !map->values) {
+        perror("Failed to allocate memory for process list");
+        exit(1);
+    }
+    for (size_t old_slot = 0; old_slot < old_slots; old_slot++) {
+        if (old_process_ids[old_slot] == 0) continue;
+        size_t slot = find_process_id_slot(map, old_process_ids[old_slot]);
+        map->process_ids[slot] = old_process_ids[old_slot];
+        map->values[slot] = old_values[old_slot];
+    }
+    free(old_process_ids);
+    free(old_values);
+}
+
+void set_process_id_map_value(ProcessIdMap *map, pid_t process_id, int value) {
+    // Keep the table at most half full
+    if ((map->count + 1) * 2 > map->slots) {
+        grow_process_id_map(map);
+    }
+    size_t slot = find_process_id_slot(map, process_id);
+    if (map->process_ids[slot] == 0) {
+        map->process_ids[slot] = process_id;
+        map->count++;
+    }
+    map->values[slot] = value;
+}
+
+int get_process_id_map_value(const ProcessIdMap *map, pid_t process_id, int *out_value) {
+    if (map->count == 0) {
+        return 0;
+    }
+    size_t slot = find_process_id_slot(map, process_id);
+    if (map->process_ids[slot] == 0) {
+        return 0;
+    }
+    *out_value = map->values[slot];
+    return 1;
+}
+
+void remove_process_id_map_value(ProcessIdMap *map, pid_t process_id) {
+    if (map->count == 0) {
+        return;
+    }
+    size_t emptied_slot = find_process_id_slot(map, process_id);
+    if (map->process_ids[emptied_slot] == 0) {
+        return;
+    }
+    map->count--;
+
+    // Move back entries that would not be found anymore because of the gap left in their probe sequence.
+    size_t slot = emptied_slot;
+    while (1) {
+        slot = (slot + 1) & (map->slots - 1);
+        if (map->process_ids[slot] == 0) {
+            break;
+        }
+        size_t home_slot = get_process_id_home_slot(map->process_ids[slot], map->slots);
+        size_t distance_from_home = (slot - home_slot) & (map->slots - 1);
+        size_t distance_from_emptied = (slot - emptied_slot) & (map->slots - 1);
+        if (distance_from_home >= distance_from_emptied) {
+            map->process_ids[emptied_slot] = map->process_ids[slot];
+            map->values[emptied_slot] = map->values[slot];
+            emptied_slot = slot;
+        }
+    }
+    map->process_ids[emptied_slot] = 0;
+}
+
+void clear_process_id_map(ProcessIdMap *map) {
+    if (map->slots) {
+        memset(map->process_ids, 0, map->slots * sizeof(pid_t));
+    }
+    map->count = 0;
+}
@@ -0,0 +1,40 @@
+#ifndef RUNWHENIDLE_PROCESS_ID_MAP_H
+#define RUNWHENIDLE_PROCESS_ID_MAP_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * Hash table mapping process IDs to integers, usually indexes in an array of processes.
+ * Uses open addressing with linear probing, process ID 0 marks an empty slot.
+ */
+typedef struct ProcessIdMap {
+    pid_t *process_ids;
+    int *values;
+    size_t slots;
+    size_t count;
+} ProcessIdMap;
+
+#define PROCESS_ID_MAP_INITIALIZER {NULL, NULL, 0, 0}
+
+/**
+ * Inserts a process ID into the map or updates its value if it's already there.
+ */
+void set_process_id_map_value(ProcessIdMap *map, pid_t process_id, int value);
+
+/**
+ * @return 1 and stores the value into out_value if process ID is in the map, 0 otherwise.
+ */
+int get_process_id_map_value(const ProcessIdMap *map, pid_t process_id, int *out_value);
+
+/**
+ * Removes a process ID from the map if it's there.
+ */
+void remove_process_id_map_value(ProcessIdMap *map, pid_t process_id);
+
+/**
+ * Removes all process IDs from the map. Memory is kept for reuse.
+ */
+void clear_process_id_map(ProcessIdMap *map);
+
+#endif //RUNWHENIDLE_PROCESS_ID_MAP_H
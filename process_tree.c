@@ -0,0 +1,579 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+
+#include "output_settings.h"
+#include "process_events.h"
+#include "process_id_map.h"
+#include "process_tree.h"
+#include "tty_utils.h"
+
+/**
+ * Buffers reused by every call to get_child_processes(). They only grow, so once they are large enough
+ * for the process tree and the system, finding descendants does not allocate memory.
+ */
+typedef struct ProcessTreeArena {
+    ProcessInfo *all_processes;
+    size_t all_processes_allocated;
+    int *next_process_index_with_same_bucket;
+    size_t next_process_index_with_same_bucket_allocated;
+    int *first_process_index_by_parent_bucket;
+    size_t first_process_index_by_parent_bucket_allocated;
+    ProcessInfo *descendants;
+    size_t descendants_allocated;
+    int known_descendants;
+} ProcessTreeArena;
+
+static ProcessTreeArena process_tree_arena;
+
+static void ensure_arena_buffer_capacity(void **buffer, size_t *allocated, size_t required, size_t element_size) {
+    if (required <= *allocated) {
+        return;
+    }
+    const size_t MINIMUM_ELEMENTS_ALLOCATED = 64;
+    size_t new_allocated = *allocated ? *allocated : MINIMUM_ELEMENTS_ALLOCATED;
+    while (new_allocated < required) {
+        new_allocated *= 2;
+    }
+    void *new_buffer = realloc(*buffer, new_allocated * element_size);
+    if (!new_buffer) {
+        perror("Failed to allocate memory while reading processes list");
+        exit(1);
+    }
+    *buffer = new_buffer;
+    *allocated = new_allocated;
+}
+
+static void append_descendant(pid_t process_id, pid_t parent_process_id, pid_t process_group_id) {
+    ensure_arena_buffer_capacity((void **) &process_tree_arena.descendants, &process_tree_arena.descendants_allocated,
+                                 process_tree_arena.known_descendants + 1, sizeof(ProcessInfo));
+    process_tree_arena.descendants[process_tree_arena.known_descendants].process_id = process_id;
+    process_tree_arena.descendants[process_tree_arena.known_descendants].parent_process_id = parent_process_id;
+    process_tree_arena.descendants[process_tree_arena.known_descendants].process_group_id = process_group_id;
+    process_tree_arena.known_descendants++;
+}
+
+/**
+ * Layout of entries returned by getdents64 syscall, see getdents(2).
+ */
+struct linux_directory_entry64 {
+    unsigned long long d_ino;
+    long long d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/**
+ * Parses a non-negative decimal number.
+ *
+ * @return The number, or -1 if string contains anything other than digits.
+ */
+static int parse_process_id(const char *process_id_string) {
+    int process_id = 0;
+    if (*process_id_string == '\0') {
+        return -1;
+    }
+    for (const char *character = process_id_string; *character != '\0'; character++) {
+        if (*character < '0' || *character > '9') {
+            return -1;
+        }
+        process_id = process_id * 10 + (*character - '0');
+    }
+    return process_id;
+}
+
+/**
+ * Fields of /proc/PID/stat used while finding descendants.
+ */
+typedef struct ProcessStat {
+    pid_t parent_process_id;
+    pid_t process_group_id;
+    int thread_count;
+} ProcessStat;
+
+/**
+ * Parses a number followed by a space and moves the position after the space.
+ *
+ * @return 0 on success, -1 if there is no number or it was cut off by the end of the buffer.
+ */
+static int parse_next_stat_number(const char **position, const char *end, long long *out_value) {
+    const char *character = *position;
+    const int is_negative = character < end && *character == '-';
+    if (is_negative) {
+        character++;
+    }
+    const char *digits_start = character;
+    unsigned long long value = 0;
+    for (; character < end && *character >= '0' && *character <= '9'; character++) {
+        value = value * 10 + (*character - '0');
+    }
+    if (character == digits_start || character >= end || *character != ' ') {
+        return -1;
+    }
+    *out_value = is_negative ? -(long long) value : (long long) value;
+    *position = character + 1;
+    return 0;
+}
+
+/**
+ * Reads parent process id, process group id and number of threads from /proc/PID/stat.
+ *
+ * @param proc_directory_file_descriptor File descriptor of opened /proc directory.
+ * @param process_id_string Name of the process directory in /proc.
+ * @param out_process_stat Fields that couldn't be read are set to 0.
+ * @return 0 on success, -1 if parent process id couldn't be read.
+ */
+static int read_process_stat(int proc_directory_file_descriptor, const char *process_id_string,
+                             ProcessStat *out_process_stat) {
+    out_process_stat->parent_process_id = 0;
+    out_process_stat->process_group_id = 0;
+    out_process_stat->thread_count = 0;
+    const int STAT_FILE_PATH_MAX_LENGTH = 32; // %s/stat, where max value of process_id is 4194304
+    char stat_file_path[STAT_FILE_PATH_MAX_LENGTH];
+    int stat_file_path_length = snprintf(stat_file_path, sizeof(stat_file_path), "%s/stat", process_id_string);
+    if (stat_file_path_length < 0 || stat_file_path_length >= STAT_FILE_PATH_MAX_LENGTH) {
+        return -1;
+    }
+
+    // Examples of stat file contents:
+    //3 (rcu_gp) I 2 0 0 0 -1 69238880 0 0 0 0 0 0 0 0 0 -20 1 0 40 0 0 18446744073709551615 0 0 0 0 0 0 0 2147483647 0 0 0 0 17 0 0 0 0 0 0 0 0 0 0 0 0 0 0
+    //2534 ((sd-pam)) S 2508 2508 2508 0 -1 4194624 56 0 0 0 0 0 0 0 20 0 1 0 1649 26865664 1392 18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 0 17 9 0 0 0 0 0 0 0 0 0 0 0 0 0
+    //784178 (Isolated Web Co) S 3554906 3120 3120 0 -1 4194560 156270 0 0 0 563 133 0 0 20 0 26 0 78028739 2777669632 61094 18446744073709551615 94276324115952 94276324727360 140721125253344 0 0 0 0 69638 1082131704 0 0 0 17 19 0 0 0 0 0 94276324739952 94276324740056 94276339920896 140721125257544 140721125257859 140721125257859 140721125261279 0
+    //87 (kworker/11:0H-events_highpri) I 2 0 0 0 -1 69238880 0 0 0 0 0 0 0 0 0 -20 1 0 41 0 0 18446744073709551615 0 0 0 0 0 0 0 2147483647 0 0 0 0 17 11 0 0 0 0 0 0 0 0 0 0 0 0 0
+
+    // What we need is parent pid, which comes after state, process group id after it, and num_threads,
+    // which is the 20th field.
+    // https://man7.org/linux/man-pages/man5/proc.5.html
+    const int PARENT_PROCESS_ID_FIELD = 4;
+    const int PROCESS_GROUP_ID_FIELD = 5;
+    const int THREAD_COUNT_FIELD = 20;
+
+    // Opening relative to /proc directory avoids resolving /proc for every process.
+    int stat_file_descriptor = openat(proc_directory_file_descriptor, stat_file_path, O_RDONLY | O_CLOEXEC);
+    if (stat_file_descriptor == -1) {
+        if ((!quiet && errno != ENOENT && errno != ESRCH) || debug) {
+            fprintf_error("Failed to open /proc/%s for reading: %s\n", stat_file_path, strerror(errno));
+        }
+        return -1;
+    }
+    // Fields up to num_threads are at most 7 digits of PID, 64 characters of comm (documentation says it's 16,
+    // but longer examples exist) with parentheses, state, and 16 numbers of at most 20 characters, separated by spaces.
+    const int MAX_STAT_FILE_READ_LENGTH = 512;
+    char file_contents[MAX_STAT_FILE_READ_LENGTH];
+    ssize_t bytes_read = read(stat_file_descriptor, file_contents, MAX_STAT_FILE_READ_LENGTH);
+    close(stat_file_descriptor);
+    if (bytes_read <= 0) {
+        if (debug) fprintf_error("Failed to read from /proc/%s\n", stat_file_path);
+        return -1;
+    }
+
+    // comm can contain any characters including spaces and parenthesis, but nothing after it can contain ")",
+    // so the last ")" in what was read is the end of comm.
+    const char *closing_parenthesis = NULL;
+    for (ssize_t file_contents_index = bytes_read - 1; file_contents_index >= 0; file_contents_index--) {
+        if (file_contents[file_contents_index] == ')') {
+            closing_parenthesis = &file_contents[file_contents_index];
+            break;
+        }
+    }
+    const char *file_contents_end = file_contents + bytes_read;
+    //Skip ") ", state and a space after it.
+    const char *field_position = closing_parenthesis ? closing_parenthesis + 4 : file_contents_end;
+    if (field_position >= file_contents_end) {
+        fprintf_error("Failed to parse /proc/%s: did not find \") \" in the first %zd bytes.\n", stat_file_path,
+                      bytes_read);
+        return -1;
+    }
+    for (int field_number = PARENT_PROCESS_ID_FIELD; field_number <= THREAD_COUNT_FIELD; field_number++) {
+        long long field_value;
+        if (parse_next_stat_number(&field_position, file_contents_end, &field_value) == -1) {
+            break;
+        }
+        if (field_number == PARENT_PROCESS_ID_FIELD) {
+            out_process_stat->parent_process_id = (pid_t) field_value;
+        } else if (field_number == PROCESS_GROUP_ID_FIELD) {
+            out_process_stat->process_group_id = (pid_t) field_value;
+        } else if (field_number == THREAD_COUNT_FIELD) {
+            out_process_stat->thread_count = (int) field_value;
+        }
+    }
+    return out_process_stat->parent_process_id ? 0 : -1;
+}
+
+static size_t get_parent_bucket(pid_t parent_process_id, size_t bucket_mask) {
+    // Fibonacci hashing, sequential PIDs end up in different buckets.
+    return ((unsigned int) parent_process_id * 2654435761u) & bucket_mask;
+}
+
+static ProcessInfo *get_child_processes_by_scanning_all_processes(int initial_parent_process_id) {
+    int proc_directory_file_descriptor = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (proc_directory_file_descriptor == -1) {
+        fprintf_error("Could not open /proc directory");
+        exit(1);
+    }
+
+    // Stage 1: Read all process and parent IDs into an array
+    size_t total_processes = 0;
+
+    // Directory entries are read with getdents64 directly into a stack buffer to avoid allocations done by readdir().
+    char directory_entries_buffer[32768];
+    long bytes_read;
+    while ((bytes_read = syscall(SYS_getdents64, proc_directory_file_descriptor, directory_entries_buffer,
+                                 sizeof(directory_entries_buffer))) > 0) {
+        for (long buffer_offset = 0; buffer_offset < bytes_read;) {
+            const struct linux_directory_entry64 *directory_entry =
+                    (const struct linux_directory_entry64 *) (directory_entries_buffer + buffer_offset);
+            buffer_offset += directory_entry->d_reclen;
+
+            //Skip everything that's not a directory
+            if (directory_entry->d_type != DT_DIR) continue;
+
+            //Skip all the dirs in that are not numbers
+            int process_id = parse_process_id(directory_entry->d_name);
+            if (process_id <= 0) continue;
+
+            ProcessStat process_stat;
+            if (read_process_stat(proc_directory_file_descriptor, directory_entry->d_name, &process_stat) == -1) {
+                if (debug) {
+                    fprintf_error("Failed to read parent process id for %d\n", process_id);
+                }
+                continue;
+            }
+
+            ensure_arena_buffer_capacity((void **) &process_tree_arena.all_processes,
+                                         &process_tree_arena.all_processes_allocated,
+                                         total_processes + 1, sizeof(ProcessInfo));
+            process_tree_arena.all_processes[total_processes].process_id = process_id;
+            process_tree_arena.all_processes[total_processes].parent_process_id = process_stat.parent_process_id;
+            process_tree_arena.all_processes[total_processes].process_group_id = process_stat.process_group_id;
+            total_processes++;
+        }
+    }
+    if (bytes_read < 0) {
+        fprintf_error("Failed to read /proc directory: %s\n", strerror(errno));
+    }
+    if (debug) {
+        fprintf(stderr, "Read %zu processes from /proc\n", total_processes);
+    }
+    close(proc_directory_file_descriptor);
+
+    // Stage 2: Index processes by parent process ID. Every bucket is a linked list of indexes in all_processes,
+    // so that children of a process can be found without going through all the processes.
+    size_t bucket_count = 1;
+    while (bucket_count < total_processes) {
+        bucket_count *= 2;
+    }
+    const size_t bucket_mask = bucket_count - 1;
+    ensure_arena_buffer_capacity((void **) &process_tree_arena.first_process_index_by_parent_bucket,
+                                 &process_tree_arena.first_process_index_by_parent_bucket_allocated,
+                                 bucket_count, sizeof(int));
+    ensure_arena_buffer_capacity((void **) &process_tree_arena.next_process_index_with_same_bucket,
+                                 &process_tree_arena.next_process_index_with_same_bucket_allocated,
+                                 total_processes, sizeof(int));
+    int *first_process_index_by_parent_bucket = process_tree_arena.first_process_index_by_parent_bucket;
+    int *next_process_index_with_same_bucket = process_tree_arena.next_process_index_with_same_bucket;
+    const ProcessInfo *all_processes = process_tree_arena.all_processes;
+    for (size_t bucket_index = 0; bucket_index < bucket_count; bucket_index++) {
+        first_process_index_by_parent_bucket[bucket_index] = -1;
+    }
+    for (size_t process_index = 0; process_index < total_processes; process_index++) {
+        size_t bucket_index = get_parent_bucket(all_processes[process_index].parent_process_id, bucket_mask);
+        next_process_index_with_same_bucket[process_index] = first_process_index_by_parent_bucket[bucket_index];
+        first_process_index_by_parent_bucket[bucket_index] = (int) process_index;
+    }
+
+    // Stage 3: Build an array containing only descendants of a process, breadth first.
+    process_tree_arena.known_descendants = 0;
+    pid_t checked_process_id = initial_parent_process_id;
+    //Iterations can be added to this loop when known_descendants is increased inside it.
+    for (int descendant_index = -1; descendant_index < process_tree_arena.known_descendants; descendant_index++) {
+        if (descendant_index >= 0) {
+            checked_process_id = process_tree_arena.descendants[descendant_index].process_id;
+        }
+        for (int process_index = first_process_index_by_parent_bucket[get_parent_bucket(checked_process_id,
+                                                                                         bucket_mask)];
+             process_index != -1;
+             process_index = next_process_index_with_same_bucket[process_index]) {
+            if (all_processes[process_index].parent_process_id != checked_process_id) continue;
+
+            append_descendant(all_processes[process_index].process_id, checked_process_id,
+                              all_processes[process_index].process_group_id);
+        }
+    }
+    if (debug) {
+        fprintf(stderr, "%d descendants found for the process\n", process_tree_arena.known_descendants);
+    }
+    append_descendant(0, 0, 0);
+
+    return process_tree_arena.descendants;
+}
+
+
+static int children_file_is_supported(void) {
+    // /proc/PID/task/TID/children is only available when the kernel is built with CONFIG_PROC_CHILDREN
+    static int children_file_support = -1;
+    if (children_file_support == -1) {
+        char children_file_path[64];
+        snprintf(children_file_path, sizeof(children_file_path), "/proc/%d/task/%d/children", getpid(), getpid());
+        children_file_support = access(children_file_path, R_OK) == 0;
+        if (debug) {
+            fprintf(stderr, "%s is %savailable\n", children_file_path, children_file_support ? "" : "not ");
+        }
+    }
+    return children_file_support;
+}
+
+/**
+ * Appends children of the thread to descendants. Children are attributed to the thread that forked them,
+ * so every thread of a process has to be checked.
+ */
+static void append_children_of_thread(pid_t process_id, pid_t thread_id) {
+    const int CHILDREN_FILE_PATH_MAX_LENGTH = 64; // /proc/%d/task/%d/children
+    char children_file_path[CHILDREN_FILE_PATH_MAX_LENGTH];
+    snprintf(children_file_path, sizeof(children_file_path), "/proc/%d/task/%d/children", process_id, thread_id);
+
+    // Read into a stack buffer instead of using stdio, which would allocate a buffer for every thread.
+    int children_file_descriptor = open(children_file_path, O_RDONLY | O_CLOEXEC);
+    if (children_file_descriptor == -1) {
+        // Thread exited while we were reading the directory
+        return;
+    }
+    char file_contents[4096];
+    ssize_t bytes_read;
+    // Process IDs are separated by spaces and can be split between reads.
+    pid_t child_process_id = 0;
+    int child_process_id_has_digits = 0;
+    while ((bytes_read = read(children_file_descriptor, file_contents, sizeof(file_contents))) > 0) {
+        for (ssize_t file_contents_index = 0; file_contents_index < bytes_read; file_contents_index++) {
+            const char character = file_contents[file_contents_index];
+            if (character >= '0' && character <= '9') {
+                child_process_id = child_process_id * 10 + (character - '0');
+                child_process_id_has_digits = 1;
+            } else if (child_process_id_has_digits) {
+                append_descendant(child_process_id, process_id, 0);
+                child_process_id = 0;
+                child_process_id_has_digits = 0;
+            }
+        }
+    }
+    if (child_process_id_has_digits) {
+        append_descendant(child_process_id, process_id, 0);
+    }
+    close(children_file_descriptor);
+}
+
+int for_each_thread_of_process(pid_t process_id, ThreadHandler thread_handler) {
+    const int TASK_DIRECTORY_PATH_MAX_LENGTH = 32; // /proc/%d/task, where max value of process_id is 4194304
+    char task_directory_path[TASK_DIRECTORY_PATH_MAX_LENGTH];
+    snprintf(task_directory_path, sizeof(task_directory_path), "/proc/%d/task", process_id);
+
+    int task_directory_file_descriptor = open(task_directory_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (task_directory_file_descriptor == -1) {
+        if ((!quiet && errno != ENOENT) || debug) {
+            fprintf_error("Failed to open %s: %s\n", task_directory_path, strerror(errno));
+        }
+        return 0;
+    }
+    // Like for /proc, getdents64 is used instead of readdir(), which allocates memory for every directory.
+    char directory_entries_buffer[4096];
+    long bytes_read;
+    while ((bytes_read = syscall(SYS_getdents64, task_directory_file_descriptor, directory_entries_buffer,
+                                 sizeof(directory_entries_buffer))) > 0) {
+        for (long buffer_offset = 0; buffer_offset < bytes_read;) {
+            const struct linux_directory_entry64 *directory_entry =
+                    (const struct linux_directory_entry64 *) (directory_entries_buffer + buffer_offset);
+            buffer_offset += directory_entry->d_reclen;
+            int thread_id = parse_process_id(directory_entry->d_name);
+            if (thread_id <= 0) continue;
+            thread_handler(process_id, thread_id);
+        }
+    }
+    close(task_directory_file_descriptor);
+
+    return 1;
+}
+
+/**
+ * Appends children of a found descendant and fills in its process group. Stat of the descendant also tells how many
+ * threads it has, so for single-threaded processes, which most are, the task directory doesn't need to be listed.
+ */
+static void append_children_of_descendant(int proc_directory_file_descriptor, int descendant_index) {
+    const pid_t process_id = process_tree_arena.descendants[descendant_index].process_id;
+    char process_id_string[16];
+    snprintf(process_id_string, sizeof(process_id_string), "%d", process_id);
+    ProcessStat process_stat;
+    if (read_process_stat(proc_directory_file_descriptor, process_id_string, &process_stat) == -1) {
+        // Process exited while we were reading its parent's children
+        return;
+    }
+    process_tree_arena.descendants[descendant_index].process_group_id = process_stat.process_group_id;
+    if (process_stat.thread_count == 1) {
+        append_children_of_thread(process_id, process_id);
+    } else {
+        for_each_thread_of_process(process_id, append_children_of_thread);
+    }
+}
+
+static ProcessInfo *get_child_processes_by_walking_children_files(int initial_parent_process_id) {
+    process_tree_arena.known_descendants = 0;
+
+    int proc_directory_file_descriptor = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (proc_directory_file_descriptor == -1) {
+        fprintf_error("Could not open /proc directory");
+        exit(1);
+    }
+    for_each_thread_of_process(initial_parent_process_id, append_children_of_thread);
+    //Iterations can be added to this loop when known_descendants is increased inside it.
+    for (int descendant_index = 0; descendant_index < process_tree_arena.known_descendants; descendant_index++) {
+        append_children_of_descendant(proc_directory_file_descriptor, descendant_index);
+    }
+    close(proc_directory_file_descriptor);
+    if (debug) {
+        fprintf(stderr, "%d descendants found for the process by walking children files\n",
+                process_tree_arena.known_descendants);
+    }
+    append_descendant(0, 0, 0);
+
+    return process_tree_arena.descendants;
+}
+
+static ProcessInfo *find_child_processes_in_proc(int initial_parent_process_id) {
+    if (children_file_is_supported()) {
+        return get_child_processes_by_walking_children_files(initial_parent_process_id);
+    }
+    return get_child_processes_by_scanning_all_processes(initial_parent_process_id);
+}
+
+/**
+ * Descendants of the root process kept up to date using fork and exit events, so that /proc doesn't need to be
+ * read every time the command is paused. Processes are stored densely and removed by moving the last one
+ * into their place, the map points from process ID to the index in processes.
+ */
+typedef struct TrackedDescendants {
+    int process_events_socket;
+    pid_t root_process_id;
+    ProcessInfo *processes;
+    size_t count;
+    size_t allocated;
+    ProcessIdMap process_index_by_process_id;
+    int needs_resynchronization;
+} TrackedDescendants;
+
+static TrackedDescendants tracked_descendants = {-1, 0, NULL, 0, 0, PROCESS_ID_MAP_INITIALIZER, 0};
+
+static void add_tracked_descendant(pid_t process_id, pid_t parent_process_id) {
+    int existing_index;
+    if (get_process_id_map_value(&tracked_descendants.process_index_by_process_id, process_id, &existing_index)) {
+        tracked_descendants.processes[existing_index].parent_process_id = parent_process_id;
+        return;
+    }
+    ensure_arena_buffer_capacity((void **) &tracked_descendants.processes, &tracked_descendants.allocated,
+                                 tracked_descendants.count + 1, sizeof(ProcessInfo));
+    tracked_descendants.processes[tracked_descendants.count].process_id = process_id;
+    tracked_descendants.processes[tracked_descendants.count].parent_process_id = parent_process_id;
+    // Process group can change after fork, so it's not known from process events.
+    tracked_descendants.processes[tracked_descendants.count].process_group_id = 0;
+    set_process_id_map_value(&tracked_descendants.process_index_by_process_id, process_id,
+                             (int) tracked_descendants.count);
+    tracked_descendants.count++;
+}
+
+static void handle_process_fork(pid_t parent_process_id, pid_t child_process_id) {
+    int parent_index;
+    if (parent_process_id == tracked_descendants.root_process_id ||
+        get_process_id_map_value(&tracked_descendants.process_index_by_process_id, parent_process_id,
+                                 &parent_index)) {
+        add_tracked_descendant(child_process_id, parent_process_id);
+    }
+}
+
+static void handle_process_exit(pid_t process_id) {
+    // Children of the exited process are reparented outside the tree, but they are still part of the command,
+    // so they are kept.
+    int process_index;
+    if (!get_process_id_map_value(&tracked_descendants.process_index_by_process_id, process_id, &process_index)) {
+        return;
+    }
+    remove_process_id_map_value(&tracked_descendants.process_index_by_process_id, process_id);
+    tracked_descendants.count--;
+    if ((size_t) process_index != tracked_descendants.count) {
+        tracked_descendants.processes[process_index] = tracked_descendants.processes[tracked_descendants.count];
+        set_process_id_map_value(&tracked_descendants.process_index_by_process_id,
+                                 tracked_descendants.processes[process_index].process_id, process_index);
+    }
+}
+
+static void synchronize_tracked_descendants_with_proc(void) {
+    tracked_descendants.count = 0;
+    clear_process_id_map(&tracked_descendants.process_index_by_process_id);
+    for (ProcessInfo *process = find_child_processes_in_proc(tracked_descendants.root_process_id);
+         process->process_id != 0; process++) {
+        add_tracked_descendant(process->process_id, process->parent_process_id);
+    }
+    tracked_descendants.needs_resynchronization = 0;
+}
+
+int start_tracking_descendants(pid_t root_process_id) {
+    tracked_descendants.process_events_socket = open_process_events_socket();
+    if (tracked_descendants.process_events_socket == -1) {
+        if (verbose) {
+            fprintf(stderr, "Process events are not available (%s), descendants will be found by reading /proc\n",
+                    strerror(errno));
+        }
+        return 0;
+    }
+    tracked_descendants.root_process_id = root_process_id;
+    // Subscribing before reading /proc makes sure that no fork is missed, events for processes that are
+    // already known are harmless.
+    synchronize_tracked_descendants_with_proc();
+    if (debug) {
+        fprintf(stderr, "Tracking descendants of PID %d using process events, %zu found initially\n",
+                root_process_id, tracked_descendants.count);
+    }
+    return 1;
+}
+
+int get_descendant_tracking_file_descriptor(void) {
+    return tracked_descendants.process_events_socket;
+}
+
+void update_tracked_descendants(void) {
+    if (tracked_descendants.process_events_socket == -1) {
+        return;
+    }
+    if (read_process_events(tracked_descendants.process_events_socket, handle_process_fork,
+                            handle_process_exit) == -1) {
+        tracked_descendants.needs_resynchronization = 1;
+    }
+}
+
+ProcessInfo *get_child_processes(int initial_parent_process_id) {
+    if (tracked_descendants.process_events_socket == -1 ||
+        initial_parent_process_id != tracked_descendants.root_process_id) {
+        return find_child_processes_in_proc(initial_parent_process_id);
+    }
+
+    update_tracked_descendants();
+    if (tracked_descendants.needs_resynchronization) {
+        if (verbose) fprintf(stderr, "Rereading descendants from /proc after losing process events\n");
+        synchronize_tracked_descendants_with_proc();
+    }
+    process_tree_arena.known_descendants = 0;
+    ensure_arena_buffer_capacity((void **) &process_tree_arena.descendants, &process_tree_arena.descendants_allocated,
+                                 tracked_descendants.count + 1, sizeof(ProcessInfo));
+    memcpy(process_tree_arena.descendants, tracked_descendants.processes,
+           tracked_descendants.count * sizeof(ProcessInfo));
+    process_tree_arena.known_descendants = (int) tracked_descendants.count;
+    if (debug) {
+        fprintf(stderr, "%d descendants known from process events\n", process_tree_arena.known_descendants);
+    }
+    append_descendant(0, 0, 0);
+
+    return process_tree_arena.descendants;
+}
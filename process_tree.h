@@ -0,0 +1,54 @@
+#ifndef RUNWHENIDLE_PROCESS_TREE_H
+#define RUNWHENIDLE_PROCESS_TREE_H
+
+#include <sys/types.h>
+
+typedef struct ProcessInfo {
+    int process_id;
+    int parent_process_id;
+    int process_group_id; // 0 if it wasn't read while finding the process
+} ProcessInfo;
+
+/**
+ * Starts keeping the list of descendants of the process up to date using fork and exit events from the netlink
+ * proc connector, so that get_child_processes() for this process doesn't need to read /proc.
+ * Requires CAP_NET_ADMIN.
+ *
+ * @return 1 if tracking has started, 0 if process events are not available.
+ */
+int start_tracking_descendants(pid_t root_process_id);
+
+/**
+ * @return File descriptor that becomes readable when there are pending process events, or -1 if not tracking.
+ *         update_tracked_descendants() should be called when it's readable to avoid overflowing the socket buffer.
+ */
+int get_descendant_tracking_file_descriptor(void);
+
+/**
+ * Applies all pending process events to the tracked descendants.
+ */
+void update_tracked_descendants(void);
+
+/**
+ * Finds all descendants of a process.
+ * If the process is tracked with start_tracking_descendants(), returns the tracked descendants, which also include
+ * processes that were orphaned when their parent exited.
+ * Otherwise walks /proc/PID/task/TID/children starting from the given process when the kernel supports it,
+ * or reads parent process ID of every process in /proc.
+ *
+ * @param initial_parent_process_id The process ID of the root of the tree.
+ * @return An array of descendants terminated by an element with process_id equal to 0.
+ *         The array is reused and is only valid until the next call.
+ */
+ProcessInfo *get_child_processes(int initial_parent_process_id);
+
+typedef void (*ThreadHandler)(pid_t process_id, pid_t thread_id);
+
+/**
+ * Calls the handler for every thread of the process listed in /proc/PID/task.
+ *
+ * @return 0 if the process doesn't exist anymore, 1 otherwise.
+ */
+int for_each_thread_of_process(pid_t process_id, ThreadHandler thread_handler);
+
+#endif //RUNWHENIDLE_PROCESS_TREE_H
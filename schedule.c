@@ -0,0 +1,204 @@
+#include "schedule.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+#include "descriptor_utils.h"
+#include "output_settings.h"
+#include "tty_utils.h"
+
+#define MAX_SCHEDULE_RULES 32
+#define MINUTES_IN_DAY (24 * 60)
+
+typedef struct ScheduleRule {
+    int start_minute_of_day;
+    int end_minute_of_day; // Window ends before this minute, can be less than the start if it crosses midnight
+    enum schedule_mode mode;
+} ScheduleRule;
+
+static const char *schedule_mode_names[] = {"IDLE", "RUN", "PAUSE"};
+
+static ScheduleRule schedule_rules[MAX_SCHEDULE_RULES];
+static size_t schedule_rule_count = 0;
+static int schedule_timer_file_descriptor = -1;
+static enum schedule_mode current_schedule_mode = SCHEDULE_MODE_IDLE;
+
+int add_schedule_rule(const char *rule) {
+    if (schedule_rule_count >= MAX_SCHEDULE_RULES) {
+        return -1;
+    }
+    int start_hours, start_minutes, end_hours, end_minutes, characters_parsed = 0;
+    if (sscanf(rule, "%d:%d-%d:%d=%n", &start_hours, &start_minutes, &end_hours, &end_minutes,
+               &characters_parsed) != 4 || characters_parsed == 0 ||
+        start_hours < 0 || start_hours > 23 || start_minutes < 0 || start_minutes > 59 ||
+        end_hours < 0 || end_hours > 24 || end_minutes < 0 || end_minutes > 59 ||
+        (end_hours == 24 && end_minutes != 0)) {
+        return -1;
+    }
+    const char *mode_name = rule + characters_parsed;
+    int mode = -1;
+    for (int i = 0; i < (int) (sizeof(schedule_mode_names) / sizeof(schedule_mode_names[0])); i++) {
+        if (strcasecmp(schedule_mode_names[i], mode_name) == 0) {
+            mode = i;
+            break;
+        }
+    }
+    if (mode == -1) {
+        return -1;
+    }
+
+    ScheduleRule *schedule_rule = &schedule_rules[schedule_rule_count++];
+    schedule_rule->start_minute_of_day = start_hours * 60 + start_minutes;
+    schedule_rule->end_minute_of_day = (end_hours * 60 + end_minutes) % MINUTES_IN_DAY;
+    schedule_rule->mode = mode;
+    return 0;
+}
+
+int load_schedule_file(const char *schedule_file_path) {
+    FILE *schedule_file = fopen(schedule_file_path, "r");
+    if (!schedule_file) {
+        fprintf_error("Failed to open schedule file %s: %s\n", schedule_file_path, strerror(errno));
+        return -1;
+    }
+    char line[256];
+    int line_number = 0;
+    while (fgets(line, sizeof(line), schedule_file)) {
+        line_number++;
+        char rule[sizeof(line)];
+        // Leading and trailing whitespace is not part of the rule
+        if (sscanf(line, " %255s", rule) != 1 || rule[0] == '#') {
+            continue;
+        }
+        if (add_schedule_rule(rule) != 0) {
+            fprintf_error("%s:%d: Invalid schedule rule \"%s\". Expected \"HH:MM-HH:MM=MODE\" with IDLE, RUN or "
+                          "PAUSE mode, at most %d rules are supported\n",
+                          schedule_file_path, line_number, rule, MAX_SCHEDULE_RULES);
+            fclose(schedule_file);
+            return -1;
+        }
+    }
+    fclose(schedule_file);
+    return 0;
+}
+
+const char *get_schedule_mode_name(enum schedule_mode mode) {
+    return schedule_mode_names[mode];
+}
+
+static int schedule_rule_includes_minute(const ScheduleRule *schedule_rule, int minute_of_day) {
+    if (schedule_rule->start_minute_of_day == schedule_rule->end_minute_of_day) {
+        return 1;
+    }
+    if (schedule_rule->start_minute_of_day < schedule_rule->end_minute_of_day) {
+        return minute_of_day >= schedule_rule->start_minute_of_day && minute_of_day < schedule_rule->end_minute_of_day;
+    }
+    return minute_of_day >= schedule_rule->start_minute_of_day || minute_of_day < schedule_rule->end_minute_of_day;
+}
+
+static enum schedule_mode get_schedule_mode_at(time_t time) {
+    struct tm local_time;
+    localtime_r(&time, &local_time);
+    const int minute_of_day = local_time.tm_hour * 60 + local_time.tm_min;
+
+    enum schedule_mode mode = SCHEDULE_MODE_IDLE;
+    for (size_t rule_index = 0; rule_index < schedule_rule_count; rule_index++) {
+        if (schedule_rule_includes_minute(&schedule_rules[rule_index], minute_of_day)) {
+            mode = schedule_rules[rule_index].mode;
+        }
+    }
+    return mode;
+}
+
+/**
+ * @return The nearest moment after the specified time when any window starts or ends.
+ */
+static time_t get_next_schedule_boundary_after(time_t time) {
+    struct tm local_time;
+    localtime_r(&time, &local_time);
+
+    time_t next_boundary = 0;
+    for (size_t rule_index = 0; rule_index < schedule_rule_count * 2; rule_index++) {
+        const ScheduleRule *schedule_rule = &schedule_rules[rule_index / 2];
+        const int boundary_minute_of_day = rule_index % 2 ? schedule_rule->end_minute_of_day
+                                                          : schedule_rule->start_minute_of_day;
+        // mktime() takes care of DST changes and normalizes the day of month
+        struct tm boundary_local_time = local_time;
+        boundary_local_time.tm_hour = boundary_minute_of_day / 60;
+        boundary_local_time.tm_min = boundary_minute_of_day % 60;
+        boundary_local_time.tm_sec = 0;
+        boundary_local_time.tm_isdst = -1;
+        time_t boundary = mktime(&boundary_local_time);
+        if (boundary <= time) {
+            boundary_local_time = local_time;
+            boundary_local_time.tm_mday++;
+            boundary_local_time.tm_hour = boundary_minute_of_day / 60;
+            boundary_local_time.tm_min = boundary_minute_of_day % 60;
+            boundary_local_time.tm_sec = 0;
+            boundary_local_time.tm_isdst = -1;
+            boundary = mktime(&boundary_local_time);
+        }
+        if (next_boundary == 0 || boundary < next_boundary) {
+            next_boundary = boundary;
+        }
+    }
+    return next_boundary;
+}
+
+enum schedule_mode get_current_schedule_mode(void) {
+    return current_schedule_mode;
+}
+
+/**
+ * @return 1 if the mode has changed, 0 otherwise.
+ */
+static int update_schedule_mode_and_arm_timer(void) {
+    // time() can lag behind the clock the timer expires on by a few milliseconds, which would land before the boundary
+    struct timespec current_timespec;
+    clock_gettime(CLOCK_REALTIME, &current_timespec);
+    const time_t current_time = current_timespec.tv_sec;
+    const enum schedule_mode previous_schedule_mode = current_schedule_mode;
+    current_schedule_mode = get_schedule_mode_at(current_time);
+
+    const time_t next_boundary = get_next_schedule_boundary_after(current_time);
+    if (debug) {
+        fprintf(stderr, "Schedule mode is %s, next time window boundary is in %llds\n",
+                get_schedule_mode_name(current_schedule_mode), (long long) (next_boundary - current_time));
+    }
+    if (arm_wall_clock_timer_file_descriptor_at(schedule_timer_file_descriptor, next_boundary) < 0) {
+        fprintf_error("Failed to arm schedule timer: %s\n", strerror(errno));
+    }
+    if (current_schedule_mode != previous_schedule_mode && !quiet) {
+        struct tm next_boundary_local_time;
+        localtime_r(&next_boundary, &next_boundary_local_time);
+        char next_boundary_string[8];
+        strftime(next_boundary_string, sizeof(next_boundary_string), "%H:%M", &next_boundary_local_time);
+        printf("Schedule: %s mode until at least %s\n", get_schedule_mode_name(current_schedule_mode),
+               next_boundary_string);
+    }
+    return current_schedule_mode != previous_schedule_mode;
+}
+
+int create_schedule_timer_file_descriptor(void) {
+    if (!schedule_rule_count) {
+        return -1;
+    }
+    if (schedule_timer_file_descriptor == -1) {
+        schedule_timer_file_descriptor = create_wall_clock_timer_file_descriptor();
+        if (schedule_timer_file_descriptor == -1) {
+            fprintf_error("Failed to create schedule timer: %s, schedule will be ignored\n", strerror(errno));
+            return -1;
+        }
+        update_schedule_mode_and_arm_timer();
+    }
+    return schedule_timer_file_descriptor;
+}
+
+int handle_schedule_timer_expiration(void) {
+    if (consume_timer_file_descriptor_checked(schedule_timer_file_descriptor, "schedule") < 0) {
+        return -1;
+    }
+    return update_schedule_mode_and_arm_timer();
+}
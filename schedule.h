@@ -0,0 +1,50 @@
+#ifndef RUNWHENIDLE_SCHEDULE_H
+#define RUNWHENIDLE_SCHEDULE_H
+
+enum schedule_mode {
+    SCHEDULE_MODE_IDLE, // Pause and resume the command depending on user activity
+    SCHEDULE_MODE_RUN, // Keep the command running regardless of user activity
+    SCHEDULE_MODE_PAUSE, // Keep the command paused regardless of user activity
+};
+
+/**
+ * Adds a time window rule in "HH:MM-HH:MM=MODE" format, where MODE is IDLE, RUN or PAUSE.
+ * Windows can cross midnight. When windows overlap, the rule added last wins.
+ *
+ * @return 0 on success, -1 if the rule is invalid.
+ */
+int add_schedule_rule(const char *rule);
+
+/**
+ * Adds rules from a file with one rule per line. Empty lines and lines starting with # are ignored.
+ * Prints an error for the first invalid line.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+int load_schedule_file(const char *schedule_file_path);
+
+/**
+ * @return Name of the mode as used in schedule rules.
+ */
+const char *get_schedule_mode_name(enum schedule_mode mode);
+
+/**
+ * @return Mode of the time window the current time is in, SCHEDULE_MODE_IDLE if it's not in any or there are no rules.
+ */
+enum schedule_mode get_current_schedule_mode(void);
+
+/**
+ * Creates the timer that expires at the next time window boundary.
+ *
+ * @return Timer file descriptor, or -1 if there are no rules or the timer could not be created.
+ */
+int create_schedule_timer_file_descriptor(void);
+
+/**
+ * Updates the current mode and arms the timer for the next boundary. Should be called when the timer expires.
+ *
+ * @return 1 if the mode has changed, 0 if not, -1 if reading the timer failed.
+ */
+int handle_schedule_timer_expiration(void);
+
+#endif //RUNWHENIDLE_SCHEDULE_H
@@ -0,0 +1,361 @@
+#define _GNU_SOURCE
+
+#include "scripted_idle.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "arguments_parsing.h"
+#include "descriptor_utils.h"
+#include "idle_time_tracking.h"
+#include "output_settings.h"
+#include "tty_utils.h"
+
+#define MAX_SCRIPTED_IDLE_CONNECTIONS 16
+#define MAX_SCRIPTED_IDLE_LINE_LENGTH 64
+// Values of epoll_event.data for descriptors other than connections, which use their index
+#define LISTENING_SOCKET_EVENT_DATA UINT32_MAX
+#define IDLE_TIME_TIMER_EVENT_DATA (UINT32_MAX - 1)
+
+typedef struct ScriptedIdleConnection {
+    int file_descriptor; // -1 if the slot is free
+    char line[MAX_SCRIPTED_IDLE_LINE_LENGTH];
+    size_t line_length;
+    int line_is_too_long; // The rest of the line is skipped
+} ScriptedIdleConnection;
+
+static const char *scripted_idle_source_path = NULL;
+static int scripted_idle_epoll_file_descriptor = -1; // Waits for the FIFO or the socket, connections and idle time
+static int listening_socket_file_descriptor = -1;
+static int idle_time_timer_file_descriptor = -1;
+static ScriptedIdleConnection scripted_idle_connections[MAX_SCRIPTED_IDLE_CONNECTIONS]; // FIFO is the first one
+
+void set_scripted_idle_source_path(const char *path) {
+    scripted_idle_source_path = path;
+}
+
+/**
+ * @return 1 if the line has changed idle time, 0 if it's empty or invalid.
+ */
+static int handle_scripted_idle_line(const char *line) {
+    char command[16];
+    int command_length = 0;
+    if (sscanf(line, " %15s%n", command, &command_length) != 1 || command[0] == '#') {
+        return 0;
+    }
+    const char *argument = line + command_length;
+    while (isspace((unsigned char) *argument)) {
+        argument++;
+    }
+    long unsigned user_idle_time_ms;
+    if (strcmp(command, "active") == 0 && *argument == '\0') {
+        user_idle_time_ms = 0;
+    } else if (strcmp(command, "idle") == 0 && *argument == '\0') {
+        user_idle_time_ms = user_idle_timeout_ms;
+    } else if (strcmp(command, "idle") == 0 && isdigit((unsigned char) *argument)) {
+        char *strtoul_endptr;
+        errno = 0;
+        user_idle_time_ms = strtoul(argument, &strtoul_endptr, 10);
+        while (isspace((unsigned char) *strtoul_endptr)) {
+            strtoul_endptr++;
+        }
+        if (errno != 0 || *strtoul_endptr != '\0') {
+            fprintf_error("Invalid idle time in idle source line \"%s\"\n", line);
+            return 0;
+        }
+    } else {
+        fprintf_error("Unknown idle source line \"%s\". Expected \"active\", \"idle\" or \"idle <ms>\"\n", line);
+        return 0;
+    }
+    if (debug) fprintf(stderr, "Idle source: user has been idle for %lums\n", user_idle_time_ms);
+    set_tracked_user_idle_time(user_idle_time_ms);
+    return 1;
+}
+
+/**
+ * Handles all complete lines that can be read without blocking.
+ *
+ * @return 0 if the connection is still open, -1 if it was closed or reading from it failed.
+ */
+static int read_scripted_idle_connection(ScriptedIdleConnection *connection, int *user_idle_time_has_changed) {
+    char buffer[512];
+    ssize_t bytes_read;
+    while ((bytes_read = read(connection->file_descriptor, buffer, sizeof(buffer))) > 0) {
+        for (ssize_t byte_index = 0; byte_index < bytes_read; byte_index++) {
+            if (buffer[byte_index] != '\n') {
+                if (connection->line_length < MAX_SCRIPTED_IDLE_LINE_LENGTH - 1) {
+                    connection->line[connection->line_length++] = buffer[byte_index];
+                } else {
+                    connection->line_is_too_long = 1;
+                }
+                continue;
+            }
+            connection->line[connection->line_length] = '\0';
+            if (connection->line_is_too_long) {
+                fprintf_error("Idle source line \"%s...\" is too long, ignoring it\n", connection->line);
+            } else if (handle_scripted_idle_line(connection->line)) {
+                *user_idle_time_has_changed = 1;
+            }
+            connection->line_length = 0;
+            connection->line_is_too_long = 0;
+        }
+    }
+    if (bytes_read == 0) {
+        return -1;
+    }
+    if (errno == EAGAIN || errno == EINTR) {
+        return 0;
+    }
+    const int saved_errno = errno;
+    fprintf_error("Failed to read from idle source %s: %s\n", scripted_idle_source_path, strerror(saved_errno));
+    return -1;
+}
+
+static void close_scripted_idle_connection(ScriptedIdleConnection *connection) {
+    epoll_ctl(scripted_idle_epoll_file_descriptor, EPOLL_CTL_DEL, connection->file_descriptor, NULL);
+    close_file_descriptor_if_open(&connection->file_descriptor, "idle source connection");
+    connection->line_length = 0;
+    connection->line_is_too_long = 0;
+}
+
+static int add_to_scripted_idle_epoll(int file_descriptor, uint32_t data) {
+    struct epoll_event event = {.events = EPOLLIN, .data.u32 = data};
+    if (epoll_ctl(scripted_idle_epoll_file_descriptor, EPOLL_CTL_ADD, file_descriptor, &event) != 0) {
+        const int saved_errno = errno;
+        fprintf_error("Failed to wait for idle source file descriptor %d: %s\n", file_descriptor,
+                      strerror(saved_errno));
+        return -1;
+    }
+    return 0;
+}
+
+static void accept_scripted_idle_connections(void) {
+    int connection_file_descriptor;
+    while ((connection_file_descriptor = accept4(listening_socket_file_descriptor, NULL, NULL,
+                                                 SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        uint32_t connection_index = 0;
+        while (connection_index < MAX_SCRIPTED_IDLE_CONNECTIONS &&
+               scripted_idle_connections[connection_index].file_descriptor != -1) {
+            connection_index++;
+        }
+        if (connection_index == MAX_SCRIPTED_IDLE_CONNECTIONS) {
+            fprintf_error("Too many connections to idle source %s, closing the new one\n", scripted_idle_source_path);
+            close(connection_file_descriptor);
+            continue;
+        }
+        if (add_to_scripted_idle_epoll(connection_file_descriptor, connection_index) < 0) {
+            close(connection_file_descriptor);
+            continue;
+        }
+        scripted_idle_connections[connection_index].file_descriptor = connection_file_descriptor;
+        if (debug) fprintf(stderr, "Idle source: accepted connection %u\n", connection_index);
+    }
+}
+
+static void remove_listening_socket_file(void) {
+    if (listening_socket_file_descriptor != -1) {
+        unlink(scripted_idle_source_path);
+    }
+}
+
+static void teardown_scripted_idle_source(void) {
+    for (size_t connection_index = 0; connection_index < MAX_SCRIPTED_IDLE_CONNECTIONS; connection_index++) {
+        if (scripted_idle_connections[connection_index].file_descriptor != -1) {
+            close_scripted_idle_connection(&scripted_idle_connections[connection_index]);
+        }
+    }
+    remove_listening_socket_file();
+    close_file_descriptor_if_open(&listening_socket_file_descriptor, "idle source socket");
+    close_file_descriptor_if_open(&scripted_idle_epoll_file_descriptor, "idle source epoll");
+    stop_tracking_user_idle_time();
+    idle_time_timer_file_descriptor = -1;
+}
+
+/**
+ * Creates the epoll set and starts tracking idle time. Every connection slot is free afterwards.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int start_scripted_idle_source(void) {
+    for (size_t connection_index = 0; connection_index < MAX_SCRIPTED_IDLE_CONNECTIONS; connection_index++) {
+        scripted_idle_connections[connection_index].file_descriptor = -1;
+        scripted_idle_connections[connection_index].line_length = 0;
+        scripted_idle_connections[connection_index].line_is_too_long = 0;
+    }
+    scripted_idle_epoll_file_descriptor = epoll_create1(EPOLL_CLOEXEC);
+    if (scripted_idle_epoll_file_descriptor == -1) {
+        fprintf_error("Failed to create epoll file descriptor for idle source: %s\n", strerror(errno));
+        return -1;
+    }
+    idle_time_timer_file_descriptor = start_tracking_user_idle_time();
+    if (idle_time_timer_file_descriptor == -1 ||
+        add_to_scripted_idle_epoll(idle_time_timer_file_descriptor, IDLE_TIME_TIMER_EVENT_DATA) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static int init_fifo_idle_source(void) {
+    if (start_scripted_idle_source() < 0) {
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    if (mkfifo(scripted_idle_source_path, 0600) != 0 && errno != EEXIST) {
+        fprintf_error("Failed to create FIFO %s: %s\n", scripted_idle_source_path, strerror(errno));
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    // Being a writer too keeps reads from returning end of file every time the last writer closes the FIFO.
+    const int fifo_file_descriptor = open(scripted_idle_source_path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fifo_file_descriptor == -1) {
+        fprintf_error("Failed to open FIFO %s: %s\n", scripted_idle_source_path, strerror(errno));
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    scripted_idle_connections[0].file_descriptor = fifo_file_descriptor;
+    struct stat fifo_stat;
+    if (fstat(fifo_file_descriptor, &fifo_stat) != 0 || !S_ISFIFO(fifo_stat.st_mode)) {
+        fprintf_error("%s is not a FIFO\n", scripted_idle_source_path);
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    if (add_to_scripted_idle_epoll(fifo_file_descriptor, 0) < 0) {
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    if (verbose) fprintf(stderr, "Reading user activity from FIFO %s\n", scripted_idle_source_path);
+    return 1;
+}
+
+/**
+ * @return 1 if something is listening on the socket, 0 if it was left behind by a process that has exited.
+ */
+static int socket_is_in_use(const struct sockaddr_un *address) {
+    const int probe_file_descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe_file_descriptor == -1) {
+        return 1;
+    }
+    const int connect_result = connect(probe_file_descriptor, (const struct sockaddr *) address, sizeof(*address));
+    const int connect_errno = errno;
+    close(probe_file_descriptor);
+    return connect_result == 0 || connect_errno != ECONNREFUSED;
+}
+
+static int init_socket_idle_source(void) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(scripted_idle_source_path) >= sizeof(address.sun_path)) {
+        fprintf_error("Socket path %s is too long\n", scripted_idle_source_path);
+        return 0;
+    }
+    strcpy(address.sun_path, scripted_idle_source_path);
+    if (start_scripted_idle_source() < 0) {
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    const int socket_file_descriptor = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (socket_file_descriptor == -1) {
+        fprintf_error("Failed to create socket: %s\n", strerror(errno));
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    int bind_result = bind(socket_file_descriptor, (const struct sockaddr *) &address, sizeof(address));
+    const int address_is_in_use = bind_result != 0 && errno == EADDRINUSE;
+    struct stat existing_file_stat;
+    if (address_is_in_use && lstat(scripted_idle_source_path, &existing_file_stat) == 0 &&
+        !S_ISSOCK(existing_file_stat.st_mode)) {
+        // connect() fails with ECONNREFUSED for files that are not sockets too, so they must not be removed.
+        fprintf_error("%s already exists and is not a socket\n", scripted_idle_source_path);
+        close(socket_file_descriptor);
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    if (address_is_in_use && !socket_is_in_use(&address)) {
+        unlink(scripted_idle_source_path);
+        bind_result = bind(socket_file_descriptor, (const struct sockaddr *) &address, sizeof(address));
+    }
+    if (bind_result != 0 || listen(socket_file_descriptor, MAX_SCRIPTED_IDLE_CONNECTIONS) != 0) {
+        fprintf_error("Failed to listen on socket %s: %s\n", scripted_idle_source_path, strerror(errno));
+        close(socket_file_descriptor);
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    // From now on the socket file is removed by teardown, or on exit once the command finishes.
+    listening_socket_file_descriptor = socket_file_descriptor;
+    atexit(remove_listening_socket_file);
+    if (add_to_scripted_idle_epoll(listening_socket_file_descriptor, LISTENING_SOCKET_EVENT_DATA) < 0) {
+        teardown_scripted_idle_source();
+        return 0;
+    }
+    if (verbose) fprintf(stderr, "Reading user activity from socket %s\n", scripted_idle_source_path);
+    return 1;
+}
+
+static int get_scripted_idle_source_file_descriptor(void) {
+    return scripted_idle_epoll_file_descriptor;
+}
+
+static int handle_scripted_idle_source_events(uint32_t events) {
+    (void)events;
+    struct epoll_event ready_events[MAX_SCRIPTED_IDLE_CONNECTIONS + 2];
+    const int ready_event_count = epoll_wait(scripted_idle_epoll_file_descriptor, ready_events,
+                                             MAX_SCRIPTED_IDLE_CONNECTIONS + 2, 0);
+    if (ready_event_count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    int user_idle_time_has_changed = 0;
+    for (int event_index = 0; event_index < ready_event_count; event_index++) {
+        const uint32_t data = ready_events[event_index].data.u32;
+        if (data == LISTENING_SOCKET_EVENT_DATA) {
+            accept_scripted_idle_connections();
+        } else if (data == IDLE_TIME_TIMER_EVENT_DATA) {
+            if (handle_tracked_user_idle_time_timer_expiration() < 0) {
+                return -1;
+            }
+            user_idle_time_has_changed = 1;
+        } else if (read_scripted_idle_connection(&scripted_idle_connections[data], &user_idle_time_has_changed) < 0) {
+            if (listening_socket_file_descriptor == -1) {
+                // FIFO is opened for writing too, so it can't be closed by the other side.
+                return -1;
+            }
+            if (debug) fprintf(stderr, "Idle source: connection %u closed\n", data);
+            close_scripted_idle_connection(&scripted_idle_connections[data]);
+        }
+    }
+    return user_idle_time_has_changed;
+}
+
+static int prepare_scripted_idle_source_to_wait(long unsigned wake_up_at_idle_time_ms,
+                                                long unsigned user_idle_time_ms) {
+    // Every line wakes up, they are not expected to be written often.
+    (void)user_idle_time_ms;
+    return wake_up_at_tracked_user_idle_time(wake_up_at_idle_time_ms);
+}
+
+const IdleSource fifo_idle_source = {
+        .name = "FIFO",
+        .init = init_fifo_idle_source,
+        .get_file_descriptor = get_scripted_idle_source_file_descriptor,
+        .on_readable = handle_scripted_idle_source_events,
+        .query_idle_time_ms = get_tracked_user_idle_time_ms,
+        .prepare_to_wait = prepare_scripted_idle_source_to_wait,
+        .teardown = teardown_scripted_idle_source,
+};
+
+const IdleSource socket_idle_source = {
+        .name = "socket",
+        .init = init_socket_idle_source,
+        .get_file_descriptor = get_scripted_idle_source_file_descriptor,
+        .on_readable = handle_scripted_idle_source_events,
+        .query_idle_time_ms = get_tracked_user_idle_time_ms,
+        .prepare_to_wait = prepare_scripted_idle_source_to_wait,
+        .teardown = teardown_scripted_idle_source,
+};
@@ -0,0 +1,25 @@
+#ifndef RUNWHENIDLE_SCRIPTED_IDLE_H
+#define RUNWHENIDLE_SCRIPTED_IDLE_H
+
+#include "idle_sources.h"
+
+/**
+ * Read user activity from lines written to a FIFO, which is created if it doesn't exist. Lines are:
+ *   active      - the user has just been active,
+ *   idle        - the user has been idle for --timeout,
+ *   idle <ms>   - the user has been idle for the specified time.
+ * Idle time keeps increasing from the last line received, starting from 0 when runwhenidle starts.
+ */
+extern const IdleSource fifo_idle_source;
+
+/**
+ * Same as fifo_idle_source, but reads lines from up to 16 connections at a time to a unix stream socket it listens on.
+ */
+extern const IdleSource socket_idle_source;
+
+/**
+ * Sets the path of the FIFO or the socket.
+ */
+void set_scripted_idle_source_path(const char *path);
+
+#endif //RUNWHENIDLE_SCRIPTED_IDLE_H
@@ -0,0 +1,174 @@
+#define _GNU_SOURCE
+
+#include "thread_affinity.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output_settings.h"
+#include "process_id_map.h"
+#include "process_tree.h"
+#include "tty_utils.h"
+
+typedef struct RestrictedThread {
+    pid_t thread_id;
+    cpu_set_t original_cpu_set;
+} RestrictedThread;
+
+static cpu_set_t reserved_cpu_set;
+static int reserved_cpu_set_is_initialized = 0;
+
+static RestrictedThread *restricted_threads = NULL;
+static size_t restricted_threads_count = 0;
+static size_t restricted_threads_allocated = 0;
+static ProcessIdMap restricted_thread_index_by_thread_id = PROCESS_ID_MAP_INITIALIZER;
+static cpu_set_t root_original_cpu_set;
+static size_t threads_restricted_by_current_call;
+
+int set_reserved_cpus_from_list(const char *cpu_list) {
+    CPU_ZERO(&reserved_cpu_set);
+    const char *position = cpu_list;
+    while (*position != '\0') {
+        char *range_end;
+        errno = 0;
+        long first_cpu = strtol(position, &range_end, 10);
+        if (range_end == position || errno != 0 || first_cpu < 0 || first_cpu >= CPU_SETSIZE) {
+            return -1;
+        }
+        long last_cpu = first_cpu;
+        if (*range_end == '-') {
+            position = range_end + 1;
+            last_cpu = strtol(position, &range_end, 10);
+            if (range_end == position || errno != 0 || last_cpu < first_cpu || last_cpu >= CPU_SETSIZE) {
+                return -1;
+            }
+        }
+        for (long cpu = first_cpu; cpu <= last_cpu; cpu++) {
+            CPU_SET(cpu, &reserved_cpu_set);
+        }
+        if (*range_end == ',') {
+            range_end++;
+            if (*range_end == '\0') {
+                return -1;
+            }
+        } else if (*range_end != '\0') {
+            return -1;
+        }
+        position = range_end;
+    }
+    if (CPU_COUNT(&reserved_cpu_set) == 0) {
+        return -1;
+    }
+    reserved_cpu_set_is_initialized = 1;
+    return 0;
+}
+
+/**
+ * Without --reserved-cpus the command is restricted to the first CPU runwhenidle is allowed to run on.
+ */
+static void initialize_default_reserved_cpu_set(void) {
+    cpu_set_t own_cpu_set;
+    CPU_ZERO(&reserved_cpu_set);
+    if (sched_getaffinity(0, sizeof(own_cpu_set), &own_cpu_set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &own_cpu_set)) {
+                CPU_SET(cpu, &reserved_cpu_set);
+                break;
+            }
+        }
+    }
+    if (CPU_COUNT(&reserved_cpu_set) == 0) {
+        CPU_SET(0, &reserved_cpu_set);
+    }
+    reserved_cpu_set_is_initialized = 1;
+}
+
+static void ensure_restricted_threads_capacity(void) {
+    if (restricted_threads_count < restricted_threads_allocated) {
+        return;
+    }
+    size_t new_allocated = restricted_threads_allocated ? restricted_threads_allocated * 2 : 64;
+    RestrictedThread *new_restricted_threads = realloc(restricted_threads, new_allocated * sizeof(RestrictedThread));
+    if (!new_restricted_threads) {
+        perror("Failed to allocate memory for thread list");
+        exit(1);
+    }
+    restricted_threads = new_restricted_threads;
+    restricted_threads_allocated = new_allocated;
+}
+
+static void restrict_thread_to_reserved_cpus(pid_t process_id, pid_t thread_id) {
+    int restricted_thread_index;
+    if (get_process_id_map_value(&restricted_thread_index_by_thread_id, thread_id, &restricted_thread_index)) {
+        return;
+    }
+
+    cpu_set_t original_cpu_set;
+    if (sched_getaffinity(thread_id, sizeof(original_cpu_set), &original_cpu_set) != 0) {
+        if (errno != ESRCH) {
+            fprintf_error("Failed to get CPU affinity of thread %i of PID %i: %s\n", thread_id, process_id,
+                          strerror(errno));
+        }
+        return;
+    }
+    if (restricted_threads_count == 0) {
+        root_original_cpu_set = original_cpu_set;
+    } else if (CPU_EQUAL(&original_cpu_set, &reserved_cpu_set)) {
+        original_cpu_set = root_original_cpu_set;
+    }
+
+    if (sched_setaffinity(thread_id, sizeof(reserved_cpu_set), &reserved_cpu_set) != 0) {
+        if (errno != ESRCH) {
+            fprintf_error("Failed to set CPU affinity of thread %i of PID %i: %s\n", thread_id, process_id,
+                          strerror(errno));
+        }
+        return;
+    }
+
+    ensure_restricted_threads_capacity();
+    restricted_threads[restricted_threads_count].thread_id = thread_id;
+    restricted_threads[restricted_threads_count].original_cpu_set = original_cpu_set;
+    set_process_id_map_value(&restricted_thread_index_by_thread_id, thread_id, (int) restricted_threads_count);
+    restricted_threads_count++;
+    threads_restricted_by_current_call++;
+}
+
+size_t restrict_threads_of_process_to_reserved_cpus(pid_t process_id) {
+    if (!reserved_cpu_set_is_initialized) {
+        initialize_default_reserved_cpu_set();
+    }
+    threads_restricted_by_current_call = 0;
+    for_each_thread_of_process(process_id, restrict_thread_to_reserved_cpus);
+    if (debug && threads_restricted_by_current_call) {
+        fprintf(stderr, "Restricted %zu threads of PID %i to reserved CPUs\n", threads_restricted_by_current_call,
+                process_id);
+    }
+    return threads_restricted_by_current_call;
+}
+
+void restore_cpu_affinity_of_restricted_threads(void) {
+    size_t restored_threads_count = 0;
+    for (size_t restricted_thread_index = 0; restricted_thread_index < restricted_threads_count;
+         restricted_thread_index++) {
+        const RestrictedThread *restricted_thread = &restricted_threads[restricted_thread_index];
+        if (sched_setaffinity(restricted_thread->thread_id, sizeof(restricted_thread->original_cpu_set),
+                              &restricted_thread->original_cpu_set) != 0) {
+            // The thread has exited, or CPUs it was allowed to run on went offline.
+            if (debug) {
+                fprintf(stderr, "Failed to restore CPU affinity of thread %i: %s\n", restricted_thread->thread_id,
+                        strerror(errno));
+            }
+            continue;
+        }
+        restored_threads_count++;
+    }
+    if (debug) {
+        fprintf(stderr, "Restored CPU affinity of %zu out of %zu threads\n", restored_threads_count,
+                restricted_threads_count);
+    }
+    restricted_threads_count = 0;
+    clear_process_id_map(&restricted_thread_index_by_thread_id);
+}
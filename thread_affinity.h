@@ -0,0 +1,28 @@
+#ifndef RUNWHENIDLE_THREAD_AFFINITY_H
+#define RUNWHENIDLE_THREAD_AFFINITY_H
+
+#include <sys/types.h>
+
+/**
+ * Sets CPUs the command is restricted to while the user is active.
+ *
+ * @param cpu_list List of CPUs in the same format as in /sys/devices/system/cpu/online, e.g. "0-1,4".
+ * @return 0 on success, -1 if the list is invalid.
+ */
+int set_reserved_cpus_from_list(const char *cpu_list);
+
+/**
+ * Saves CPU affinity of every thread of the process that isn't restricted yet and restricts it to the reserved CPUs.
+ * Threads that already only run on the reserved CPUs are assumed to have inherited that from a restricted parent
+ * and get the original affinity of the first process restricted since the last restore.
+ *
+ * @return Number of threads that were restricted by this call.
+ */
+size_t restrict_threads_of_process_to_reserved_cpus(pid_t process_id);
+
+/**
+ * Restores CPU affinity of all threads restricted since the last call.
+ */
+void restore_cpu_affinity_of_restricted_threads(void);
+
+#endif //RUNWHENIDLE_THREAD_AFFINITY_H
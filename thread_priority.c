@@ -0,0 +1,265 @@
+#define _GNU_SOURCE
+
+#include "thread_priority.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/capability.h>
+
+#include "output_settings.h"
+#include "process_id_map.h"
+#include "process_tree.h"
+#include "tty_utils.h"
+
+// From linux/ioprio.h, which is not available with older kernel headers.
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_OF(ioprio) ((ioprio) >> IOPRIO_CLASS_SHIFT)
+
+static const int DEMOTED_NICE_VALUE = 19;
+
+typedef struct DemotedThread {
+    pid_t thread_id;
+    int scheduling_policy;
+    struct sched_param scheduling_parameters;
+    int nice_value;
+    int io_priority;
+} DemotedThread;
+
+static DemotedThread *demoted_threads = NULL;
+static size_t demoted_threads_count = 0;
+static size_t demoted_threads_allocated = 0;
+static ProcessIdMap demoted_thread_index_by_thread_id = PROCESS_ID_MAP_INITIALIZER;
+static DemotedThread root_original_priority;
+static int current_demotions;
+static size_t threads_demoted_by_current_call;
+
+static int get_thread_io_priority(pid_t thread_id) {
+    return (int) syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, thread_id);
+}
+
+static int set_thread_io_priority(pid_t thread_id, int io_priority) {
+    return (int) syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, thread_id, io_priority);
+}
+
+static int read_thread_priority(pid_t thread_id, DemotedThread *out_priority) {
+    out_priority->thread_id = thread_id;
+    out_priority->scheduling_policy = sched_getscheduler(thread_id);
+    if (out_priority->scheduling_policy == -1 ||
+        sched_getparam(thread_id, &out_priority->scheduling_parameters) == -1) {
+        return -1;
+    }
+    // -1 is a valid nice value, so errno is the only way to detect failure
+    errno = 0;
+    out_priority->nice_value = getpriority(PRIO_PROCESS, thread_id);
+    if (out_priority->nice_value == -1 && errno != 0) {
+        return -1;
+    }
+    out_priority->io_priority = get_thread_io_priority(thread_id);
+    if (out_priority->io_priority == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @return 1 if every requested demotion is already applied to the thread.
+ */
+static int thread_priority_is_demoted(const DemotedThread *priority) {
+    if ((current_demotions & DEMOTE_CPU_TO_SCHED_IDLE) &&
+        (priority->scheduling_policy & ~SCHED_RESET_ON_FORK) != SCHED_IDLE) {
+        return 0;
+    }
+    if ((current_demotions & DEMOTE_CPU_TO_NICE_19) && priority->nice_value != DEMOTED_NICE_VALUE) {
+        return 0;
+    }
+    if ((current_demotions & DEMOTE_IO_TO_IDLE_CLASS) && IOPRIO_CLASS_OF(priority->io_priority) != IOPRIO_CLASS_IDLE) {
+        return 0;
+    }
+    return 1;
+}
+
+static int apply_demotions_to_thread(pid_t thread_id) {
+    if (current_demotions & DEMOTE_CPU_TO_SCHED_IDLE) {
+        struct sched_param scheduling_parameters = {.sched_priority = 0};
+        if (sched_setscheduler(thread_id, SCHED_IDLE, &scheduling_parameters) == -1) {
+            return -1;
+        }
+    }
+    if ((current_demotions & DEMOTE_CPU_TO_NICE_19) &&
+        setpriority(PRIO_PROCESS, thread_id, DEMOTED_NICE_VALUE) == -1) {
+        return -1;
+    }
+    if ((current_demotions & DEMOTE_IO_TO_IDLE_CLASS) &&
+        set_thread_io_priority(thread_id, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+static int restore_thread_priority(const DemotedThread *original_priority) {
+    pid_t thread_id = original_priority->thread_id;
+    if ((current_demotions & DEMOTE_IO_TO_IDLE_CLASS) &&
+        set_thread_io_priority(thread_id, original_priority->io_priority) == -1) {
+        return -1;
+    }
+    if ((current_demotions & DEMOTE_CPU_TO_NICE_19) &&
+        setpriority(PRIO_PROCESS, thread_id, original_priority->nice_value) == -1) {
+        return -1;
+    }
+    if ((current_demotions & DEMOTE_CPU_TO_SCHED_IDLE) &&
+        sched_setscheduler(thread_id, original_priority->scheduling_policy,
+                           &original_priority->scheduling_parameters) == -1) {
+        return -1;
+    }
+    return 0;
+}
+
+static void ensure_demoted_threads_capacity(void) {
+    if (demoted_threads_count < demoted_threads_allocated) {
+        return;
+    }
+    size_t new_allocated = demoted_threads_allocated ? demoted_threads_allocated * 2 : 64;
+    DemotedThread *new_demoted_threads = realloc(demoted_threads, new_allocated * sizeof(DemotedThread));
+    if (!new_demoted_threads) {
+        perror("Failed to allocate memory for thread list");
+        exit(1);
+    }
+    demoted_threads = new_demoted_threads;
+    demoted_threads_allocated = new_allocated;
+}
+
+/**
+ * Unprivileged processes can lower priority of their threads, but raising it back is limited by RLIMIT_NICE.
+ */
+static void warn_if_priority_can_not_be_restored(const DemotedThread *original_priority) {
+    static int warning_printed = 0;
+    if (warning_printed || quiet || !(current_demotions & (DEMOTE_CPU_TO_SCHED_IDLE | DEMOTE_CPU_TO_NICE_19))) {
+        return;
+    }
+    struct rlimit nice_limit;
+    if (geteuid() == 0 || getrlimit(RLIMIT_NICE, &nice_limit) != 0 || nice_limit.rlim_cur == RLIM_INFINITY) {
+        return;
+    }
+    // RLIMIT_NICE is specified as 20 - nice, so that it's never negative
+    int lowest_allowed_nice_value = 20 - (int) nice_limit.rlim_cur;
+    if (original_priority->nice_value >= lowest_allowed_nice_value) {
+        return;
+    }
+    fprintf_error("Nice value of PID %i is %i, but RLIMIT_NICE only allows raising priority up to nice %i, "
+                  "so its priority might not be restored without CAP_SYS_NICE\n",
+                  original_priority->thread_id, original_priority->nice_value, lowest_allowed_nice_value);
+    warning_printed = 1;
+}
+
+static void demote_thread(pid_t process_id, pid_t thread_id) {
+    int demoted_thread_index;
+    if (get_process_id_map_value(&demoted_thread_index_by_thread_id, thread_id, &demoted_thread_index)) {
+        return;
+    }
+
+    DemotedThread original_priority;
+    if (read_thread_priority(thread_id, &original_priority) == -1) {
+        if (errno != ESRCH) {
+            fprintf_error("Failed to get priority of thread %i of PID %i: %s\n", thread_id, process_id,
+                          strerror(errno));
+        }
+        return;
+    }
+    if (demoted_threads_count == 0) {
+        root_original_priority = original_priority;
+    } else if (thread_priority_is_demoted(&original_priority)) {
+        original_priority = root_original_priority;
+        original_priority.thread_id = thread_id;
+    }
+    warn_if_priority_can_not_be_restored(&original_priority);
+
+    if (apply_demotions_to_thread(thread_id) == -1) {
+        if (errno != ESRCH) {
+            fprintf_error("Failed to lower priority of thread %i of PID %i: %s\n", thread_id, process_id,
+                          strerror(errno));
+        }
+        // Some of the demotions could have been applied already
+        restore_thread_priority(&original_priority);
+        return;
+    }
+
+    ensure_demoted_threads_capacity();
+    demoted_threads[demoted_threads_count] = original_priority;
+    set_process_id_map_value(&demoted_thread_index_by_thread_id, thread_id, (int) demoted_threads_count);
+    demoted_threads_count++;
+    threads_demoted_by_current_call++;
+}
+
+size_t demote_threads_of_process(pid_t process_id, int demotions) {
+    current_demotions = demotions;
+    threads_demoted_by_current_call = 0;
+    for_each_thread_of_process(process_id, demote_thread);
+    if (debug && threads_demoted_by_current_call) {
+        fprintf(stderr, "Lowered priority of %zu threads of PID %i\n", threads_demoted_by_current_call, process_id);
+    }
+    return threads_demoted_by_current_call;
+}
+
+void restore_priority_of_demoted_threads(void) {
+    size_t restored_threads_count = 0;
+    int permission_error_printed = 0;
+    for (size_t demoted_thread_index = 0; demoted_thread_index < demoted_threads_count; demoted_thread_index++) {
+        const DemotedThread *demoted_thread = &demoted_threads[demoted_thread_index];
+        if (restore_thread_priority(demoted_thread) == -1) {
+            // Raising nice value above RLIMIT_NICE fails with EACCES, leaving SCHED_IDLE fails with EPERM
+            if ((errno == EPERM || errno == EACCES) && !permission_error_printed) {
+                fprintf_error("Not permitted to restore priority of thread %i, raising priority requires "
+                              "CAP_SYS_NICE or a high enough RLIMIT_NICE\n", demoted_thread->thread_id);
+                permission_error_printed = 1;
+            } else if (debug) {
+                fprintf(stderr, "Failed to restore priority of thread %i: %s\n", demoted_thread->thread_id,
+                        strerror(errno));
+            }
+            continue;
+        }
+        restored_threads_count++;
+    }
+    if (debug) {
+        fprintf(stderr, "Restored priority of %zu out of %zu threads\n", restored_threads_count,
+                demoted_threads_count);
+    }
+    demoted_threads_count = 0;
+    clear_process_id_map(&demoted_thread_index_by_thread_id);
+}
+
+static int has_cap_sys_nice(void) {
+    struct __user_cap_header_struct capability_header = {.version = _LINUX_CAPABILITY_VERSION_3, .pid = 0};
+    struct __user_cap_data_struct capability_data[_LINUX_CAPABILITY_U32S_3];
+    if (syscall(SYS_capget, &capability_header, capability_data) != 0) {
+        return 0;
+    }
+    return (capability_data[CAP_TO_INDEX(CAP_SYS_NICE)].effective & CAP_TO_MASK(CAP_SYS_NICE)) != 0;
+}
+
+int lowered_cpu_priority_of_process_can_be_restored(pid_t process_id) {
+    if (has_cap_sys_nice()) {
+        return 1;
+    }
+    struct rlimit nice_limit;
+    if (getrlimit(RLIMIT_NICE, &nice_limit) != 0) {
+        return 0;
+    }
+    if (nice_limit.rlim_cur == RLIM_INFINITY) {
+        return 1;
+    }
+    errno = 0;
+    const int nice_value = getpriority(PRIO_PROCESS, process_id);
+    if (nice_value == -1 && errno != 0) {
+        return 0;
+    }
+    // RLIMIT_NICE is specified as 20 - nice, so that it's never negative
+    return 20 - nice_value <= (int) nice_limit.rlim_cur;
+}
@@ -0,0 +1,37 @@
+#ifndef RUNWHENIDLE_THREAD_PRIORITY_H
+#define RUNWHENIDLE_THREAD_PRIORITY_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+enum thread_priority_demotion {
+    DEMOTE_CPU_TO_SCHED_IDLE = 1,
+    DEMOTE_CPU_TO_NICE_19 = 2,
+    DEMOTE_IO_TO_IDLE_CLASS = 4,
+};
+
+/**
+ * Saves scheduling policy, nice value and I/O priority of every thread of the process that isn't demoted yet
+ * and lowers them.
+ * Threads that already have the demoted priority are assumed to have inherited it from a demoted parent
+ * and get the original priority of the first process demoted since the last restore.
+ *
+ * @param demotions Combination of thread_priority_demotion flags.
+ * @return Number of threads that were demoted by this call.
+ */
+size_t demote_threads_of_process(pid_t process_id, int demotions);
+
+/**
+ * Restores priority of all threads demoted since the last call.
+ */
+void restore_priority_of_demoted_threads(void);
+
+/**
+ * Lowering CPU priority is always allowed, but raising it back from nice 19 or SCHED_IDLE requires CAP_SYS_NICE
+ * or RLIMIT_NICE of at least 20 minus the original nice value, which is 0 by default.
+ *
+ * @return 1 if CPU priority of the process could be restored after lowering it, 0 if not.
+ */
+int lowered_cpu_priority_of_process_can_be_restored(pid_t process_id);
+
+#endif //RUNWHENIDLE_THREAD_PRIORITY_H
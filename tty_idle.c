@@ -0,0 +1,341 @@
+#include "tty_idle.h"
+
+#include <errno.h>
+#include <paths.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utmpx.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+
+#include "arguments_parsing.h"
+#include "descriptor_utils.h"
+#include "idle_time_tracking.h"
+#include "output_settings.h"
+#include "tty_utils.h"
+
+#define TTY_ACCESS_TIME_POLLING_INTERVAL_MS 1000
+#define INOTIFY_EVENT_DATA 0
+#define IDLE_TIME_TIMER_EVENT_DATA 1
+#define POLLING_TIMER_EVENT_DATA 2
+
+typedef struct TtySession {
+    char device_path[sizeof("/dev/") + sizeof(((struct utmpx *) 0)->ut_line)];
+    int watch_descriptor; // -1 if the terminal can't be watched, its access time is polled instead
+} TtySession;
+
+static int tty_epoll_file_descriptor = -1; // Waits for inotify and timers
+static int inotify_file_descriptor = -1;
+static int utmp_watch_descriptor = -1;
+static int idle_time_timer_file_descriptor = -1;
+static int polling_timer_file_descriptor = -1; // -1 unless activity matters and some terminal isn't watched
+static TtySession *tty_sessions = NULL;
+static size_t tty_session_count = 0;
+static size_t tty_sessions_allocated = 0;
+// Sessions are loaded into this buffer, which is then swapped with tty_sessions.
+static TtySession *loaded_tty_sessions = NULL;
+static size_t loaded_tty_sessions_allocated = 0;
+/**
+ * Whether inotify events wake up. When they don't, they are read when idle time is queried, and since it's not known
+ * when they happened, access times are used instead.
+ */
+static int inotify_events_wake_up = 0;
+
+/**
+ * Lowers idle time to the time since input was last read from any terminal.
+ *
+ * @return 1 if idle time was lowered, 0 if it wasn't.
+ */
+static int update_idle_time_from_terminal_access_times(void) {
+    long unsigned user_idle_time_ms = get_tracked_user_idle_time_ms();
+    int user_idle_time_was_lowered = 0;
+    for (size_t session_index = 0; session_index < tty_session_count; session_index++) {
+        const long long terminal_idle_time_ms = get_terminal_input_idle_time_ms(tty_sessions[session_index].device_path);
+        if (terminal_idle_time_ms >= 0 && (long unsigned) terminal_idle_time_ms < user_idle_time_ms) {
+            user_idle_time_ms = terminal_idle_time_ms;
+            user_idle_time_was_lowered = 1;
+        }
+    }
+    if (user_idle_time_was_lowered) {
+        set_tracked_user_idle_time(user_idle_time_ms);
+    }
+    return user_idle_time_was_lowered;
+}
+
+static int tty_session_is_alive(const struct utmpx *utmp_entry) {
+    // Entries of sessions that didn't end cleanly stay in utmp.
+    return utmp_entry->ut_pid <= 0 || kill(utmp_entry->ut_pid, 0) == 0 || errno == EPERM;
+}
+
+static void ensure_loaded_tty_sessions_capacity(size_t session_count) {
+    if (session_count < loaded_tty_sessions_allocated) {
+        return;
+    }
+    size_t new_allocated = loaded_tty_sessions_allocated ? loaded_tty_sessions_allocated * 2 : 16;
+    TtySession *new_loaded_tty_sessions = realloc(loaded_tty_sessions, new_allocated * sizeof(TtySession));
+    if (!new_loaded_tty_sessions) {
+        perror("Failed to allocate memory for terminal session list");
+        exit(1);
+    }
+    loaded_tty_sessions = new_loaded_tty_sessions;
+    loaded_tty_sessions_allocated = new_allocated;
+}
+
+static void load_tty_sessions(void) {
+    size_t new_tty_session_count = 0;
+    setutxent();
+    const struct utmpx *utmp_entry;
+    while ((utmp_entry = getutxent()) != NULL) {
+        if (utmp_entry->ut_type != USER_PROCESS || !tty_session_is_alive(utmp_entry)) {
+            continue;
+        }
+        ensure_loaded_tty_sessions_capacity(new_tty_session_count);
+        TtySession *session = &loaded_tty_sessions[new_tty_session_count];
+        // Graphical sessions have lines like ":0", which are not terminals.
+        if (get_terminal_device_path(utmp_entry->ut_line, sizeof(utmp_entry->ut_line), session->device_path,
+                                     sizeof(session->device_path)) < 0) {
+            continue;
+        }
+        int session_is_duplicate = 0;
+        for (size_t session_index = 0; session_index < new_tty_session_count; session_index++) {
+            if (strcmp(loaded_tty_sessions[session_index].device_path, session->device_path) == 0) {
+                session_is_duplicate = 1;
+            }
+        }
+        if (session_is_duplicate) {
+            continue;
+        }
+        // Returns the existing watch descriptor if the terminal is already watched.
+        session->watch_descriptor = inotify_add_watch(inotify_file_descriptor, session->device_path, IN_ACCESS);
+        if (debug) {
+            fprintf(stderr, "Terminal session of %.*s on %s, %s\n", (int) sizeof(utmp_entry->ut_user),
+                    utmp_entry->ut_user, session->device_path,
+                    session->watch_descriptor == -1 ? "polling access time" : "watching reads");
+        }
+        new_tty_session_count++;
+    }
+    endutxent();
+
+    for (size_t session_index = 0; session_index < tty_session_count; session_index++) {
+        const int watch_descriptor = tty_sessions[session_index].watch_descriptor;
+        int watch_is_still_used = 0;
+        for (size_t new_session_index = 0; new_session_index < new_tty_session_count; new_session_index++) {
+            if (loaded_tty_sessions[new_session_index].watch_descriptor == watch_descriptor) {
+                watch_is_still_used = 1;
+            }
+        }
+        if (watch_descriptor != -1 && !watch_is_still_used) {
+            inotify_rm_watch(inotify_file_descriptor, watch_descriptor);
+        }
+    }
+    TtySession *const previous_tty_sessions = tty_sessions;
+    const size_t previous_tty_sessions_allocated = tty_sessions_allocated;
+    tty_sessions = loaded_tty_sessions;
+    tty_sessions_allocated = loaded_tty_sessions_allocated;
+    loaded_tty_sessions = previous_tty_sessions;
+    loaded_tty_sessions_allocated = previous_tty_sessions_allocated;
+    if (verbose && new_tty_session_count != tty_session_count) {
+        fprintf(stderr, "Number of terminal sessions: %zu\n", new_tty_session_count);
+    }
+    tty_session_count = new_tty_session_count;
+}
+
+static int watch_utmp(void) {
+    utmp_watch_descriptor = inotify_add_watch(inotify_file_descriptor, _PATH_UTMP, IN_MODIFY | IN_CLOSE_WRITE);
+    if (utmp_watch_descriptor == -1) {
+        if (verbose) fprintf(stderr, "Failed to watch %s: %s\n", _PATH_UTMP, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Reads all queued inotify events, reloading sessions if utmp has changed.
+ *
+ * @return 1 if input was read from a watched terminal, 0 if it wasn't.
+ */
+static int handle_inotify_events(void) {
+    char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    ssize_t bytes_read;
+    int terminal_was_read = 0;
+    int utmp_has_changed = 0;
+    while ((bytes_read = read(inotify_file_descriptor, buffer, sizeof(buffer))) > 0) {
+        for (char *position = buffer; position < buffer + bytes_read;) {
+            const struct inotify_event *inotify_event = (const struct inotify_event *) position;
+            position += sizeof(struct inotify_event) + inotify_event->len;
+            if (inotify_event->mask & IN_Q_OVERFLOW) {
+                utmp_has_changed = 1;
+            } else if (inotify_event->wd == utmp_watch_descriptor) {
+                utmp_has_changed = 1;
+                if (inotify_event->mask & IN_IGNORED) {
+                    // utmp was replaced.
+                    watch_utmp();
+                }
+            } else if (inotify_event->mask & IN_ACCESS) {
+                terminal_was_read = 1;
+            }
+        }
+    }
+    if (utmp_has_changed) {
+        load_tty_sessions();
+    }
+    return terminal_was_read;
+}
+
+static int some_terminal_is_not_watched(void) {
+    for (size_t session_index = 0; session_index < tty_session_count; session_index++) {
+        if (tty_sessions[session_index].watch_descriptor == -1) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void teardown_tty_idle_source(void) {
+    free(tty_sessions);
+    free(loaded_tty_sessions);
+    tty_sessions = loaded_tty_sessions = NULL;
+    tty_sessions_allocated = loaded_tty_sessions_allocated = 0;
+    tty_session_count = 0;
+    utmp_watch_descriptor = -1;
+    close_file_descriptor_if_open(&polling_timer_file_descriptor, "terminal polling timer");
+    close_file_descriptor_if_open(&inotify_file_descriptor, "terminal inotify");
+    close_file_descriptor_if_open(&tty_epoll_file_descriptor, "terminal epoll");
+    stop_tracking_user_idle_time();
+    idle_time_timer_file_descriptor = -1;
+}
+
+static int add_to_tty_epoll(int file_descriptor, uint32_t events, uint32_t data) {
+    struct epoll_event event = {.events = events, .data.u32 = data};
+    if (epoll_ctl(tty_epoll_file_descriptor, EPOLL_CTL_ADD, file_descriptor, &event) != 0) {
+        fprintf_error("Failed to wait for terminal idle source file descriptor %d: %s\n", file_descriptor,
+                      strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static int init_tty_idle_source(void) {
+    inotify_events_wake_up = 0;
+    tty_epoll_file_descriptor = epoll_create1(EPOLL_CLOEXEC);
+    if (tty_epoll_file_descriptor == -1) {
+        fprintf_error("Failed to create epoll file descriptor for terminals: %s\n", strerror(errno));
+        return 0;
+    }
+    idle_time_timer_file_descriptor = start_tracking_user_idle_time();
+    if (idle_time_timer_file_descriptor == -1 ||
+        add_to_tty_epoll(idle_time_timer_file_descriptor, EPOLLIN, IDLE_TIME_TIMER_EVENT_DATA) < 0) {
+        teardown_tty_idle_source();
+        return 0;
+    }
+    inotify_file_descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_file_descriptor == -1) {
+        fprintf_error("Failed to create inotify file descriptor for terminals: %s\n", strerror(errno));
+        teardown_tty_idle_source();
+        return 0;
+    }
+    // Watching is started before reading utmp, so that sessions that start in between are not missed.
+    if (watch_utmp() < 0 || add_to_tty_epoll(inotify_file_descriptor, 0, INOTIFY_EVENT_DATA) < 0) {
+        teardown_tty_idle_source();
+        return 0;
+    }
+    load_tty_sessions();
+    // Without sessions there is nobody to disturb until someone logs in.
+    set_tracked_user_idle_time(user_idle_timeout_ms);
+    update_idle_time_from_terminal_access_times();
+    if (verbose) fprintf(stderr, "Watching %zu terminal sessions for user activity\n", tty_session_count);
+    return 1;
+}
+
+static int get_tty_idle_source_file_descriptor(void) {
+    return tty_epoll_file_descriptor;
+}
+
+static int handle_tty_idle_source_events(uint32_t events) {
+    (void)events;
+    struct epoll_event ready_events[3];
+    const int ready_event_count = epoll_wait(tty_epoll_file_descriptor, ready_events, 3, 0);
+    if (ready_event_count < 0) {
+        return errno == EINTR ? 0 : -1;
+    }
+    int user_idle_time_has_changed = 0;
+    for (int event_index = 0; event_index < ready_event_count; event_index++) {
+        switch (ready_events[event_index].data.u32) {
+            case INOTIFY_EVENT_DATA:
+                if (handle_inotify_events()) {
+                    if (debug) fprintf(stderr, "Terminal idle source: input was read from a terminal\n");
+                    set_tracked_user_idle_time(0);
+                    user_idle_time_has_changed = 1;
+                }
+                // New sessions could have been started.
+                user_idle_time_has_changed |= update_idle_time_from_terminal_access_times();
+                break;
+            case IDLE_TIME_TIMER_EVENT_DATA:
+                if (handle_tracked_user_idle_time_timer_expiration() < 0) {
+                    return -1;
+                }
+                user_idle_time_has_changed = 1;
+                break;
+            case POLLING_TIMER_EVENT_DATA:
+                if (consume_timer_file_descriptor_checked(polling_timer_file_descriptor, "terminal polling") < 0) {
+                    return -1;
+                }
+                user_idle_time_has_changed |= update_idle_time_from_terminal_access_times();
+                break;
+        }
+    }
+    return user_idle_time_has_changed;
+}
+
+static long unsigned query_tty_idle_time_ms(void) {
+    // Inotify events that didn't wake up are not used, since it's not known when they happened.
+    handle_inotify_events();
+    update_idle_time_from_terminal_access_times();
+    return get_tracked_user_idle_time_ms();
+}
+
+static int prepare_tty_idle_source_to_wait(long unsigned wake_up_at_idle_time_ms, long unsigned user_idle_time_ms) {
+    const int activity_matters = user_idle_time_ms != 0;
+    if (activity_matters != inotify_events_wake_up) {
+        inotify_events_wake_up = activity_matters;
+        if (activity_matters) {
+            // Reads that happened before now were already taken into account through access times.
+            handle_inotify_events();
+        }
+        struct epoll_event event = {.events = activity_matters ? EPOLLIN : 0, .data.u32 = INOTIFY_EVENT_DATA};
+        if (epoll_ctl(tty_epoll_file_descriptor, EPOLL_CTL_MOD, inotify_file_descriptor, &event) != 0) {
+            fprintf_error("Failed to wait for terminal inotify events: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+
+    const int access_times_need_polling = activity_matters && some_terminal_is_not_watched();
+    if (access_times_need_polling && polling_timer_file_descriptor == -1) {
+        polling_timer_file_descriptor = create_periodic_timer_file_descriptor_every_ms(
+                TTY_ACCESS_TIME_POLLING_INTERVAL_MS);
+        if (polling_timer_file_descriptor == -1) {
+            fprintf_error("Failed to create terminal polling timer: %s\n", strerror(errno));
+            return -1;
+        }
+        if (add_to_tty_epoll(polling_timer_file_descriptor, EPOLLIN, POLLING_TIMER_EVENT_DATA) < 0) {
+            return -1;
+        }
+    } else if (!access_times_need_polling && polling_timer_file_descriptor != -1) {
+        // Closing removes it from epoll.
+        close_file_descriptor_if_open(&polling_timer_file_descriptor, "terminal polling timer");
+    }
+    return wake_up_at_tracked_user_idle_time(wake_up_at_idle_time_ms);
+}
+
+const IdleSource tty_idle_source = {
+        .name = "TTY",
+        .init = init_tty_idle_source,
+        .get_file_descriptor = get_tty_idle_source_file_descriptor,
+        .on_readable = handle_tty_idle_source_events,
+        .query_idle_time_ms = query_tty_idle_time_ms,
+        .prepare_to_wait = prepare_tty_idle_source_to_wait,
+        .teardown = teardown_tty_idle_source,
+};
@@ -0,0 +1,13 @@
+#ifndef RUNWHENIDLE_TTY_IDLE_H
+#define RUNWHENIDLE_TTY_IDLE_H
+
+#include "idle_sources.h"
+
+/**
+ * Treats input being read from terminals of sessions logged in according to utmp, e.g. over SSH or on a console, as
+ * user activity. The user is idle when every session has been idle. Reads are noticed through inotify on terminals that
+ * can be watched, access times of other terminals are checked once per second while activity matters.
+ */
+extern const IdleSource tty_idle_source;
+
+#endif //RUNWHENIDLE_TTY_IDLE_H
@@ -2,6 +2,9 @@
 #include <unistd.h>
 #include <stdarg.h>
 #include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
 #include "tty_utils.h"
 
 void print_colored_prefix(FILE *stream, const char *color) {
@@ -22,4 +25,34 @@ void fprintf_error(const char *format, ...) {
     if (is_tty) print_colored_suffix(stderr);
 
     va_end(args);
-}
\ No newline at end of file
+}
+
+int get_terminal_device_path(const char *terminal_line, size_t terminal_line_size, char *out_path,
+                             size_t out_path_size) {
+    const int terminal_line_length = (int) strnlen(terminal_line, terminal_line_size);
+    if (terminal_line_length == 0) {
+        return -1;
+    }
+    const int path_length = snprintf(out_path, out_path_size, "/dev/%.*s", terminal_line_length, terminal_line);
+    if (path_length < 0 || (size_t) path_length >= out_path_size || strstr(out_path, "..") != NULL) {
+        return -1;
+    }
+    struct stat terminal_stat;
+    if (stat(out_path, &terminal_stat) != 0 || !S_ISCHR(terminal_stat.st_mode)) {
+        return -1;
+    }
+    return 0;
+}
+
+long long get_terminal_input_idle_time_ms(const char *terminal_device_path) {
+    struct stat terminal_stat;
+    if (stat(terminal_device_path, &terminal_stat) != 0) {
+        return -1;
+    }
+    struct timespec current_time;
+    clock_gettime(CLOCK_REALTIME, &current_time);
+    const time_t access_time_window_end = (terminal_stat.st_atim.tv_sec & ~(time_t) 7) + 8;
+    const long long idle_time_ms = (long long) (current_time.tv_sec - access_time_window_end) * 1000 +
+                                   current_time.tv_nsec / 1000000;
+    return idle_time_ms > 0 ? idle_time_ms : 0;
+}
@@ -1,6 +1,25 @@
 #ifndef RUNWHENIDLE_TTY_UTILS_H
 #define RUNWHENIDLE_TTY_UTILS_H
 
+#include <stddef.h>
+
 void fprintf_error(const char *format, ...);
 
+/**
+ * Gets the path of the terminal device of a utmp line, e.g. /dev/pts/3 for "pts/3".
+ *
+ * @param terminal_line Line, which doesn't have to be null-terminated if it's terminal_line_size long.
+ * @return 0 on success, -1 if the line doesn't name a terminal device.
+ */
+int get_terminal_device_path(const char *terminal_line, size_t terminal_line_size, char *out_path,
+                             size_t out_path_size);
+
+/**
+ * Calculates how long ago input was last read from the terminal using its access time. The kernel only updates it
+ * once per 8-second window, so the time since the end of that window is returned to not overestimate idle time.
+ *
+ * @return Idle time in milliseconds, 0 if the window hasn't ended yet, -1 if the terminal can't be checked.
+ */
+long long get_terminal_input_idle_time_ms(const char *terminal_device_path);
+
 #endif //RUNWHENIDLE_TTY_UTILS_H
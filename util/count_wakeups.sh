@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Counts how many times runwhenidle wakes up while it waits for a long-running command.
+# Usage: count_wakeups.sh [seconds to measure for] [runwhenidle binary] [extra runwhenidle arguments...]
+
+duration=${1:-60}
+runwhenidle=${2:-./runwhenidle}
+shift $(($# < 2 ? $# : 2))
+
+# Reads context switch counters with builtins only, so that forking doesn't wake up descendant tracking.
+function read_context_switches() {
+    local name value total=0
+    while read -r name value; do
+        if [ "$name" = "voluntary_ctxt_switches:" ] || [ "$name" = "nonvoluntary_ctxt_switches:" ]; then
+            total=$(($total + $value))
+        fi
+    done < "/proc/$1/status"
+    echo "$total"
+}
+
+"$runwhenidle" --quiet "$@" sleep $(($duration + 60)) &
+runwhenidle_pid=$!
+# Let it start monitoring first
+sleep 2
+
+switches_before=$(read_context_switches $runwhenidle_pid)
+sleep "$duration"
+switches_after=$(read_context_switches $runwhenidle_pid)
+
+kill -TERM $runwhenidle_pid
+wait $runwhenidle_pid 2>/dev/null
+
+wakeups=$(($switches_after - $switches_before))
+echo "Woken up $wakeups times in ${duration}s"
@@ -0,0 +1,51 @@
+#!/bin/bash
+
+# Measures how long it takes runwhenidle to pause a command after user activity and resume it after the user becomes
+# idle, using the FIFO idle source, so it doesn't need a graphical session.
+# Usage: measure_transition_latency.sh [number of transitions] [runwhenidle binary] [extra runwhenidle arguments...]
+
+transitions=${1:-10}
+runwhenidle=${2:-./runwhenidle}
+shift $(($# < 2 ? $# : 2))
+
+fifo=$(mktemp -u /tmp/runwhenidle-latency.XXXXXX)
+"$runwhenidle" --quiet --start-monitor-after=0 --idle-source "fifo:$fifo" "$@" sleep 3600 &
+runwhenidle_pid=$!
+while [ ! -p "$fifo" ]; do sleep 0.01; done
+echo idle > "$fifo"
+sleep 0.2
+read -r command_pid < "/proc/$runwhenidle_pid/task/$runwhenidle_pid/children"
+
+function read_state() {
+    local line
+    while read -r line; do
+        if [ "${line%%:*}" = "State" ]; then
+            line=${line#State:}
+            echo ${line:1:1}
+            return
+        fi
+    done < "/proc/$command_pid/status"
+}
+
+# Prints microseconds between writing the line and the command reaching the state
+function measure_transition() {
+    local line=$1 expected_state=$2 start end
+    start=${EPOCHREALTIME/./}
+    echo "$line" > "$fifo"
+    while [ "$(read_state)" != "$expected_state" ]; do :; done
+    end=${EPOCHREALTIME/./}
+    echo $(($end - $start))
+}
+
+pause_total=0
+resume_total=0
+for ((transition = 0; transition < transitions; transition++)); do
+    pause_total=$(($pause_total + $(measure_transition active T)))
+    resume_total=$(($resume_total + $(measure_transition idle S)))
+done
+
+kill -TERM $runwhenidle_pid
+wait $runwhenidle_pid 2>/dev/null
+rm -f "$fifo"
+
+echo "Average pause latency: $(($pause_total / $transitions))us, average resume latency: $(($resume_total / $transitions))us"
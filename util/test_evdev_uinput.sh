@@ -0,0 +1,103 @@
+#!/bin/bash
+
+# Checks that the evdev idle source pauses a command when a key is pressed on a virtual keyboard created through
+# uinput, and resumes it once there was no input for --timeout. Needs python3 for the uinput ioctls and access to
+# /dev/uinput and /dev/input/event*, e.g. by running as root.
+# Usage: test_evdev_uinput.sh [runwhenidle binary] [extra runwhenidle arguments...]
+
+runwhenidle=${1:-./runwhenidle}
+shift $(($# < 1 ? $# : 1))
+timeout_seconds=2
+
+# Creates a virtual keyboard, prints "ready" once it exists, then presses and releases a key for every line read.
+read -r -d '' virtual_keyboard_script <<'EOF'
+import fcntl, os, struct, sys, time
+
+UI_SET_EVBIT, UI_SET_KEYBIT, UI_DEV_SETUP, UI_DEV_CREATE, UI_DEV_DESTROY = 0x40045564, 0x40045565, 0x405c5503, 0x5501, 0x5502
+EV_SYN, EV_KEY, SYN_REPORT, BUS_VIRTUAL = 0, 1, 0, 6
+# Not mapped by default keymaps, so pressing it doesn't type anything into the console or the focused window
+KEY_UNKNOWN = 240
+
+uinput = os.open("/dev/uinput", os.O_WRONLY | os.O_NONBLOCK)
+fcntl.ioctl(uinput, UI_SET_EVBIT, EV_KEY)
+fcntl.ioctl(uinput, UI_SET_KEYBIT, KEY_UNKNOWN)
+fcntl.ioctl(uinput, UI_DEV_SETUP, struct.pack("HHHH80sI", BUS_VIRTUAL, 1, 1, 1, b"runwhenidle test keyboard", 0))
+fcntl.ioctl(uinput, UI_DEV_CREATE)
+# udev needs some time to create the device node
+time.sleep(0.5)
+print("ready", flush=True)
+for line in sys.stdin:
+    for value in (1, 0):
+        os.write(uinput, struct.pack("llHHi", 0, 0, EV_KEY, KEY_UNKNOWN, value))
+        os.write(uinput, struct.pack("llHHi", 0, 0, EV_SYN, SYN_REPORT, 0))
+    print("pressed", flush=True)
+fcntl.ioctl(uinput, UI_DEV_DESTROY)
+EOF
+
+coproc virtual_keyboard { python3 -c "$virtual_keyboard_script"; }
+keyboard_input=${virtual_keyboard[1]}
+keyboard_output=${virtual_keyboard[0]}
+read -r line <&"$keyboard_output"
+if [ "$line" != "ready" ]; then
+    echo "Failed to create a virtual keyboard through /dev/uinput" >&2
+    exit 1
+fi
+
+"$runwhenidle" --quiet --start-monitor-after=0 --idle-source evdev --timeout $timeout_seconds "$@" sleep 3600 &
+runwhenidle_pid=$!
+sleep 0.2
+read -r command_pid < "/proc/$runwhenidle_pid/task/$runwhenidle_pid/children"
+
+function read_state() {
+    local line
+    while read -r line; do
+        if [ "${line%%:*}" = "State" ]; then
+            line=${line#State:}
+            echo ${line:1:1}
+            return
+        fi
+    done < "/proc/$command_pid/status"
+}
+
+# Prints milliseconds it took the command to reach the state, fails if it didn't within the limit
+function wait_for_state() {
+    local expected_state=$1 limit_ms=$2 start elapsed_ms
+    start=${EPOCHREALTIME/./}
+    while [ "$(read_state)" != "$expected_state" ]; do
+        elapsed_ms=$(((${EPOCHREALTIME/./} - $start) / 1000))
+        if [ $elapsed_ms -gt $limit_ms ]; then
+            return 1
+        fi
+        sleep 0.01
+    done
+    echo $(((${EPOCHREALTIME/./} - $start) / 1000))
+}
+
+function finish() {
+    kill -TERM $runwhenidle_pid
+    wait $runwhenidle_pid 2>/dev/null
+    exec {keyboard_input}>&-
+    wait $virtual_keyboard_PID 2>/dev/null
+    exit $1
+}
+
+# The user counts as active when monitoring starts, so the command is running only after --timeout without input.
+sleep $timeout_seconds
+if ! wait_for_state S 2000 > /dev/null; then
+    echo "FAIL: command was not running after ${timeout_seconds}s without input" >&2
+    finish 1
+fi
+
+echo >&"$keyboard_input"
+read -r line <&"$keyboard_output"
+if ! pause_latency_ms=$(wait_for_state T 1000); then
+    echo "FAIL: command was not paused within 1s after a key press" >&2
+    finish 1
+fi
+if ! resume_time_ms=$(wait_for_state S $((($timeout_seconds + 2) * 1000))); then
+    echo "FAIL: command was not resumed after ${timeout_seconds}s without input" >&2
+    finish 1
+fi
+
+echo "PASS: paused ${pause_latency_ms}ms after a key press, resumed ${resume_time_ms}ms after that"
+finish 0
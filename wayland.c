@@ -2,19 +2,29 @@
 
 #include "wayland.h"
 
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <linux/limits.h>
-#include <sys/timerfd.h>
+#include <sys/epoll.h>
 
 #include "arguments_parsing.h"
 #include "environment_guessing.h"
-#include "process_handling.h"
-#include "sleep_utils.h"
+#include "event_loop.h"
+#include "idle_history.h"
+#include "idle_tiers.h"
+#include "output_settings.h"
 #include "string_utils.h"
+#include "time_utils.h"
 #include "tty_utils.h"
 
+// Every idle level except the first one, --min-activity-time and --idle-history
+#define MAX_WAYLAND_IDLE_NOTIFICATIONS 16
+
 static struct wl_display *wayland_display = NULL;
 static struct wl_registry *wayland_registry = NULL;
 
@@ -24,9 +34,17 @@ static struct ext_idle_notifier_v1 *wayland_idle_notifier = NULL;
 
 static uint32_t wayland_idle_notifier_version = 0;
 
-static struct ext_idle_notification_v1 *wayland_idle_notification = NULL;
+// One notification for every idle time that matters, listeners get its timeout as data
+static struct ext_idle_notification_v1 *wayland_idle_notifications[MAX_WAYLAND_IDLE_NOTIFICATIONS];
+static size_t wayland_idle_notification_count = 0;
+
+static int wayland_display_file_descriptor = -1;
+static int wayland_flush_is_pending = 0;
 
-static int wayland_idle_notify_available = 0;
+// Longest timeout of notifications that have idled since the user was last active, 0 if none has
+static long unsigned wayland_user_idle_time_at_notification_ms = 0;
+static struct timespec wayland_user_idle_notification_time;
+static int wayland_user_idle_time_has_changed = 0;
 
 
 static struct wl_display *connect_to_wayland_best_effort(void) {
@@ -66,71 +84,100 @@ static struct wl_display *connect_to_wayland_best_effort(void) {
     return display;
 }
 
-static int try_initialize_wayland_idle_backend(const struct wl_registry_listener *wayland_registry_listener) {
-    wayland_display = connect_to_wayland_best_effort();
-    if (!wayland_display) {
-        return 0;
+static void teardown_wayland_idle_source(void) {
+    for (size_t notification_index = 0; notification_index < wayland_idle_notification_count; notification_index++) {
+        ext_idle_notification_v1_destroy(wayland_idle_notifications[notification_index]);
     }
-
-    wayland_registry = wl_display_get_registry(wayland_display);
-    if (!wayland_registry) {
-        wl_display_disconnect(wayland_display);
-        wayland_display = NULL;
-        return 0;
+    wayland_idle_notification_count = 0;
+    if (wayland_idle_notifier) {
+        ext_idle_notifier_v1_destroy(wayland_idle_notifier);
+        wayland_idle_notifier = NULL;
     }
-
-    wl_registry_add_listener(wayland_registry, wayland_registry_listener, NULL);
-    wl_display_roundtrip(wayland_display);
-
-    if (wayland_seat == NULL || wayland_idle_notifier == NULL) {
-        if (wayland_idle_notifier) {
-            ext_idle_notifier_v1_destroy(wayland_idle_notifier);
-        }
-        if (wayland_seat) {
-            wl_seat_destroy(wayland_seat);
-        }
+    if (wayland_seat) {
+        wl_seat_destroy(wayland_seat);
+        wayland_seat = NULL;
+    }
+    if (wayland_registry) {
         wl_registry_destroy(wayland_registry);
         wayland_registry = NULL;
+    }
+    if (wayland_display) {
+        // The display file descriptor is closed together with the connection.
         wl_display_disconnect(wayland_display);
         wayland_display = NULL;
-        wayland_seat = NULL;
-        wayland_idle_notifier = NULL;
-        wayland_idle_notify_available = 0;
-        return 0;
     }
+    wayland_display_file_descriptor = -1;
+    wayland_flush_is_pending = 0;
+}
 
-    wayland_idle_notify_available = 1;
-    return 1;
+static void wayland_idle_notification_idled(void *data, struct ext_idle_notification_v1 *notification) {
+    (void)notification;
+    const long unsigned timeout_ms = (uintptr_t) data;
+    if (debug) fprintf(stderr, "Wayland idle: idled() for timeout %lums\n", timeout_ms);
+
+    // Idle time has to be queried even if it's already known to be this long, since that's what was waited for.
+    wayland_user_idle_time_has_changed = 1;
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    // Notifications with shorter timeouts can arrive after longer ones when they are created at the same time.
+    if (wayland_user_idle_time_at_notification_ms &&
+        wayland_user_idle_time_at_notification_ms +
+        get_elapsed_time_ms(wayland_user_idle_notification_time, current_time) >= timeout_ms) {
+        return;
+    }
+    wayland_user_idle_time_at_notification_ms = timeout_ms;
+    wayland_user_idle_notification_time = current_time;
 }
 
-int start_wayland_idle_notification_object(
-    const struct ext_idle_notification_v1_listener *wayland_idle_notification_listener) {
-    if (wayland_idle_notification != NULL) {
-        return 0;
+static void wayland_idle_notification_resumed(void *data, struct ext_idle_notification_v1 *notification) {
+    (void)notification;
+    if (debug) fprintf(stderr, "Wayland idle: resumed() for timeout %lums\n", (long unsigned) (uintptr_t) data);
+    // Every notification that has idled sends resumed, only the first one matters.
+    if (wayland_user_idle_time_at_notification_ms) {
+        wayland_user_idle_time_at_notification_ms = 0;
+        wayland_user_idle_time_has_changed = 1;
+    }
+}
+
+static const struct ext_idle_notification_v1_listener wayland_idle_notification_listener = {
+    .idled = wayland_idle_notification_idled,
+    .resumed = wayland_idle_notification_resumed
+};
+
+/**
+ * Creates a notification that idles after the timeout, unless one with the same timeout exists.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int add_wayland_idle_notification(long unsigned timeout_ms) {
+    for (size_t notification_index = 0; notification_index < wayland_idle_notification_count; notification_index++) {
+        if ((uintptr_t) ext_idle_notification_v1_get_user_data(wayland_idle_notifications[notification_index]) ==
+            timeout_ms) {
+            return 0;
+        }
     }
-    if (!wayland_idle_notify_available) {
+    if (wayland_idle_notification_count == MAX_WAYLAND_IDLE_NOTIFICATIONS) {
         return -1;
     }
-
-    uint32_t timeout_ms_for_protocol = (user_idle_timeout_ms > UINT32_MAX)
+    uint32_t timeout_ms_for_protocol = (timeout_ms > UINT32_MAX)
                                            ? UINT32_MAX
-                                           : (uint32_t) user_idle_timeout_ms;
+                                           : (uint32_t) timeout_ms;
 
+    struct ext_idle_notification_v1 *notification;
     if (wayland_idle_notifier_version >= 2) {
-        wayland_idle_notification = ext_idle_notifier_v1_get_input_idle_notification(
+        notification = ext_idle_notifier_v1_get_input_idle_notification(
             wayland_idle_notifier, timeout_ms_for_protocol, wayland_seat);
     } else {
-        wayland_idle_notification = ext_idle_notifier_v1_get_idle_notification(
-            wayland_idle_notifier, timeout_ms_for_protocol, wayland_seat);
+        notification = ext_idle_notifier_v1_get_idle_notification(wayland_idle_notifier, timeout_ms_for_protocol,
+                                                                   wayland_seat);
     }
-
-    if (!wayland_idle_notification) {
+    if (!notification) {
         return -1;
     }
-
-    ext_idle_notification_v1_add_listener(wayland_idle_notification, wayland_idle_notification_listener, NULL);
-    wl_display_flush(wayland_display);
-    return 1;
+    ext_idle_notification_v1_add_listener(notification, &wayland_idle_notification_listener,
+                                          (void *) (uintptr_t) timeout_ms);
+    wayland_idle_notifications[wayland_idle_notification_count++] = notification;
+    return 0;
 }
 
 static void wayland_registry_global(void *data,
@@ -165,34 +212,135 @@ static const struct wl_registry_listener wayland_registry_listener = {
     .global_remove = wayland_registry_global_remove
 };
 
-int try_monitor_wayland_idle_notify(WaylandLoopFunction wayland_loop_function) {
-    if (!try_initialize_wayland_idle_backend(&wayland_registry_listener)) {
-        return -1;
+static int init_wayland_idle_source(void) {
+    wayland_display = connect_to_wayland_best_effort();
+    if (!wayland_display) {
+        return 0;
     }
-    const int wayland_loop_result = wayland_loop_function(wayland_display);
 
-    if (wayland_idle_notification) {
-        ext_idle_notification_v1_destroy(wayland_idle_notification);
-        wayland_idle_notification = NULL;
+    wayland_registry = wl_display_get_registry(wayland_display);
+    if (!wayland_registry) {
+        teardown_wayland_idle_source();
+        return 0;
     }
-    if (wayland_idle_notifier) {
-        ext_idle_notifier_v1_destroy(wayland_idle_notifier);
-        wayland_idle_notifier = NULL;
+
+    wl_registry_add_listener(wayland_registry, &wayland_registry_listener, NULL);
+    wl_display_roundtrip(wayland_display);
+
+    if (wayland_seat == NULL || wayland_idle_notifier == NULL) {
+        teardown_wayland_idle_source();
+        return 0;
     }
-    if (wayland_seat) {
-        wl_seat_destroy(wayland_seat);
-        wayland_seat = NULL;
+
+    for (size_t idle_level = 1; idle_level < get_idle_level_count(); idle_level++) {
+        if (add_wayland_idle_notification(get_idle_level(idle_level)->idle_time_ms) < 0) {
+            fprintf_error("Failed to create Wayland idle notification object\n");
+            teardown_wayland_idle_source();
+            return 0;
+        }
     }
-    if (wayland_registry) {
-        wl_registry_destroy(wayland_registry);
-        wayland_registry = NULL;
+    // Tells whether the user is still active, see --min-activity-time
+    if (min_activity_time_ms && add_wayland_idle_notification(min_activity_time_ms / 2) < 0) {
+        fprintf_error("Failed to create Wayland idle notification object, --min-activity-time will be ignored.\n");
+        min_activity_time_ms = 0;
     }
-    if (wayland_display) {
-        wl_display_disconnect(wayland_display);
-        wayland_display = NULL;
+    // Tells when idle periods long enough to be recorded start and end
+    if (idle_history_is_enabled() && add_wayland_idle_notification(MIN_OBSERVED_IDLE_PERIOD_MS) < 0) {
+        fprintf_error("Failed to create Wayland idle notification object, --idle-history will be ignored.\n");
+        idle_history_file_path = NULL;
     }
 
-    return wayland_loop_result;
+    wayland_display_file_descriptor = wl_display_get_fd(wayland_display);
+    wl_display_flush(wayland_display);
+    return 1;
 }
 
+static int get_wayland_idle_source_file_descriptor(void) {
+    return wayland_display_file_descriptor;
+}
 
+/**
+ * Sends requests that are buffered and waits for the display to become writable if not all of them could be sent.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int flush_wayland_display(void) {
+    int flush_is_pending = 0;
+    if (wl_display_flush(wayland_display) < 0) {
+        if (errno == EAGAIN || errno == EINTR) {
+            flush_is_pending = 1;
+        } else {
+            const int saved_errno = errno;
+            fprintf_error("Wayland display flush failed: %s\n", strerror(saved_errno));
+            return -1;
+        }
+    }
+    if (flush_is_pending != wayland_flush_is_pending) {
+        if (change_event_source_events(wayland_display_file_descriptor,
+                                       flush_is_pending ? EPOLLIN | EPOLLOUT : EPOLLIN) < 0) {
+            const int saved_errno = errno;
+            fprintf_error("Failed to change events waited for on Wayland display: %s\n", strerror(saved_errno));
+            return -1;
+        }
+        wayland_flush_is_pending = flush_is_pending;
+    }
+    return 0;
+}
+
+static int take_wayland_user_idle_time_change(void) {
+    const int user_idle_time_has_changed = wayland_user_idle_time_has_changed;
+    wayland_user_idle_time_has_changed = 0;
+    return user_idle_time_has_changed;
+}
+
+static int handle_wayland_display_events(uint32_t events) {
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        fprintf_error("Wayland connection closed\n");
+        return -1;
+    }
+    if ((events & EPOLLOUT) && flush_wayland_display() < 0) {
+        return -1;
+    }
+    if ((events & EPOLLIN) && wl_display_dispatch(wayland_display) < 0 && errno != EINTR && errno != EAGAIN) {
+        const int saved_errno = errno;
+        fprintf_error("Wayland display dispatch failed: %s\n", strerror(saved_errno));
+        return -1;
+    }
+    return take_wayland_user_idle_time_change();
+}
+
+static long unsigned query_wayland_idle_time_ms(void) {
+    if (!wayland_user_idle_time_at_notification_ms) {
+        return 0;
+    }
+    struct timespec current_time;
+    clock_gettime(CLOCK_MONOTONIC, &current_time);
+    return wayland_user_idle_time_at_notification_ms +
+           get_elapsed_time_ms(wayland_user_idle_notification_time, current_time);
+}
+
+static int prepare_wayland_idle_source_to_wait(long unsigned wake_up_at_idle_time_ms,
+                                               long unsigned user_idle_time_ms) {
+    // Notifications for every idle time that matters are created once, and every one that has idled sends resumed.
+    (void)wake_up_at_idle_time_ms;
+    (void)user_idle_time_ms;
+    if (wl_display_dispatch_pending(wayland_display) < 0) {
+        const int saved_errno = errno;
+        fprintf_error("Wayland display dispatch_pending failed: %s\n", strerror(saved_errno));
+        return -1;
+    }
+    if (flush_wayland_display() < 0) {
+        return -1;
+    }
+    return take_wayland_user_idle_time_change();
+}
+
+const IdleSource wayland_idle_source = {
+    .name = "Wayland",
+    .init = init_wayland_idle_source,
+    .get_file_descriptor = get_wayland_idle_source_file_descriptor,
+    .on_readable = handle_wayland_display_events,
+    .query_idle_time_ms = query_wayland_idle_time_ms,
+    .prepare_to_wait = prepare_wayland_idle_source_to_wait,
+    .teardown = teardown_wayland_idle_source,
+};
@@ -1,10 +1,12 @@
 #ifndef RUNWHENIDLE_WAYLAND_H
 #define RUNWHENIDLE_WAYLAND_H
-#include "ext-idle-notify-v1-client-protocol.h"
-#include <wayland-client.h>
 
-typedef int (*WaylandLoopFunction)(struct wl_display*);
-int try_monitor_wayland_idle_notify(WaylandLoopFunction wayland_loop_function);
-int start_wayland_idle_notification_object(const struct ext_idle_notification_v1_listener *wayland_idle_notification_listener);
+#include "idle_sources.h"
+
+/**
+ * Uses ext_idle_notification_v1 notifications for every idle time that matters. Idle time only increases
+ * when a notification idles.
+ */
+extern const IdleSource wayland_idle_source;
 
 #endif //RUNWHENIDLE_WAYLAND_H
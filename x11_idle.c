@@ -0,0 +1,82 @@
+#include "x11_idle.h"
+
+#include <stdio.h>
+#include <X11/Xlib.h>
+#include <X11/extensions/scrnsaver.h>
+
+#include "environment_guessing.h"
+#include "output_settings.h"
+#include "xsync_idle.h"
+
+static Display *x_display = NULL;
+static XScreenSaverInfo *xscreensaver_info = NULL; // NULL if XScreenSaver extension is not available
+static int xsync_idle_alarms_are_available = 0;
+
+static void teardown_x11_idle_source(void) {
+    if (xscreensaver_info) {
+        XFree(xscreensaver_info);
+        xscreensaver_info = NULL;
+    }
+    stop_xsync_idle_alarms();
+    xsync_idle_alarms_are_available = 0;
+    if (x_display) {
+        XCloseDisplay(x_display);
+        x_display = NULL;
+    }
+}
+
+static int init_x11_idle_source(void) {
+    x_display = open_x11_display_best_effort();
+    if (!x_display) {
+        if (verbose) fprintf(stderr, "Couldn't open an X11 display\n");
+        return 0;
+    }
+    int xscreensaver_event_base, xscreensaver_error_base;
+    if (XScreenSaverQueryExtension(x_display, &xscreensaver_event_base, &xscreensaver_error_base)) {
+        xscreensaver_info = XScreenSaverAllocInfo();
+    }
+    xsync_idle_alarms_are_available = start_xsync_idle_alarms(x_display);
+    if (!xscreensaver_info && !xsync_idle_alarms_are_available) {
+        teardown_x11_idle_source();
+        return 0;
+    }
+    return 1;
+}
+
+static int get_x11_idle_source_file_descriptor(void) {
+    // Without alarms there is nothing that would wake up, so idle time is polled.
+    return get_xsync_idle_alarm_file_descriptor();
+}
+
+static int handle_x11_idle_source_events(uint32_t events) {
+    (void)events;
+    // Reading from a broken X connection exits through the X11 I/O error handler.
+    return handle_xsync_idle_alarm_events();
+}
+
+static long unsigned query_x11_idle_time_ms(void) {
+    if (xsync_idle_alarms_are_available) {
+        return query_xsync_idle_time();
+    }
+    XScreenSaverQueryInfo(x_display, DefaultRootWindow(x_display), xscreensaver_info);
+    return xscreensaver_info->idle;
+}
+
+static int prepare_x11_idle_source_to_wait(long unsigned wake_up_at_idle_time_ms, long unsigned user_idle_time_ms) {
+    if (!xsync_idle_alarms_are_available) {
+        return 0;
+    }
+    arm_xsync_idle_alarms(wake_up_at_idle_time_ms, user_idle_time_ms);
+    // Alarms could have been read from the connection together with a reply.
+    return handle_xsync_idle_alarm_events();
+}
+
+const IdleSource x11_idle_source = {
+        .name = "X11",
+        .init = init_x11_idle_source,
+        .get_file_descriptor = get_x11_idle_source_file_descriptor,
+        .on_readable = handle_x11_idle_source_events,
+        .query_idle_time_ms = query_x11_idle_time_ms,
+        .prepare_to_wait = prepare_x11_idle_source_to_wait,
+        .teardown = teardown_x11_idle_source,
+};
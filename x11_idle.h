@@ -0,0 +1,12 @@
+#ifndef RUNWHENIDLE_X11_IDLE_H
+#define RUNWHENIDLE_X11_IDLE_H
+
+#include "idle_sources.h"
+
+/**
+ * Uses alarms on the IDLETIME counter of the X11 SYNC extension, or polls XScreenSaverQueryInfo() if they are not
+ * available.
+ */
+extern const IdleSource x11_idle_source;
+
+#endif //RUNWHENIDLE_X11_IDLE_H
@@ -0,0 +1,134 @@
+#include "xsync_idle.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <X11/extensions/sync.h>
+
+#include "output_settings.h"
+
+static Display *xsync_display = NULL;
+static int xsync_event_base;
+static XSyncCounter idle_time_counter = None;
+// Both alarms use comparisons with zero delta, which makes them trigger once and then wait until they are armed again.
+static XSyncAlarm idle_alarm = None; // Triggers when idle time reaches a value
+static XSyncAlarm activity_alarm = None; // Triggers when idle time goes below a value
+
+static void set_xsync_value(XSyncValue *value, long unsigned number) {
+    const unsigned long long number_64_bit = number;
+    XSyncIntsToValue(value, (unsigned int) (number_64_bit & 0xFFFFFFFF), (int) (number_64_bit >> 32));
+}
+
+static XSyncAlarm create_idle_time_alarm(XSyncTestType test_type) {
+    XSyncAlarmAttributes attributes;
+    attributes.trigger.counter = idle_time_counter;
+    attributes.trigger.value_type = XSyncAbsolute;
+    attributes.trigger.test_type = test_type;
+    set_xsync_value(&attributes.trigger.wait_value, 0);
+    set_xsync_value(&attributes.delta, 0);
+    attributes.events = False;
+    return XSyncCreateAlarm(xsync_display,
+                            XSyncCACounter | XSyncCAValueType | XSyncCATestType | XSyncCAValue | XSyncCADelta |
+                            XSyncCAEvents,
+                            &attributes);
+}
+
+static void change_idle_time_alarm(XSyncAlarm alarm, long unsigned idle_time_ms, int events) {
+    XSyncAlarmAttributes attributes;
+    set_xsync_value(&attributes.trigger.wait_value, idle_time_ms);
+    attributes.events = events ? True : False;
+    // Changing the alarm makes it active again and checks the condition right away.
+    XSyncChangeAlarm(xsync_display, alarm, XSyncCAValue | XSyncCAEvents, &attributes);
+}
+
+int start_xsync_idle_alarms(Display *x_display) {
+    int event_base, error_base, major_version, minor_version;
+    if (!XSyncQueryExtension(x_display, &event_base, &error_base) ||
+        !XSyncInitialize(x_display, &major_version, &minor_version)) {
+        if (verbose) fprintf(stderr, "X11 SYNC extension is not available\n");
+        return 0;
+    }
+    int counter_count = 0;
+    XSyncSystemCounter *counters = XSyncListSystemCounters(x_display, &counter_count);
+    XSyncCounter counter = None;
+    for (int counter_index = 0; counter_index < counter_count; counter_index++) {
+        if (strcmp(counters[counter_index].name, "IDLETIME") == 0) {
+            counter = counters[counter_index].counter;
+            break;
+        }
+    }
+    if (counters) {
+        XSyncFreeSystemCounterList(counters);
+    }
+    if (counter == None) {
+        if (verbose) fprintf(stderr, "X11 SYNC extension doesn't provide IDLETIME counter\n");
+        return 0;
+    }
+
+    xsync_display = x_display;
+    xsync_event_base = event_base;
+    idle_time_counter = counter;
+    idle_alarm = create_idle_time_alarm(XSyncPositiveComparison);
+    activity_alarm = create_idle_time_alarm(XSyncNegativeComparison);
+    XFlush(xsync_display);
+    return 1;
+}
+
+void stop_xsync_idle_alarms(void) {
+    if (!xsync_display) {
+        return;
+    }
+    XSyncDestroyAlarm(xsync_display, idle_alarm);
+    XSyncDestroyAlarm(xsync_display, activity_alarm);
+    XFlush(xsync_display);
+    idle_alarm = None;
+    activity_alarm = None;
+    xsync_display = NULL;
+}
+
+int get_xsync_idle_alarm_file_descriptor(void) {
+    if (!xsync_display) {
+        return -1;
+    }
+    return ConnectionNumber(xsync_display);
+}
+
+long unsigned query_xsync_idle_time(void) {
+    XSyncValue value;
+    if (!XSyncQueryCounter(xsync_display, idle_time_counter, &value)) {
+        return 0;
+    }
+    return (long unsigned) (((unsigned long long) (unsigned int) XSyncValueHigh32(value) << 32) |
+                            XSyncValueLow32(value));
+}
+
+void arm_xsync_idle_alarms(long unsigned wake_up_at_idle_time_ms, long unsigned user_idle_time_ms) {
+    change_idle_time_alarm(idle_alarm, wake_up_at_idle_time_ms, wake_up_at_idle_time_ms != 0);
+    // Idle time is only 0 right at the moment of user input, which can't be waited for.
+    change_idle_time_alarm(activity_alarm, user_idle_time_ms ? user_idle_time_ms - 1 : 0, user_idle_time_ms != 0);
+    XFlush(xsync_display);
+    if (debug) {
+        fprintf(stderr, "X11 idle alarms armed for idle time %lums and user activity: %s\n", wake_up_at_idle_time_ms,
+                user_idle_time_ms ? "yes" : "no");
+    }
+}
+
+int handle_xsync_idle_alarm_events(void) {
+    if (!xsync_display) {
+        return 0;
+    }
+    int alarm_triggered = 0;
+    // Events can be read from the connection while waiting for replies, so they could already be queued.
+    while (XPending(xsync_display)) {
+        XEvent event;
+        XNextEvent(xsync_display, &event);
+        if (event.type != xsync_event_base + XSyncAlarmNotify) {
+            continue;
+        }
+        const XSyncAlarmNotifyEvent *alarm_event = (XSyncAlarmNotifyEvent *) &event;
+        if (debug) {
+            fprintf(stderr, "X11 %s alarm triggered\n", alarm_event->alarm == activity_alarm ? "user activity" : "idle");
+        }
+        alarm_triggered = 1;
+    }
+    return alarm_triggered;
+}
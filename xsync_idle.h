@@ -0,0 +1,45 @@
+#ifndef RUNWHENIDLE_XSYNC_IDLE_H
+#define RUNWHENIDLE_XSYNC_IDLE_H
+
+#include <X11/Xlib.h>
+
+/**
+ * Creates alarms on the IDLETIME system counter of the X11 SYNC extension. They are created disarmed.
+ *
+ * @return 1 if alarms can be used, 0 if the server doesn't support them.
+ */
+int start_xsync_idle_alarms(Display *x_display);
+
+/**
+ * Destroys the alarms. Should be called before the display is closed.
+ */
+void stop_xsync_idle_alarms(void);
+
+/**
+ * @return X connection file descriptor that becomes readable when an alarm triggers, or -1 if alarms are not used.
+ */
+int get_xsync_idle_alarm_file_descriptor(void);
+
+/**
+ * @return How long the user has been idle for in milliseconds according to the IDLETIME counter.
+ */
+long unsigned query_xsync_idle_time(void);
+
+/**
+ * Arms the alarms for the next sleep, replacing what they were armed for before. An alarm whose condition has already
+ * been reached triggers right away, so nothing that happened since idle time was queried is missed.
+ *
+ * @param wake_up_at_idle_time_ms Idle time to trigger an alarm at, 0 if not needed.
+ * @param user_idle_time_ms Idle time queried last. If it's not 0, an alarm triggers when idle time goes below it,
+ *                          i.e. when the user becomes active.
+ */
+void arm_xsync_idle_alarms(long unsigned wake_up_at_idle_time_ms, long unsigned user_idle_time_ms);
+
+/**
+ * Reads all events that have arrived from the X server without blocking.
+ *
+ * @return 1 if an alarm has triggered, 0 otherwise.
+ */
+int handle_xsync_idle_alarm_events(void);
+
+#endif //RUNWHENIDLE_XSYNC_IDLE_H